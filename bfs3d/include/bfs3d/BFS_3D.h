@@ -18,6 +18,12 @@ class BFS_3D {
 
         volatile bool running;
 
+        // wall clock time (sec) at which the last search started & ended
+        volatile double search_start_time;
+        volatile double search_end_time;
+
+        static double now();
+
         void search(int, int, int volatile*, int*, int&, int&);
         inline int getNode(int, int, int);
 
@@ -33,6 +39,15 @@ class BFS_3D {
         void run(int, int, int);
 
         int getDistance(int, int, int);
+
+        // true until the search started by run() is done
+        bool isRunning();
+
+        // duration (sec) of the last search, or of the one running so far
+        double getSearchTime();
+
+        // wall clock time (sec since the epoch) at which the last search started
+        double getSearchStartTime();
 };
 }
 
@@ -1,5 +1,6 @@
 #include <bfs3d/BFS_3D.h>
 #include <boost/thread.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
 
 namespace sbpl_arm_planner{
 
@@ -36,6 +37,8 @@ BFS_3D::BFS_3D(int width, int height, int length) {
     }
 
     running = false;
+    search_start_time = 0;
+    search_end_time = 0;
 }
 
 BFS_3D::~BFS_3D() {
@@ -82,8 +85,11 @@ void BFS_3D::run(int x, int y, int z) {
 
     distance_grid[origin] = 0;
 
-    boost::thread searchThread(&BFS_3D::search, this, dim_x, dim_xy, distance_grid, queue, queue_head, queue_tail);
+    // set before the thread starts, a short search could finish first
     running = true;
+    search_start_time = now();
+    search_end_time = search_start_time;
+    boost::thread searchThread(&BFS_3D::search, this, dim_x, dim_xy, distance_grid, queue, queue_head, queue_tail);
 }
 
 int BFS_3D::getDistance(int x, int y, int z) {
@@ -93,4 +99,23 @@ int BFS_3D::getDistance(int x, int y, int z) {
     return distance_grid[node];
 }
 
+bool BFS_3D::isRunning() {
+    return running;
+}
+
+double BFS_3D::getSearchTime() {
+    if (running)
+        return now() - search_start_time;
+    return search_end_time - search_start_time;
+}
+
+double BFS_3D::getSearchStartTime() {
+    return search_start_time;
+}
+
+double BFS_3D::now() {
+    static const boost::posix_time::ptime epoch(boost::gregorian::date(1970, 1, 1));
+    return (boost::posix_time::microsec_clock::universal_time() - epoch).total_microseconds() / 1e6;
+}
+
 }
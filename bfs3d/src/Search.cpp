@@ -40,6 +40,7 @@ void BFS_3D::search(int width, int planeSize, int volatile* distance_grid, int*
         EXPAND_NEIGHBOR(width+1-planeSize);
         EXPAND_NEIGHBOR(width-1-planeSize);
     }
+    search_end_time = now();
     running = false;
 }
 }
@@ -4,12 +4,14 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <map>
 #include <iterator>
 #include <ros/ros.h>
 #include <angles/angles.h>
 #include <sstream>
 #include <boost/algorithm/string.hpp>
 #include <sbpl_manipulation_components/motion_primitive.h>
+#include <sbpl_manipulation_components/robot_model.h>
 
 namespace sbpl_arm_planner {
 
@@ -18,6 +20,8 @@ class EnvironmentROBARM3D;
 enum MotionPrimitiveType {
   LONG_DISTANCE,
   SHORT_DISTANCE,
+  COARSE_DISTANCE,
+  FOLLOW_BFS_PATH,
   SNAP_TO_RPY,
   SNAP_TO_XYZ_RPY,
   NUMBER_OF_MPRIM_TYPES
@@ -30,12 +34,47 @@ class ActionSet
 
     ~ActionSet(){};
 
-    bool init(EnvironmentROBARM3D *env);
+    /** \brief rm is the robot model of the search thread that uses the action set (NULL for the env's) */
+    bool init(EnvironmentROBARM3D *env, RobotModel *rm=NULL);
 
     bool getActionSet(const RobotState &parent, std::vector<Action> &actions);
 
+    /** \brief Also returns the id of each action's primitive (-1 for the IK snap), coarse
+     * replaces the long distance primitives with the coarse ones far from the goal */
+    bool getActionSet(const RobotState &parent, bool coarse, std::vector<Action> &actions, std::vector<int> &mprims);
+
+    int getNumMotionPrimitives() { return int(mp_.size()); }
+
+    /** \brief Max motion of each joint by a primitive, per cost of a fine primitive (without the IK snap) */
+    void getMaxJointSteps(std::vector<double> &steps);
+
     void print();
 
+    std::string getActionFile() { return action_file_; }
+
+    /** \brief Switch between long & short distance primitives by the distance to the goal */
+    void setUseMultiresMprims(bool use) { use_multires_mprims_ = use; }
+
+    bool getUseMultiresMprims() { return use_multires_mprims_; }
+
+    /** \brief Adds the long distance primitives scaled by factor (call it before init),
+     * they're used instead of the long ones farther than dist_thresh_m from the goal */
+    void setCoarseMprims(int factor, double dist_thresh_m);
+
+    /** \brief Adds the primitive that moves the planning link down the bfs (call it before init) */
+    void setBFSPathMprim(int lookahead_cells, int iterations, double max_step, double damping);
+
+    /** \brief When IK of the goal fails, snap to the closest of the goal check's
+     * IK solutions if none of the joints has to move more than max_joint_dist */
+    void setIKSnapFallback(double max_joint_dist) { ik_fallback_max_dist_ = max_joint_dist; }
+
+    bool isCoarseMotionPrimitive(int id) { return id >= 0 && id < int(mp_.size()) && mp_[id].type == COARSE_DISTANCE; }
+
+    /** \brief Adds the IK & joint limit counters to the stats */
+    void getStats(std::map<std::string, double> &stats);
+
+    void resetStats();
+
   private:
 
     bool use_multires_mprims_;
@@ -46,21 +85,76 @@ class ActionSet
 
     double ik_amp_dist_thresh_m_;
 
+    int coarse_factor_;
+
+    double coarse_dist_thresh_m_;
+
+    /* bfs path primitive: damped least squares steps of the planning link
+     * toward the cell lookahead cells down the bfs */
+    bool use_bfs_path_mprim_;
+    int bfs_path_lookahead_;
+    int bfs_path_iterations_;
+    double bfs_path_max_step_;
+    double bfs_path_damping_;
+    double ik_fallback_max_dist_;
+
     std::string action_file_;
 
     EnvironmentROBARM3D *env_;
 
+    RobotModel *rm_;
+
     std::vector<MotionPrimitive> mp_;
 
     std::vector<std::string> motion_primitive_type_names_;
 
+    int ik_calls_;
+    int ik_cache_hits_;
+    int ik_failures_;
+    int ik_snap_fallbacks_;
+    int joint_limit_failures_;
+    int bfs_path_calls_;
+    int bfs_path_failures_;
+
+    /* IK snaps to ik_cache_goal_ by parent, the search expands the states
+     * near the goal again with every epsilon */
+    typedef struct
+    {
+      bool found;
+      RobotState solution;
+    } IKCacheEntry;
+    std::vector<double> ik_cache_goal_;
+    std::map<RobotState, IKCacheEntry> ik_cache_;
+
+    /* the parent angles for which a primitive stays within the joint limits,
+     * [joint][primitive], the parent's angle minus lo (mod 2pi) has to be <= width */
+    bool use_limit_ranges_;
+    std::vector<std::vector<double> > limit_lo_;
+    std::vector<std::vector<double> > limit_width_;
+    std::vector<bool> limit_range_;
+    std::vector<unsigned char> admissible_;
+    std::vector<double> limit_parent_;
+
+    void computeLimitRanges();
+
+    /** \brief Sets admissible_ for all of the primitives at once */
+    void filterJointLimits(const RobotState &parent);
+
+    bool checkJointLimits(const Action &action);
+
     bool getMotionPrimitivesFromFile(FILE* fCfg);
 
     void addMotionPrim(const std::vector<double> &mprim, bool add_converse, bool short_dist_mprim);
 
     bool applyMotionPrimitive(const RobotState &state, MotionPrimitive &mp, Action &action);
 
-    bool getAction(const RobotState &parent, double dist_to_goal, MotionPrimitive &mp, Action &action);
+    void addCoarseMprims();
+
+    void addBFSPathMprim();
+
+    bool getBFSPathAction(const RobotState &parent, Action &action);
+
+    bool getAction(const RobotState &parent, double dist_to_goal, bool coarse, MotionPrimitive &mp, Action &action);
 };
 
 }
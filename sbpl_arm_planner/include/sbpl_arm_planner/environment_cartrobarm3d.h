@@ -66,11 +66,6 @@ class EnvironmentCARTROBARM3D: public EnvironmentROBARM3D
 
     void printEnvironmentStats();
 
-    void computeGradient(const MotionPrimitive &mp, unsigned char &d, bool collision);
-
-    std::vector<double> mp_gradient_;
-    std::vector<double> mp_dist_;
-
     int getXYZRPYHeuristic(int FromStateID, int ToStateID);
 
   protected:
@@ -115,7 +110,7 @@ class EnvironmentCARTROBARM3D: public EnvironmentROBARM3D
     bool getMotionPrimitive(EnvROBARM3DHashEntry_t* parent, MotionPrimitive &mp);
     int isMotionValid(const std::vector<double> &start, const std::vector<double> &end, int &path_length, int &nchecks, unsigned char &dist);
     void getVector(int x1, int y1, int z1, int x2, int y2, int z2, int &xout, int &yout, int &zout, int multiplier, bool snap=true);
-    bool getDistanceGradient(int &x, int &y, int &z);
+    bool getDistanceGradient(EnvROBARM3DHashEntry_t* parent, int &x, int &y, int &z);
     void computeCostPerCell();
     int computeMotionCost(const std::vector<double> &a, const std::vector<double> &b);
 };
@@ -35,6 +35,7 @@
 #include <time.h>
 #include <vector>
 #include <string>
+#include <map>
 #include <angles/angles.h>
 #include <bfs3d/BFS_3D.h>
 #include <sbpl/sbpl_exception.h>
@@ -44,9 +45,15 @@
 #include <sbpl_manipulation_components/occupancy_grid.h>
 #include <sbpl_manipulation_components/robot_model.h>
 #include <sbpl_manipulation_components/collision_checker.h>
+#include <sbpl_manipulation_components/tracer.h>
+#include <sbpl_manipulation_components/reachability_map.h>
 #include <sbpl_arm_planner/action_set.h>
 #include <sbpl_arm_planner/planning_params.h>
+#include <sbpl_arm_planner/sbpl_arm_planning_error_codes.h>
+#include <sbpl_arm_planner/experience_graph.h>
+#include <sbpl_arm_planner/primitive_stats.h>
 #include <trajectory_msgs/JointTrajectory.h>
+#include <boost/thread/mutex.hpp>
 
 namespace sbpl_arm_planner {
 
@@ -94,6 +101,54 @@ typedef struct
   RobotState state;
 } EnvROBARM3DHashEntry_t;
 
+/** counters collected by the environment over one planning request */
+typedef struct
+{
+  int expansions;
+  int generated_states;
+  int hash_lookups;
+  int hash_hits;
+  int state_checks;
+  int state_checks_failed;
+  int edge_checks;
+  int edge_checks_failed;
+  int fk_failures;
+  int bfs_runs;
+  int bfs_reused;
+  double set_walls_time;
+  int egraph_succs;
+  int egraph_shortcuts;
+  int egraph_snaps;
+  double egraph_validation_time;
+  int goal_flagged_unreachable;
+  int goal_ik_solutions;
+  int start_repair_steps;
+  int coarse_expansions;
+  int deferred_edges_checked;
+  int deferred_edges_rejected;
+} EnvironmentStats;
+
+/** edge of a deferred motion primitive, it's generated without being checked */
+typedef struct
+{
+  RobotState source;
+  Action action;
+  int block;               // of the primitive stats
+  int mprim;
+  int valid;               // -1 until a solution uses the edge
+} DeferredEdge;
+
+/** the robot model, collision checker & action set that a search thread expands states with */
+typedef struct
+{
+  RobotModel *rm;
+  CollisionChecker *cc;
+  ActionSet *as;
+
+  // collision check counters of the thread (thread 0 counts into the env's stats)
+  EnvironmentStats stats;
+} SearchThread;
+
 /** main structure that stores environment data used in planning */
 typedef struct EnvironmentPlanningData
 {
@@ -105,6 +160,21 @@ typedef struct EnvironmentPlanningData
   EnvROBARM3DHashEntry_t* goal_entry;
   EnvROBARM3DHashEntry_t* start_entry;
 
+  // position the heuristic leads to (the start when searching backward)
+  double heur_target[3];
+
+  // backward search: the goal entry is a meta state whose predecessors
+  // are these IK solutions of the goal pose
+  std::vector<int> goal_ik_ids;
+
+  // forward search: collision free IK solutions of the goal pose found by
+  // the feasibility check, the IK snap falls back to them
+  std::vector<RobotState> goal_ik_solutions;
+
+  // the motion from a colliding start configuration to the (repaired) start
+  // state of the search, without the latter
+  std::vector<RobotState> start_recovery;
+
   // maps from coords to stateID
   int HashTableSize;
   std::vector<EnvROBARM3DHashEntry_t*>* Coord2StateIDHashTable;
@@ -115,12 +185,16 @@ typedef struct EnvironmentPlanningData
   // stateIDs of expanded states
   std::vector<int> expanded_states;
 
+  EnvironmentStats stats;
+
   EnvironmentPlanningData()
   {
     near_goal = false;
+    heur_target[0] = heur_target[1] = heur_target[2] = 0;
     start_entry = NULL;
     goal_entry = NULL;
     Coord2StateIDHashTable = NULL;
+    memset(&stats, 0, sizeof(stats));
   }
 
   void init()
@@ -148,6 +222,10 @@ class EnvironmentROBARM3D: public DiscreteSpaceInformation
     virtual bool convertStateIDPathToJointTrajectory(const std::vector<int> &idpath, trajectory_msgs::JointTrajectory &traj);
     virtual void convertStateIDPathToShortenedJointAnglesPath(const std::vector<int> &idpath, std::vector<std::vector<double> > &path, std::vector<int> &idpath_short){};
     virtual void GetSuccs(int SourceStateID, vector<int>* SuccIDV, vector<int>* CostV);
+
+    /** \brief Expands the state with the resources of a search thread, it can be called by
+     * several threads at once (with different thread ids) while the parallel search is on */
+    void GetSuccs(int SourceStateID, vector<int>* SuccIDV, vector<int>* CostV, int thread);
     virtual void StateID2Angles(int stateID, std::vector<double> &angles);
     virtual int getXYZRPYHeuristic(int FromStateID, int ToStateID){return 0;};
 
@@ -166,8 +244,61 @@ class EnvironmentROBARM3D: public DiscreteSpaceInformation
     
     RobotModel* getRobotModel(){ return rmodel_; };
     std::vector<double> getGoal();
+
+    const std::vector<RobotState>& getGoalIKSolutions() { return pdata_.goal_ik_solutions; }
+
+    /** \brief The motion out of collision that has to precede the plan (empty if the start was valid) */
+    const std::vector<RobotState>& getStartRecoveryPath() { return pdata_.start_recovery; }
+
+    /** \brief Why the last goal was rejected (SUCCESS if it wasn't) */
+    DebugCode getDebugCode() { return debug_code_; }
     double getDistanceToGoal(double x, double y, double z);
 
+    /** \brief The cell num_cells down the bfs from the cell of (x,y,z) (false if it isn't reached or is the goal) */
+    bool getBFSPathWaypoint(double x, double y, double z, int num_cells, std::vector<double> &waypoint);
+
+    /** \brief Per-request statistics of the environment & action set */
+    void getStats(std::map<std::string, double> &stats);
+
+    void resetStats();
+
+    /** \brief Adds the spans timed outside of the env's thread (the bfs, once it's done) to the trace */
+    void addTraceEvents();
+
+    /** \brief Forces the BFS to be recomputed for the next goal (e.g. when the world changes) */
+    void invalidateHeuristic();
+
+    bool isSearchingBackward() { return prm_->search_backward_; }
+
+    /** \brief Bias the search toward the paths in the experience graph (NULL to disable) */
+    void setExperienceGraph(ExperienceGraph *egraph);
+
+    /** \brief Goals that the map doesn't reach are rejected before the bfs (NULL to turn it off) */
+    void setReachabilityMap(ReachabilityMap *rmap) { rmap_ = rmap; }
+
+    /** \brief Adds a thread for the parallel search (thread 0 uses the env's own), they
+     * can't share a robot model, collision checker or action set */
+    void addSearchThread(RobotModel *rm, CollisionChecker *cc, ActionSet *as);
+
+    int getNumSearchThreads() { return int(search_threads_.size()); }
+
+    /** \brief Locks the state table & the heuristic while the parallel search is on */
+    void setParallelSearch(bool parallel);
+
+    /** \brief Lower bound on the cost of any path between the states */
+    int getLowerBoundCost(int FromStateID, int ToStateID);
+
+    /** \brief Cost of the edge as GetSuccs generates it (coarse primitives & experience graph edges included),
+     * -1 if it isn't a successor. Call it while no search is running. */
+    int getSuccessorCost(int FromStateID, int ToStateID);
+
+    /** \brief Checks the edges of deferred primitives along the path, false if one is in collision (the search
+     * has to run again, it won't generate the edge anymore) */
+    bool checkDeferredEdges(const std::vector<int> &path);
+
+    /** \brief No successors are generated while *cancel is set, so a running search drains its open list & returns */
+    void setCancelFlag(const volatile bool *cancel);
+
     visualization_msgs::MarkerArray getVisualization(std::string type);
 
   protected:
@@ -178,9 +309,73 @@ class EnvironmentROBARM3D: public DiscreteSpaceInformation
     BFS_3D *bfs_;
     ActionSet *as_;
 
+    /* thread 0 is the env's own robot model, collision checker & action set */
+    std::vector<SearchThread> search_threads_;
+
+    /* guards the state table, the goal entry, the primitive stats & the deferred edges in a parallel search */
+    bool parallel_;
+    boost::mutex table_mutex_;
+
+    /* max motion of each joint per cost_multiplier_ of a primitive (for the lower bound) */
+    std::vector<double> max_joint_steps_;
+
+    /* goal cell the BFS was last run from, it is reused for goals in the same cell */
+    bool bfs_valid_;
+    bool bfs_traced_;
+    int bfs_goal_[3];
+
+    /* experience graph, nodes & edges are checked when the search first uses them (once per scene) */
+    ExperienceGraph *egraph_;
+    bool egraph_validated_;                           // the known validity is of the current scene
+    int egraph_version_;                              // of the graph that's indexed
+    int egraph_indexed_;                              // # of the nodes that are indexed
+
+    /* success rates of the motion primitives (reset with the heuristic) */
+    PrimitiveStats mprim_stats_;
+
+    /* unchecked edges of deferred primitives by (source, successor) state ID (reset with the heuristic) */
+    std::map<std::pair<int,int>, DeferredEdge> deferred_edges_;
+
+    ReachabilityMap *rmap_;
+
+    /** \brief false if the goal should be rejected, warns if it's only flagged */
+    bool checkGoalReachability();
+
+    DebugCode debug_code_;
+
+    /** \brief Collision free IK solutions of the goal pose from the start & of random poses within the goal tolerance from random seeds, returns the # of IK solutions */
+    int sampleGoalIKSolutions(int num_seeds, double timeout, std::vector<RobotState> &solutions);
+
+    /** \brief false if none of the seeded IK solutions of the goal pose is collision free */
+    bool checkGoalFeasibility();
+
+    /** \brief Steps a colliding configuration out of collision (with the collision checker's repair steps) */
+    bool repairStartConfiguration(RobotState &angles);
+    std::vector<bool> egraph_node_ok_;                // has an FK solution & is within the joint limits
+    std::vector<signed char> egraph_node_valid_;      // 1: valid  0: invalid  -1: not checked yet
+    std::vector<std::vector<signed char> > egraph_edge_valid_;
+    std::vector<int> egraph_xyz_;                     // planning link cell of each node (x,y,z)
+    std::vector<int> egraph_heur_;                    // cost to goal through the graph
+    std::vector<int> egraph_next_;                    // next node toward the goal (-1: leave the graph)
+    std::map<std::vector<int>, int> egraph_coord2node_;
+    std::map<int, std::vector<int> > egraph_cell2nodes_;
+
+    /* the nodes that lead to the goal in cubes of egraph_bucket_size_ cells, for the heuristic */
+    typedef struct
+    {
+      int lo[3];
+      int hi[3];
+      int min_heur;
+      std::vector<int> nodes;
+    } EGraphBucket;
+    static const int egraph_bucket_size_ = 8;
+    std::vector<EGraphBucket> egraph_buckets_;
+
     EnvironmentPlanningData pdata_;
     PlanningParams *prm_;
 
+    const volatile bool *cancel_;
+
     // function pointers for heuristic function
     int (EnvironmentROBARM3D::*getHeuristic_) (int FromStateID, int ToStateID);
 
@@ -196,6 +391,23 @@ class EnvironmentROBARM3D: public DiscreteSpaceInformation
 
     /** planning */
     virtual bool isGoalState(const std::vector<double> &pose, GoalConstraint &goal);
+    bool isActionValid(const RobotState &source_angles, const Action &action, int i, double &dist, int thread=0);
+
+    /** \brief true if the state is on the coarse lattice & far enough from the obstacles */
+    bool isCoarseState(EnvROBARM3DHashEntry_t* entry);
+    bool computeGoalIKSolutions();
+    EnvROBARM3DHashEntry_t* getSuccessorEntry(const RobotState &angles, double dist, bool &is_goal, int thread=0);
+
+    EnvironmentStats& getThreadStats(int thread) { return thread == 0 ? pdata_.stats : search_threads_[thread].stats; }
+
+    /** experience graph */
+    void indexExperienceGraph();
+    bool isExperienceGraphNodeValid(int n);
+    bool isExperienceGraphEdgeValid(int n, int j);
+    void computeExperienceGraphHeuristic();
+    void getExperienceGraphSuccs(EnvROBARM3DHashEntry_t* parent, const RobotState &parent_angles, vector<int>* SuccIDV, vector<int>* CostV);
+    int getExperienceGraphHeuristic(int FromStateID, int ToStateID);
+    int getCellIndex(int x, int y, int z) const;
 
     /** costs */
     int cost(EnvROBARM3DHashEntry_t* HashEntry1, EnvROBARM3DHashEntry_t* HashEntry2, bool bState2IsGoal);
@@ -0,0 +1,77 @@
+/** \author Benjamin Cohen */
+
+#ifndef _EXPERIENCE_GRAPH_H_
+#define _EXPERIENCE_GRAPH_H_
+
+#include <string>
+#include <vector>
+#include <boost/unordered_map.hpp>
+#include <sbpl_manipulation_components/motion_primitive.h>
+
+namespace sbpl_arm_planner{
+
+/* A joint-space graph built from the paths of previous plans. Nodes are
+ * the lattice states of the paths, edges join consecutive states. The
+ * graph is persistent (see load/save); whether its nodes and edges are
+ * still valid is decided by the environment for every new scene. Waypoints
+ * that round to the same joint angles (at the resolution) are one node,
+ * they're found with a hash table. Adding a path only appends nodes & edges,
+ * the ids only change when the graph is pruned or loaded (see getVersion). */
+class ExperienceGraph
+{
+  public:
+
+    typedef struct
+    {
+      RobotState angles;
+      std::vector<int> edges;
+      int last_used;                    // the last path that went through it
+    } Node;
+
+    ExperienceGraph();
+
+    /** \brief The joint angles of two waypoints that are one node are within half of it (radians) */
+    void setResolution(const std::vector<double> &resolution);
+
+    bool load(std::string filename);
+
+    /** \brief Written to filename.tmp first, so a reader never sees half of it */
+    bool save(std::string filename) const;
+
+    /** \brief Add a path, states already in the graph are reused */
+    void addPath(const std::vector<RobotState> &path);
+
+    /** \brief Removes the nodes that were least recently on a path until there are max_nodes left, false if none were */
+    bool prune(int max_nodes);
+
+    int getNumNodes() const { return int(nodes_.size()); }
+
+    int getNumEdges() const;
+
+    const Node& getNode(int id) const { return nodes_[id]; }
+
+    /** \brief Changes whenever the nodes are renumbered */
+    int getVersion() const { return version_; }
+
+    void clear();
+
+  private:
+
+    std::vector<Node> nodes_;
+    std::vector<double> resolution_;
+    boost::unordered_map<std::vector<int>, int> index_;
+    int num_paths_;
+    int version_;
+
+    void getKey(const RobotState &angles, std::vector<int> &key) const;
+
+    /** \brief Returns the id of the node with these angles, adds it if it isn't there */
+    int getNode(const RobotState &angles);
+
+    void addEdge(int from, int to);
+};
+
+}
+
+#endif
+
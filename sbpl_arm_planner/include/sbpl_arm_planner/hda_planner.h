@@ -0,0 +1,143 @@
+/** \author Benjamin Cohen */
+
+#ifndef _HDA_PLANNER_H_
+#define _HDA_PLANNER_H_
+
+#include <set>
+#include <vector>
+#include <boost/unordered_map.hpp>
+#include <sbpl/planners/planner.h>
+#include <sbpl_arm_planner/environment_robarm3d.h>
+#include <sbpl_arm_planner/mpsc_queue.h>
+
+namespace sbpl_arm_planner {
+
+/* Hash distributed weighted A* (HDA*), one worker per search thread of the
+ * env. Every state is owned by one worker, picked by hashing its id (the
+ * env gives every coordinate an id the first time it's seen), & only the
+ * owner keeps its g-value & parent & puts it in its OPEN. A successor owned
+ * by another worker is sent to it through the worker's lock-free queue.
+ * States are reopened when a cheaper path shows up, so the workers don't
+ * wait on each other. The search is over when a solution was found, no
+ * message is in flight & the smallest f-value in all of the OPEN lists isn't
+ * smaller than the solution's cost, which is then within w of the optimal
+ * one (w being the heuristic inflation). Each call to replan searches from
+ * scratch with the next w of the schedule (ARA*'s parameters), the
+ * first solution mode is ignored since the bound only holds once the search
+ * is over. Forward search only. */
+class HDAPlanner : public SBPLPlanner
+{
+  public:
+
+    HDAPlanner(EnvironmentROBARM3D *env);
+
+    ~HDAPlanner();
+
+    int replan(double allocated_time_secs, std::vector<int>* solution_stateIDs_V);
+    int replan(double allocated_time_secs, std::vector<int>* solution_stateIDs_V, int* solcost);
+    int replan(std::vector<int>* solution_stateIDs_V, ReplanParams params);
+    int replan(std::vector<int>* solution_stateIDs_V, ReplanParams params, int* solcost);
+
+    int set_goal(int goal_stateID);
+    int set_start(int start_stateID);
+    void costs_changed(StateChangeQuery const & stateChange){};
+    int force_planning_from_scratch();
+    /** \brief No-op, every search runs until its solution is within w */
+    int set_search_mode(bool bSearchUntilFirstSolution);
+
+    void set_initialsolution_eps(double initialsolution_eps) { initial_w_ = initialsolution_eps; }
+    double get_solution_eps() const { return solution_eps_; }
+    int get_n_expands() const { return n_expands_; }
+    double get_initial_eps() { return initial_eps_; }
+    double get_initial_eps_planning_time() { return initial_eps_time_; }
+    double get_final_eps_planning_time() { return final_eps_time_; }
+    int get_n_expands_init_solution() { return n_expands_init_solution_; }
+    double get_final_epsilon() { return solution_eps_; }
+
+    /** \brief # of the successors that were sent to another worker */
+    int get_n_messages() const { return n_messages_; }
+
+    /** \brief # of the expansions of states that were already expanded */
+    int get_n_reexpands() const { return n_reexpands_; }
+
+  private:
+
+    typedef struct
+    {
+      int g;
+      int h;
+      int parent;
+      bool closed;
+      double f;
+    } SearchState;
+
+    typedef struct
+    {
+      int id;
+      int g;
+      int parent;
+    } Message;
+
+    typedef struct
+    {
+      boost::unordered_map<int, SearchState> states;
+      std::set<std::pair<double, int> > open;
+      MPSCQueue<Message> queue;
+
+      /* smallest f-value in OPEN (or of the state being expanded) as seen by the others */
+      volatile double min_f;
+      int n_expands;
+      int n_messages;
+      int n_reexpands;
+    } Worker;
+
+    EnvironmentROBARM3D *env_;
+
+    int start_id_;
+    int goal_id_;
+
+    /* heuristic inflation of the current search (negative before the first one) */
+    double w_;
+    double initial_w_;
+
+    std::vector<Worker*> workers_;
+
+    /* only the owner of the goal sets it */
+    volatile int solution_cost_;
+    volatile bool done_;
+
+    /* the messages that were sent & the ones that were put in OPEN by their owner */
+    volatile long n_sent_;
+    volatile long n_received_;
+
+    ros::WallTime t_start_;              // of the first search since force_planning_from_scratch
+    ros::WallTime deadline_;
+
+    int n_expands_;
+    int n_messages_;
+    int n_reexpands_;
+    double solution_eps_;
+    double initial_eps_;
+    double initial_eps_time_;
+    double final_eps_time_;
+    int n_expands_init_solution_;
+
+    void clearWorkers();
+
+    int getOwner(int id) const;
+
+    /** \brief Expands the states of the worker until the search is over or time is up */
+    void search(int thread);
+
+    /** \brief The worker found a path to a state it owns */
+    void relax(Worker &w, int id, int g, int parent);
+
+    void publishMinF(Worker &w);
+
+    /** \brief No message in flight & no state in OPEN can lead to a cheaper solution */
+    bool isDone();
+};
+
+}
+
+#endif
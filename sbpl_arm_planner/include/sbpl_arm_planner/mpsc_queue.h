@@ -0,0 +1,79 @@
+/** \author Benjamin Cohen */
+
+#ifndef _MPSC_QUEUE_H_
+#define _MPSC_QUEUE_H_
+
+#include <stddef.h>
+
+namespace sbpl_arm_planner {
+
+/* Unbounded lock-free queue with many producers & a single consumer
+ * (Vyukov's). A producer swaps its node in as the new head & links the old
+ * head to it, the consumer follows the links from the tail, which is always
+ * a node that was already popped (a dummy to begin with). A push that's in
+ * between the swap & the link isn't seen by pop until it's linked. */
+template <typename T>
+class MPSCQueue
+{
+  public:
+
+    MPSCQueue()
+    {
+      tail_ = new Node;
+      tail_->next = NULL;
+      head_ = tail_;
+    }
+
+    ~MPSCQueue()
+    {
+      T value;
+      while(pop(value));
+      delete tail_;
+    }
+
+    /** \brief Any thread */
+    void push(const T &value)
+    {
+      Node *node = new Node;
+      node->value = value;
+      node->next = NULL;
+      Node *prev = __sync_lock_test_and_set(&head_, node);
+      // the node has to be complete before the consumer can reach it
+      __sync_synchronize();
+      prev->next = node;
+    }
+
+    /** \brief Only the consumer, false if the queue is empty */
+    bool pop(T &value)
+    {
+      Node *next = tail_->next;
+      if(next == NULL)
+        return false;
+      __sync_synchronize();
+      value = next->value;
+      delete tail_;
+      tail_ = next;
+      return true;
+    }
+
+    /** \brief Only the consumer */
+    bool empty() const { return tail_->next == NULL; }
+
+  private:
+
+    struct Node
+    {
+      Node * volatile next;
+      T value;
+    };
+
+    Node * volatile head_;
+    Node *tail_;
+
+    MPSCQueue(const MPSCQueue&);
+    MPSCQueue& operator=(const MPSCQueue&);
+};
+
+}
+
+#endif
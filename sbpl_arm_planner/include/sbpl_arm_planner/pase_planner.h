@@ -0,0 +1,114 @@
+/** \author Benjamin Cohen */
+
+#ifndef _PASE_PLANNER_H_
+#define _PASE_PLANNER_H_
+
+#include <set>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <sbpl/planners/planner.h>
+#include <sbpl_arm_planner/environment_robarm3d.h>
+
+namespace sbpl_arm_planner {
+
+/* Weighted A* that expands several states at once, one per search thread
+ * of the env (PA*SE). A state in OPEN is safe to expand when none of the
+ * states ahead of it in OPEN or being expanded can lower its g-value by
+ * more than a factor of epsilon, i.e. g(s) <= g(s') + epsilon * c_l(s',s)
+ * for all of them, c_l being the env's lower bound on the cost between two
+ * states. Safe states aren't reopened, so the cost of the solution is
+ * within w * epsilon of the optimal one (w being the heuristic inflation).
+ * Each call to replan searches from scratch with the next w of the
+ * schedule (ARA*'s parameters). Forward search only. */
+class PASEPlanner : public SBPLPlanner
+{
+  public:
+
+    /** \brief max_candidates is the # of states at the front of OPEN that are checked for a safe one */
+    PASEPlanner(EnvironmentROBARM3D *env, double epsilon, int max_candidates);
+
+    ~PASEPlanner(){};
+
+    int replan(double allocated_time_secs, std::vector<int>* solution_stateIDs_V);
+    int replan(double allocated_time_secs, std::vector<int>* solution_stateIDs_V, int* solcost);
+    int replan(std::vector<int>* solution_stateIDs_V, ReplanParams params);
+    int replan(std::vector<int>* solution_stateIDs_V, ReplanParams params, int* solcost);
+
+    int set_goal(int goal_stateID);
+    int set_start(int start_stateID);
+    void costs_changed(StateChangeQuery const & stateChange){};
+    int force_planning_from_scratch();
+    int set_search_mode(bool bSearchUntilFirstSolution);
+
+    void set_initialsolution_eps(double initialsolution_eps) { initial_w_ = initialsolution_eps; }
+    double get_solution_eps() const { return solution_eps_; }
+    int get_n_expands() const { return n_expands_; }
+    double get_initial_eps() { return initial_eps_; }
+    double get_initial_eps_planning_time() { return initial_eps_time_; }
+    double get_final_eps_planning_time() { return final_eps_time_; }
+    int get_n_expands_init_solution() { return n_expands_init_solution_; }
+    double get_final_epsilon() { return solution_eps_; }
+
+    /** \brief # of the times that a thread found no safe state in OPEN & waited */
+    int get_n_waits() const { return n_waits_; }
+
+  private:
+
+    typedef struct
+    {
+      int g;
+      int h;
+      int parent;
+      bool closed;
+      double f;
+    } SearchState;
+
+    EnvironmentROBARM3D *env_;
+    double epsilon_;
+    int max_candidates_;
+
+    int start_id_;
+    int goal_id_;
+    bool first_solution_only_;
+
+    /* heuristic inflation of the current search (negative before the first one) */
+    double w_;
+    double initial_w_;
+
+    std::vector<SearchState> states_;
+    std::set<std::pair<double, int> > open_;
+    std::vector<int> being_expanded_;
+
+    boost::mutex mutex_;
+    boost::condition_variable cond_;
+    bool done_;
+    bool found_;
+    ros::WallTime t_start_;              // of the first search since force_planning_from_scratch
+    ros::WallTime deadline_;
+
+    int n_expands_;
+    int n_waits_;
+    double solution_eps_;
+    double initial_eps_;
+    double initial_eps_time_;
+    double final_eps_time_;
+    int n_expands_init_solution_;
+
+    /** \brief Expands safe states until the goal is safe, OPEN is empty or time is up */
+    void search(int thread);
+
+    /** \brief The first safe state among the candidates at the front of OPEN, -1 if there's none */
+    int selectState();
+
+    bool isSafe(int id, int ahead_id);
+
+    SearchState& getState(int id);
+
+    void insert(int id);
+};
+
+}
+
+#endif
+
@@ -0,0 +1,74 @@
+/** \author Benjamin Cohen */
+
+#ifndef _PERF_COUNTERS_H_
+#define _PERF_COUNTERS_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace sbpl_arm_planner{
+
+/* Hardware performance counters (cycles, instructions, LLC misses & branch
+ * misses) of the calling thread, read with Linux's perf_event interface.
+ * The counts are kept for the last run of each named phase. A counter that
+ * the kernel or the CPU doesn't support (or isn't allowed to be used, see
+ * perf_event_paranoid) is skipped, so a phase may have fewer or no counts.
+ * The counters run from when they are opened & a phase is the difference
+ * between two reads, so the threads started by the calling thread (i.e. the
+ * bfs) are added to the phase during which they exit. */
+class PerfCounters
+{
+  public:
+
+    enum
+    {
+      CYCLES,
+      INSTRUCTIONS,
+      LLC_MISSES,
+      BRANCH_MISSES,
+      NUMBER_OF_COUNTERS
+    };
+
+    PerfCounters();
+
+    ~PerfCounters();
+
+    /** \brief Open the counters for the calling thread (reopened if it was another one) */
+    bool open();
+
+    void close();
+
+    /** \brief true if at least one of the counters could be opened */
+    bool isOpen();
+
+    /** \brief Clear the counts of all of the phases */
+    void reset();
+
+    void reset(const std::string &phase);
+
+    /** \brief Opens the counters if needed & reads their starting values */
+    void start();
+
+    /** \brief Set the phase's counts to the counts since start() */
+    void stop(const std::string &phase);
+
+    /** \brief Adds '<phase> cycles', '<phase> instructions', etc. */
+    void getStats(std::map<std::string, double> &stats);
+
+  private:
+
+    int fd_[NUMBER_OF_COUNTERS];
+    bool started_[NUMBER_OF_COUNTERS];
+    unsigned long long start_[NUMBER_OF_COUNTERS][3];
+    long tid_;
+    bool warned_;
+    std::map<std::string, std::vector<double> > counts_;
+
+    bool readCounter(int i, unsigned long long v[3]);
+};
+
+}
+
+#endif
+
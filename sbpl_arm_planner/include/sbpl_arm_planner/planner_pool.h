@@ -0,0 +1,121 @@
+/** \author Benjamin Cohen */
+
+#ifndef _PLANNER_POOL_H_
+#define _PLANNER_POOL_H_
+
+#include <deque>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <sbpl_arm_planner/sbpl_arm_planner_interface.h>
+
+namespace sbpl_arm_planner{
+
+/** \brief Outcome of one goal of a batch request */
+typedef struct
+{
+  bool success;
+  int cost;
+  double planning_time;
+  int planner_id;
+  trajectory_msgs::JointTrajectory trajectory;
+  std::map<std::string, double> stats;
+} BatchPlanningResult;
+
+/* A pool of planner instances that share one distance field so that
+ * several planning requests can be serviced at the same time. Every
+ * planner owns its own environment (state tables, BFS heuristic),
+ * search and parameters. The robot model, collision checker and action
+ * set keep per-query scratch data (KDL solvers, FK frames, env binding)
+ * so each planner has to be given its own instances of those. */
+class PlannerPool
+{
+  public:
+
+    PlannerPool(distance_field::PropagationDistanceField* df);
+
+    ~PlannerPool();
+
+    /** \brief Add a planner to the pool. The components are not owned by the pool. */
+    bool addPlanner(RobotModel *rm, CollisionChecker *cc, ActionSet *as);
+
+    /** \brief Add another search thread to the last planner that was added
+     * (before init), for planning/search_threads. Not owned by the pool either. */
+    bool addSearchThread(RobotModel *rm, CollisionChecker *cc, ActionSet *as);
+
+    /** \brief Initialize all of the planners in the pool */
+    bool init();
+
+    int size();
+
+    /** \brief Blocks until a planner is free and then plans with it. Safe
+     * to call from several threads. Requests that use the same
+     * planning scene (same pointer) run concurrently, a request with a
+     * new scene waits for the running ones to finish before it updates
+     * the distance field. */
+    bool solve(const arm_navigation_msgs::PlanningSceneConstPtr& planning_scene, const arm_navigation_msgs::GetMotionPlan::Request &req, arm_navigation_msgs::GetMotionPlan::Response &res, std::map<std::string, double> *stats = NULL);
+
+    /** \brief Switch solve() to portfolio mode (an empty list switches it
+     * off). Every request is raced by up to one planner per configuration.
+     * With first_solution every planner stops at its first solution, the
+     * first one to succeed wins and the rest are cancelled, otherwise the
+     * cheapest solution found within the allowed planning time is
+     * returned. */
+    void setPortfolio(const std::vector<PlannerConfiguration> &configs, bool first_solution);
+
+    /** \brief Plan to many goals against one snapshot of the world. The
+     * scene is applied once, then the requests are spread over the idle
+     * planners. Requests whose goals fall in the same grid cell go to the
+     * same planner back to back so that they share its BFS heuristic.
+     * Returns false only if nothing could be planned at all. */
+    bool solveBatch(const arm_navigation_msgs::PlanningSceneConstPtr& planning_scene, const std::vector<arm_navigation_msgs::GetMotionPlan::Request> &reqs, std::vector<BatchPlanningResult> &results);
+
+  private:
+
+    distance_field::PropagationDistanceField* df_;
+
+    std::vector<SBPLArmPlannerInterface*> planners_;
+
+    /* scene applied to each planner's collision checker */
+    std::vector<arm_navigation_msgs::PlanningSceneConstPtr> planner_scenes_;
+
+    /* scene currently in the distance field */
+    arm_navigation_msgs::PlanningSceneConstPtr scene_;
+
+    std::deque<int> idle_;
+    boost::mutex idle_mutex_;
+    boost::condition_variable idle_cond_;
+
+    /* planners hold it shared while searching, scene updates hold it exclusively */
+    boost::shared_mutex scene_mutex_;
+
+    /* portfolio mode (under idle_mutex_, a request races the portfolio it started with) */
+    std::vector<PlannerConfiguration> portfolio_;
+    bool portfolio_first_solution_;
+    std::vector<PlannerConfiguration> default_configs_;
+
+    int acquirePlanner();
+
+    /** \brief Returns -1 if no planner is idle */
+    int tryAcquirePlanner();
+
+    void releasePlanner(int id);
+
+    bool applyScene(int id, const arm_navigation_msgs::PlanningSceneConstPtr& planning_scene);
+
+    /** \brief Bring the planners up to date with the scene. On success the
+     * scene lock is held shared and must be released with unlock_shared(). */
+    bool lockScene(const std::vector<int> &ids, const arm_navigation_msgs::PlanningSceneConstPtr& planning_scene, double &preprocess_time);
+
+    bool solvePortfolio(const std::vector<PlannerConfiguration> &portfolio, bool first_solution, const arm_navigation_msgs::PlanningSceneConstPtr& planning_scene, const arm_navigation_msgs::GetMotionPlan::Request &req, arm_navigation_msgs::GetMotionPlan::Response &res, std::map<std::string, double> *stats);
+
+    void planPortfolio(int index, int id, bool first_solution, const arm_navigation_msgs::GetMotionPlan::Request *req, arm_navigation_msgs::PlanningSceneConstPtr planning_scene, BatchPlanningResult *result, volatile bool *cancel, int *winner, boost::mutex *winner_mutex);
+
+    void planBatch(int id, const std::vector<int> &req_ids, const std::vector<arm_navigation_msgs::GetMotionPlan::Request> *reqs, arm_navigation_msgs::PlanningSceneConstPtr planning_scene, std::vector<BatchPlanningResult> *results);
+};
+
+}
+
+#endif
+
@@ -42,6 +42,21 @@ using namespace std;
 
 namespace sbpl_arm_planner {
 
+/** \brief Anytime search schedule. The search starts at initial_eps and
+ * steps epsilon down toward final_eps until the allowed planning time
+ * runs out or the stopping rules below say further search isn't worth it. */
+typedef struct
+{
+  double first_solution_time;   // target time for the first solution (0: none), the first search is cut off there...
+  double retry_eps_factor;      // ...& started over with its inflation times this (<= 1: no retry)
+  double initial_eps;
+  double final_eps;
+  double eps_step;              // minimum decrement of epsilon per iteration
+  double eps_decrease_ratio;    // if > 0, decrement by this fraction of (eps - final_eps)
+  double min_improvement_rate;  // stop when cost improves by less than this fraction per second...
+  int patience;                 // ...for this many iterations in a row
+  double iteration_growth;      // if > 0, stop when the next iteration (last * growth) would miss the deadline
+} SearchSchedule;
 
 class PlanningParams
 {
@@ -52,6 +67,11 @@ class PlanningParams
 
     bool init();
 
+    /** \brief read the parameters from the private namespace of the node as
+     * it was recorded, e.g. by the request recorder, instead of from the
+     * parameter server */
+    bool init(const XmlRpc::XmlRpcValue &params);
+
     void printParams(std::string stream);
 
     /* Search */
@@ -60,6 +80,7 @@ class PlanningParams
     bool interpolate_path_;
     double allowed_time_;
     double waypoint_time_;
+    SearchSchedule schedule_;
 
     /* Planning */
     bool ready_to_plan_;
@@ -75,6 +96,76 @@ class PlanningParams
     double epsilon_;
     double planning_link_sphere_radius_;
 
+    /* Backward search (from IK solutions of the goal pose to the start) */
+    bool search_backward_;
+    int num_goal_ik_seeds_;
+    double start_snap_dist_m_;
+
+    /* Experience Graph */
+    bool use_experience_graph_;
+    double egraph_epsilon_;
+    std::string egraph_file_;
+    int egraph_max_nodes_;
+
+    /* Moving a colliding start configuration out of collision */
+    bool repair_start_;
+    int start_repair_iterations_;
+    double start_repair_max_step_;
+    double start_repair_clearance_;
+
+    /* Goal feasibility check (seeded IK of the goal pose before the search) */
+    bool goal_check_;
+    int goal_check_ik_seeds_;
+    double goal_check_timeout_;
+    double goal_check_max_snap_dist_;  // max joint distance of an IK snap to one of its solutions
+
+    /* Reachability map of the planning link (rejects unreachable goals) */
+    std::string reachability_file_;
+    bool reachability_reject_orientation_;
+    double reachability_orientation_tolerance_;
+
+    /* Swept volume of the planned trajectory, to revalidate it while it's executed */
+    bool use_swept_volume_;
+    double swept_volume_clearance_;
+
+    /* Deferral of the motion primitives that keep failing in a region */
+    bool defer_primitives_;
+    int mprim_stats_block_size_;
+    int mprim_stats_min_failures_;
+    double mprim_stats_max_success_rate_;
+    int mprim_stats_retry_every_;
+
+    /* Coarse lattice (every factor'th state, expanded with the long primitives
+     * scaled by factor far from the goal & obstacles) */
+    bool use_coarse_lattice_;
+    int coarse_lattice_factor_;
+    double coarse_lattice_goal_dist_m_;
+    double coarse_lattice_clearance_m_;
+
+    /* Primitive that follows the bfs path of the planning link (damped least squares) */
+    bool use_bfs_path_mprim_;
+    int bfs_path_lookahead_;
+    int bfs_path_iterations_;
+    double bfs_path_max_step_;
+    double bfs_path_damping_;
+
+    /* # of search threads the planner is given (the caller adds all but the first) */
+    int num_search_threads_;
+
+    /* Parallel search (PA*SE) over the search threads of the planner */
+    bool use_pase_;
+    double pase_epsilon_;
+    int pase_max_candidates_;
+
+    /* Hash distributed A* over the search threads of the planner (instead of PA*SE) */
+    bool use_hda_;
+
+    /* Stream the first waypoints of the first solution & search again from
+     * the last of them, for up to refine_fraction of the prefix's duration */
+    bool use_prefix_commit_;
+    int prefix_commit_waypoints_;
+    double prefix_commit_refine_fraction_;
+
     /* Discretization */
     std::vector<int> coord_vals_;
     std::vector<double> coord_delta_;
@@ -89,6 +180,13 @@ class PlanningParams
     
     /* Debugging & Logging */
     bool print_path_;
+    std::string stats_file_;
+    std::string stats_format_;
+    std::string record_dir_;
+    bool use_perf_counters_;
+    std::string trace_dir_;
+    double trace_latency_threshold_;
+    int trace_buffer_size_;
     bool verbose_;
     bool verbose_heuristics_;
     bool verbose_collisions_;
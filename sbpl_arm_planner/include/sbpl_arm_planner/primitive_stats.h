@@ -0,0 +1,74 @@
+/** \author Benjamin Cohen */
+
+#ifndef _PRIMITIVE_STATS_H_
+#define _PRIMITIVE_STATS_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace sbpl_arm_planner{
+
+/* How often each motion primitive passed the collision checks, by the block
+ * of cells that the parent's planning link is in. A primitive that failed
+ * at least min_failures times in a block with a success rate of at most
+ * max_success_rate is deferred there, i.e. it's only checked once every
+ * retry_every times (so that the rate can recover), otherwise its edge is
+ * only checked if a solution uses it. The counts depend on the scene, so
+ * they have to be reset when it changes. */
+class PrimitiveStats
+{
+  public:
+
+    PrimitiveStats();
+
+    void init(int dim_x, int dim_y, int dim_z, int block_size, int num_mprims);
+
+    void setDeferral(int min_failures, double max_success_rate, int retry_every);
+
+    bool isInitialized() { return !entries_.empty(); }
+
+    /** \brief Clears the counts (but keeps the counters of getStats) */
+    void reset();
+
+    /** \brief Index of the block of the cell, -1 if it's outside of the grid */
+    int getBlock(int x, int y, int z);
+
+    /** \brief true if the primitive should be skipped in the block (counted as deferred) */
+    bool isDeferred(int block, int mprim);
+
+    void update(int block, int mprim, bool valid);
+
+    /** \brief Adds the number of evaluated & deferred primitives to the stats */
+    void getStats(std::map<std::string, double> &stats);
+
+    void resetStats();
+
+  private:
+
+    typedef struct
+    {
+      int tries;
+      int failures;
+      int deferred;
+    } Entry;
+
+    int dims_[3];
+    int block_size_;
+    int num_blocks_[3];
+    int num_mprims_;
+    std::vector<Entry> entries_;
+
+    int min_failures_;
+    double max_success_rate_;
+    int retry_every_;
+
+    int num_evaluated_;
+    int num_valid_;
+    int num_deferred_;
+};
+
+}
+
+#endif
+
@@ -0,0 +1,62 @@
+/** \author Benjamin Cohen */
+
+#ifndef _REQUEST_RECORDER_H_
+#define _REQUEST_RECORDER_H_
+
+#include <map>
+#include <string>
+#include <ros/ros.h>
+#include <boost/thread/mutex.hpp>
+#include <arm_navigation_msgs/GetMotionPlan.h>
+#include <arm_navigation_msgs/PlanningScene.h>
+
+namespace sbpl_arm_planner{
+
+/* Topics of a recorded request. Each request is written to its own bag
+ * so it can be replayed on its own. */
+static const std::string RECORD_SCENE_TOPIC = "planning_scene";
+static const std::string RECORD_REQUEST_TOPIC = "motion_plan_request";
+static const std::string RECORD_ROBOT_DESCRIPTION_TOPIC = "robot_description";
+static const std::string RECORD_PARAMS_TOPIC = "planner_params";
+static const std::string RECORD_ACTION_SET_TOPIC = "action_set";
+static const std::string RECORD_ACTION_SET_HASH_TOPIC = "action_set_crc32";
+static const std::string RECORD_STATS_TOPIC = "planner_stats";
+
+/* Records everything that goes into a call to solve() into a
+ * self-contained bag: the planning scene, the request, the planner's
+ * parameter namespace (as XML-RPC), the motion primitive file and its
+ * checksum and the robot description. The planner stats of the
+ * original run are appended so a replay can be compared against them. */
+class RequestRecorder
+{
+  public:
+
+    RequestRecorder();
+
+    /** \brief Bags are written to 'directory'. The parameters are read from 'param_ns' */
+    bool init(std::string directory, std::string param_ns, std::string action_file);
+
+    /** \brief Returns the name of the bag written */
+    std::string record(const arm_navigation_msgs::PlanningScene &scene, const arm_navigation_msgs::GetMotionPlan::Request &req, const std::map<std::string, double> &stats);
+
+    /** \brief CRC-32 of a file's contents (0 if it can't be read) */
+    static unsigned int getFileChecksum(std::string filename, std::string &contents);
+
+    /** \brief "name: value" lines, as stored in the bag */
+    static std::string statsToString(const std::map<std::string, double> &stats);
+
+    static std::map<std::string, double> stringToStats(const std::string &str);
+
+  private:
+
+    std::string directory_;
+    std::string param_ns_;
+    std::string action_file_;
+    int count_;
+    boost::mutex mutex_;
+};
+
+}
+
+#endif
+
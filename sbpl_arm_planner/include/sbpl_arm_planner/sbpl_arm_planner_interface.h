@@ -43,15 +43,42 @@
 #include <leatherman/viz.h>
 #include <sbpl/planners/araplanner.h>
 #include <sbpl_arm_planner/environment_robarm3d.h>
+#include <sbpl_arm_planner/pase_planner.h>
+#include <sbpl_arm_planner/hda_planner.h>
+#include <sbpl_arm_planner/stats_writer.h>
+#include <sbpl_arm_planner/request_recorder.h>
+#include <sbpl_arm_planner/perf_counters.h>
+#include <sbpl_manipulation_components/tracer.h>
 #include <sbpl_manipulation_components/post_processing.h>
+#include <sbpl_collision_checking/swept_volume.h>
 #include <distance_field/propagation_distance_field.h>
 #include <geometry_msgs/Pose.h>
 #include <arm_navigation_msgs/GetMotionPlan.h>
 #include <arm_navigation_msgs/PlanningScene.h>
 #include <trajectory_msgs/JointTrajectory.h> 
+#include <boost/function.hpp>
+#include <boost/thread/thread.hpp>
 
 namespace sbpl_arm_planner{
 
+/** \brief A solution found during an anytime search */
+typedef struct
+{
+  double time;
+  double eps;
+  int cost;
+  int expansions;
+} SearchIteration;
+
+/** \brief Search settings that can differ between planner instances */
+typedef struct
+{
+  bool use_bfs_heuristic;
+  bool use_multires_mprims;
+  double initial_eps;
+  bool first_solution;                   // stop after the first solution (search_mode)
+} PlannerConfiguration;
+
 class SBPLArmPlannerInterface
 {
   public:
@@ -62,20 +89,64 @@ class SBPLArmPlannerInterface
 
     bool init();
 
+    /** \brief Same as init() but the parameters are the contents of the private namespace (e.g. as recorded
+     * by the request recorder) instead of the param server's. */
+    bool init(const XmlRpc::XmlRpcValue &params);
+
+    /** \brief Another thread for the parallel search (planning/pase/use or planning/hda/use), call it before init. It
+     * needs its own robot model, collision checker & action set, configured like the planner's. */
+    bool addSearchThread(RobotModel *rm, CollisionChecker *cc, ActionSet *as);
+
     bool getParams();
 
     bool planKinematicPath(const arm_navigation_msgs::GetMotionPlan::Request &req, arm_navigation_msgs::GetMotionPlan::Response &res);
 
     bool solve(const arm_navigation_msgs::PlanningSceneConstPtr& planning_scene, const arm_navigation_msgs::GetMotionPlan::Request &req, arm_navigation_msgs::GetMotionPlan::Response &res);
 
+    /** \brief Apply the planning scene to the collision checker and distance field */
+    bool setPlanningScene(const arm_navigation_msgs::PlanningSceneConstPtr& planning_scene);
+
     bool canServiceRequest(const arm_navigation_msgs::GetMotionPlan::Request &req);
 
     std::map<std::string, double>  getPlannerStats();
 
+    /** \brief Write the trace of the last request (see Tracer), as Chrome trace-event JSON */
+    bool writeTrace(std::string filename);
+
+    /** \brief Called with the planner stats at the end of every request */
+    void setStatsCallback(boost::function<void (const std::map<std::string, double>&)> callback);
+
+    /** \brief Called with the start of the first solution once it's committed (planning/prefix_commit/use),
+     * from the planning thread while the rest is searched again. The trajectory of the response starts with it. */
+    void setPrefixCallback(boost::function<void (const trajectory_msgs::JointTrajectory&)> callback);
+
+    /** \brief Set the anytime search schedule used for the following requests */
+    void setSearchSchedule(const SearchSchedule &schedule);
+
+    SearchSchedule getSearchSchedule();
+
+    void setConfiguration(const PlannerConfiguration &config);
+
+    PlannerConfiguration getConfiguration();
+
+    /** \brief The search stops early (keeping any solution it has) once *cancel is set */
+    void setCancelFlag(const volatile bool *cancel);
+
+    /** \brief Epsilon & cost of each solution found during the last request */
+    std::vector<SearchIteration> getSearchTrace();
+
     visualization_msgs::MarkerArray getVisualization(std::string type);
 
     visualization_msgs::MarkerArray getCollisionModelTrajectoryMarker();
 
+    /** \brief Swept volume of the trajectory of the last request (planning/swept_volume/use),
+     * NULL if it isn't used, empty if the request failed */
+    SweptVolume* getSweptVolume() { return swept_volume_; }
+
+    /** \brief The first segment of the last trajectory that's in the way of one of the
+     * points (see SweptVolume::getFirstInvalidated), false if none is or there's no swept volume */
+    bool getFirstInvalidated(const std::vector<Eigen::Vector3d> &points, double from_time, int &segment, double &time);
+
   private:
 
     ros::NodeHandle nh_;
@@ -84,6 +155,36 @@ class SBPLArmPlannerInterface
     bool planner_initialized_;
     int num_joints_;
     int solution_cost_;
+    ros::WallTime t_start_;
+
+    /* timing of the last request */
+    double preprocess_time_;
+    double set_start_time_;
+    double set_goal_time_;
+    double search_time_;
+    double postprocess_time_;
+    bool planning_succeeded_;
+    double trace_start_;
+
+    StatsWriter *stats_writer_;
+    RequestRecorder *recorder_;
+    PerfCounters *perf_;
+    ExperienceGraph *egraph_;
+    boost::thread egraph_save_thread_;
+    bool egraph_dirty_;                  // has paths that weren't saved
+    ReachabilityMap *rmap_;
+    SweptVolume *swept_volume_;
+    double swept_volume_time_;
+    boost::function<void (const std::map<std::string, double>&)> stats_callback_;
+    std::vector<SearchIteration> search_trace_;
+    const volatile bool *cancel_;
+
+    /* the committed prefix of the last request, its states on the lattice (& their cost) & the streamed trajectory */
+    boost::function<void (const trajectory_msgs::JointTrajectory&)> prefix_callback_;
+    std::vector<int> committed_ids_;
+    int prefix_cost_;
+    trajectory_msgs::JointTrajectory prefix_;
+    double prefix_commit_time_;
 
     /* planner & environment */
     MDPConfig mdp_cfg_;
@@ -96,10 +197,20 @@ class SBPLArmPlannerInterface
     sbpl_arm_planner::PlanningParams *prm_;
     distance_field::PropagationDistanceField* df_;
 
+    /* the other threads of the parallel search */
+    std::vector<sbpl_arm_planner::RobotModel*> search_rm_;
+    std::vector<sbpl_arm_planner::CollisionChecker*> search_cc_;
+    std::vector<sbpl_arm_planner::ActionSet*> search_as_;
+    bool use_pase_;
+    bool use_hda_;
+
     arm_navigation_msgs::MotionPlanRequest req_;
     arm_navigation_msgs::GetMotionPlan::Response res_;
     arm_navigation_msgs::PlanningScene pscene_;
 
+    /** \brief Set up the planner once prm_ is read */
+    bool initialize();
+
     /** \brief Initialize the SBPL planner and the sbpl_arm_planner environment */
     bool initializePlannerAndEnvironment();
 
@@ -114,6 +225,18 @@ class SBPLArmPlannerInterface
 
     /** \brief Retrieve plan from sbpl */
     bool plan(trajectory_msgs::JointTrajectory &traj);
+
+    /** \brief Add a planned path to the experience graph */
+    void addExperience(const trajectory_msgs::JointTrajectory &traj);
+
+    /** \brief Shortcut & interpolate the path (as configured) */
+    void postProcessPath(std::vector<trajectory_msgs::JointTrajectoryPoint> &points);
+
+    /** \brief Put the motion out of a colliding start in front of the path */
+    void addStartRecoveryPath(std::vector<trajectory_msgs::JointTrajectoryPoint> &points);
+
+    /** \brief Stream the first waypoints of the solution, false if they can't be committed */
+    bool commitPrefix(const std::vector<int> &ids);
 };
 
 }
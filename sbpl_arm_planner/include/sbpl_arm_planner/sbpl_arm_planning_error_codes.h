@@ -29,6 +29,9 @@ namespace sbpl_arm_planner
     INVALID_LEFT_FOREARM_ROLL_ANGLE,
     INVALID_LEFT_WRIST_PITCH_ANGLE,
     INVALID_LEFT_WRIST_ROLL_ANGLE,
+    GOAL_UNREACHABLE,
+    GOAL_NO_IK_SOLUTION,
+    GOAL_IN_COLLISION,
     NUM_DEBUG_CODES
   };
 
@@ -56,7 +59,10 @@ namespace sbpl_arm_planner
         "collision between arms",
         "right arm in collision",
         "left arm in collision",
-        "attached object in collision"}; 
+        "attached object in collision",
+        "goal unreachable",
+        "goal has no ik solution",
+        "goal in collision"}; 
  */
 }
 
@@ -0,0 +1,44 @@
+/** \author Benjamin Cohen */
+
+#ifndef _STATS_WRITER_H_
+#define _STATS_WRITER_H_
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <boost/thread/mutex.hpp>
+
+namespace sbpl_arm_planner{
+
+/* Appends the planner statistics of every request to a file, either as
+ * CSV or as JSON with one object per line. The CSV columns are the stats of
+ * the first request (or the header of the file it's appended to), a stat
+ * that's missing from a later request is left empty (so is a nan). */
+class StatsWriter
+{
+  public:
+
+    StatsWriter();
+
+    ~StatsWriter();
+
+    /** \brief format is "csv" or "json" */
+    bool open(std::string filename, std::string format);
+
+    void write(const std::map<std::string, double> &stats);
+
+  private:
+
+    bool json_;
+    std::ofstream file_;
+    std::vector<std::string> header_;
+    std::set<std::string> dropped_;
+    boost::mutex mutex_;
+};
+
+}
+
+#endif
+
@@ -30,17 +30,37 @@
 
 #include <sbpl_arm_planner/action_set.h>
 #include <sbpl_arm_planner/environment_robarm3d.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
  
 namespace sbpl_arm_planner {
 
 ActionSet::ActionSet(std::string action_file)
 {
   env_ = NULL;
+  rm_ = NULL;
   use_multires_mprims_ = true;
   use_ik_ = true;
   short_dist_mprims_thresh_m_ = 0.2;
   ik_amp_dist_thresh_m_= 0.20;
+  coarse_factor_ = 1;
+  coarse_dist_thresh_m_ = 0.4;
+  use_bfs_path_mprim_ = false;
+  bfs_path_lookahead_ = 8;
+  bfs_path_iterations_ = 5;
+  bfs_path_max_step_ = 0.1;
+  bfs_path_damping_ = 0.05;
+  ik_fallback_max_dist_ = 0.5;
   action_file_ = action_file;
+  ik_calls_ = 0;
+  ik_cache_hits_ = 0;
+  ik_failures_ = 0;
+  ik_snap_fallbacks_ = 0;
+  joint_limit_failures_ = 0;
+  bfs_path_calls_ = 0;
+  bfs_path_failures_ = 0;
+  use_limit_ranges_ = false;
 
   motion_primitive_type_names_.push_back("long_distance");
   motion_primitive_type_names_.push_back("short_distance");
@@ -54,9 +74,10 @@ ActionSet::ActionSet(std::string action_file)
   motion_primitive_type_names_.push_back("retract_then_towards_rpy_then_towards_xyz");
 }
 
-bool ActionSet::init(EnvironmentROBARM3D *env)
+bool ActionSet::init(EnvironmentROBARM3D *env, RobotModel *rm)
 {
   env_ = env;
+  rm_ = rm != NULL ? rm : env->getRobotModel();
 
   FILE* file=NULL;
   if((file=fopen(action_file_.c_str(),"r")) == NULL)
@@ -65,7 +86,17 @@ bool ActionSet::init(EnvironmentROBARM3D *env)
     return false;
   }
 
-  return getMotionPrimitivesFromFile(file);
+  if(!getMotionPrimitivesFromFile(file))
+    return false;
+
+  if(coarse_factor_ > 1)
+    addCoarseMprims();
+
+  if(use_bfs_path_mprim_)
+    addBFSPathMprim();
+
+  computeLimitRanges();
+  return true;
 }
 
 bool ActionSet::getMotionPrimitivesFromFile(FILE* fCfg)
@@ -186,26 +217,160 @@ void ActionSet::addMotionPrim(const std::vector<double> &mprim, bool add_convers
   }
 }
 
+void ActionSet::setCoarseMprims(int factor, double dist_thresh_m)
+{
+  coarse_factor_ = factor;
+  coarse_dist_thresh_m_ = dist_thresh_m;
+}
+
+void ActionSet::addCoarseMprims()
+{
+  // the ids stay equal to the indices, the amp remains last
+  MotionPrimitive amp = mp_.back();
+  mp_.pop_back();
+
+  size_t num_mprims = mp_.size();
+  for(size_t i = 0; i < num_mprims; ++i)
+  {
+    if(mp_[i].type != LONG_DISTANCE)
+      continue;
+
+    MotionPrimitive m = mp_[i];
+    m.type = COARSE_DISTANCE;
+    m.group = 3;
+    m.id = mp_.size();
+    for(size_t j = 0; j < m.action.size(); ++j)
+    {
+      for(size_t k = 0; k < m.action[j].size(); ++k)
+        m.action[j][k] *= coarse_factor_;
+    }
+    mp_.push_back(m);
+  }
+
+  amp.id = mp_.size();
+  mp_.push_back(amp);
+  ROS_INFO("[action_set] Added %d coarse motion primitives. (factor: %d)", int(mp_.size() - num_mprims - 1), coarse_factor_);
+}
+
+void ActionSet::setBFSPathMprim(int lookahead_cells, int iterations, double max_step, double damping)
+{
+  use_bfs_path_mprim_ = true;
+  bfs_path_lookahead_ = lookahead_cells;
+  bfs_path_iterations_ = iterations;
+  bfs_path_max_step_ = max_step;
+  bfs_path_damping_ = damping;
+}
+
+void ActionSet::addBFSPathMprim()
+{
+  // the action is computed per parent, the amp remains last
+  MotionPrimitive amp = mp_.back();
+  mp_.pop_back();
+
+  MotionPrimitive m;
+  m.type = FOLLOW_BFS_PATH;
+  m.group = 4;
+  m.id = mp_.size();
+  mp_.push_back(m);
+
+  amp.id = mp_.size();
+  mp_.push_back(amp);
+}
+
+void ActionSet::getMaxJointSteps(std::vector<double> &steps)
+{
+  steps.clear();
+  for(size_t i = 0; i < mp_.size(); ++i)
+  {
+    if(mp_[i].type != LONG_DISTANCE && mp_[i].type != SHORT_DISTANCE && mp_[i].type != COARSE_DISTANCE)
+      continue;
+
+    // a coarse primitive costs coarse_factor_ fine ones
+    double scale = (mp_[i].type == COARSE_DISTANCE) ? 1.0 / coarse_factor_ : 1.0;
+    for(size_t j = 0; j < mp_[i].action.size(); ++j)
+    {
+      if(steps.size() < mp_[i].action[j].size())
+        steps.resize(mp_[i].action[j].size(), 0);
+      for(size_t k = 0; k < mp_[i].action[j].size(); ++k)
+        steps[k] = std::max(steps[k], fabs(mp_[i].action[j][k]) * scale);
+    }
+  }
+
+  if(use_bfs_path_mprim_)
+  {
+    for(size_t k = 0; k < steps.size(); ++k)
+      steps[k] = std::max(steps[k], bfs_path_iterations_ * bfs_path_max_step_);
+  }
+}
+
 void ActionSet::print()
 {
   for(size_t i = 0; i < mp_.size(); ++i)
    mp_[i].print(); 
 }
 
+void ActionSet::getStats(std::map<std::string, double> &stats)
+{
+  stats["ik calls"] = ik_calls_;
+  stats["ik cache hits"] = ik_cache_hits_;
+  stats["ik failures"] = ik_failures_;
+  stats["ik snaps to goal check solutions"] = ik_snap_fallbacks_;
+  stats["joint limit failures"] = joint_limit_failures_;
+  if(use_bfs_path_mprim_)
+  {
+    stats["bfs path primitives"] = bfs_path_calls_;
+    stats["bfs path primitive failures"] = bfs_path_failures_;
+  }
+}
+
+void ActionSet::resetStats()
+{
+  ik_calls_ = 0;
+  ik_cache_hits_ = 0;
+  ik_failures_ = 0;
+  ik_snap_fallbacks_ = 0;
+  joint_limit_failures_ = 0;
+  bfs_path_calls_ = 0;
+  bfs_path_failures_ = 0;
+}
+
 bool ActionSet::getActionSet(const RobotState &parent, std::vector<Action> &actions)
+{
+  std::vector<int> mprims;
+  return getActionSet(parent, false, actions, mprims);
+}
+
+bool ActionSet::getActionSet(const RobotState &parent, bool coarse, std::vector<Action> &actions, std::vector<int> &mprims)
 {
   std::vector<double> pose;
-  if(!env_->getRobotModel()->computePlanningLinkFK(parent, pose))
+  if(!rm_->computePlanningLinkFK(parent, pose))
     return false;
 
   // get distance to the goal pose
   double d = env_->getDistanceToGoal(pose[0], pose[1], pose[2]);
 
+  if(use_limit_ranges_)
+    filterJointLimits(parent);
+
   Action a;
   for(size_t i = 0; i < mp_.size(); ++i)
   {
-    if(getAction(parent, d, mp_[i], a))
-      actions.push_back(a);
+    if(use_limit_ranges_ && !admissible_[i])
+    {
+      joint_limit_failures_++;
+      continue;
+    }
+    if(!getAction(parent, d, coarse, mp_[i], a))
+      continue;
+
+    // the actions that weren't filtered by their ranges
+    if((!use_limit_ranges_ || !limit_range_[i]) && !checkJointLimits(a))
+    {
+      joint_limit_failures_++;
+      continue;
+    }
+    actions.push_back(a);
+    mprims.push_back(mp_[i].type != SNAP_TO_XYZ_RPY ? mp_[i].id : -1);
   }
 
   if(actions.empty())
@@ -214,15 +379,35 @@ bool ActionSet::getActionSet(const RobotState &parent, std::vector<Action> &acti
   return true;
 }
 
-bool ActionSet::getAction(const RobotState &parent, double dist_to_goal, MotionPrimitive &mp, Action &action)
+bool ActionSet::getAction(const RobotState &parent, double dist_to_goal, bool coarse, MotionPrimitive &mp, Action &action)
 {
   if(mp.type == LONG_DISTANCE)
   {
     if(dist_to_goal <= short_dist_mprims_thresh_m_ && use_multires_mprims_)
       return false;
 
+    // replaced by the coarse primitives
+    if(coarse && dist_to_goal > coarse_dist_thresh_m_)
+      return false;
+
     return applyMotionPrimitive(parent, mp, action);
   }
+  else if(mp.type == COARSE_DISTANCE)
+  {
+    if(!coarse || dist_to_goal <= coarse_dist_thresh_m_)
+      return false;
+
+    return applyMotionPrimitive(parent, mp, action);
+  }
+  else if(mp.type == FOLLOW_BFS_PATH)
+  {
+    // a backward search descends toward the start
+    if(env_->isSearchingBackward() || dist_to_goal <= ik_amp_dist_thresh_m_)
+      return false;
+
+    TRACE_SCOPE("follow bfs path", "search");
+    return getBFSPathAction(parent, action);
+  }
   else if(mp.type == SHORT_DISTANCE)
   {
     if(dist_to_goal > short_dist_mprims_thresh_m_ && use_multires_mprims_)
@@ -232,22 +417,80 @@ bool ActionSet::getAction(const RobotState &parent, double dist_to_goal, MotionP
   }
   else if(mp.type == SNAP_TO_XYZ_RPY)
   {
+    // a backward search already starts from the IK solutions
+    if(env_->isSearchingBackward())
+      return false;
+
     if(dist_to_goal > ik_amp_dist_thresh_m_)
     {
       ROS_DEBUG("dist_to_goal: %0.3f", dist_to_goal);
       return false;
     }
+    TRACE_SCOPE("snap to goal (ik)", "search");
     action.resize(1);
     std::vector<double> goal = env_->getGoal();
-    if(!env_->getRobotModel()->computeIK(goal, parent, action[0]))
+    if(goal != ik_cache_goal_)
+    {
+      ik_cache_.clear();
+      ik_cache_goal_ = goal;
+    }
+
+    // the parents are lattice states, so the same parent gets the same answer
+    std::map<RobotState, IKCacheEntry>::const_iterator it = ik_cache_.find(parent);
+    bool found;
+    if(it != ik_cache_.end())
+    {
+      ik_cache_hits_++;
+      found = it->second.found;
+      action[0] = it->second.solution;
+    }
+    else
+    {
+      ik_calls_++;
+      IKCacheEntry &entry = ik_cache_[parent];
+      entry.found = rm_->computeIK(goal, parent, action[0]);
+      entry.solution = action[0];
+      found = entry.found;
+      if(!found)
+        ik_failures_++;
+    }
+
+    if(!found)
     {
+      // the closest of the goal's IK solutions from the feasibility check,
+      // if it's close enough for the interpolated motion to mean something
+      const std::vector<RobotState> &solutions = env_->getGoalIKSolutions();
+      double min_dist = -1;
+      for(size_t i = 0; i < solutions.size(); ++i)
+      {
+        double d = 0, max_d = 0;
+        for(size_t j = 0; j < solutions[i].size() && j < parent.size(); ++j)
+        {
+          double dj = fabs(angles::shortest_angular_distance(parent[j], solutions[i][j]));
+          d += dj;
+          max_d = std::max(max_d, dj);
+        }
+        if(max_d > ik_fallback_max_dist_)
+          continue;
+        if(min_dist < 0 || d < min_dist)
+        {
+          min_dist = d;
+          action[0] = solutions[i];
+        }
+      }
+      if(min_dist >= 0)
+      {
+        ik_snap_fallbacks_++;
+        return true;
+      }
+
       ROS_ERROR("IK Failed. (dist_to_goal: %0.3f)  (goal:   xyz: %0.3f %0.3f %0.3f rpy: %0.3f %0.3f %0.3f)", dist_to_goal, goal[0], goal[1], goal[2], goal[3], goal[4], goal[5]);
       return false;
     }
 
     /*
     std::vector<double> p(6,0);
-    env_->getRobotModel()->computeFK(action[0], "name", p);
+    rm_->computeFK(action[0], "name", p);
     ROS_WARN("[ik] goal:  xyz: % 0.3f % 0.3f % 0.3f rpy: % 0.3f % 0.3f % 0.3f", goal[0], goal[1], goal[2], goal[3], goal[4], goal[5]);
     ROS_WARN("[ik]   fk:  xyz: % 0.3f % 0.3f % 0.3f rpy: % 0.3f % 0.3f % 0.3f", p[0], p[1], p[2], p[3], p[4], p[5]);
     ROS_WARN("[ik] diff:  xyz: % 0.3f % 0.3f % 0.3f rpy: % 0.3f % 0.3f % 0.3f", fabs(goal[0]-p[0]), fabs(goal[1]-p[1]), fabs(goal[2]-p[2]), fabs(goal[3]-p[3]), fabs(goal[4]-p[4]), fabs(goal[5]-p[5]));
@@ -262,6 +505,191 @@ bool ActionSet::getAction(const RobotState &parent, double dist_to_goal, MotionP
   return true;
 }
 
+void ActionSet::computeLimitRanges()
+{
+  std::vector<double> min_limits, max_limits;
+  std::vector<bool> continuous;
+  use_limit_ranges_ = rm_->getPlanningJointLimits(min_limits, max_limits, continuous);
+  if(!use_limit_ranges_)
+  {
+    ROS_WARN("The robot model doesn't have the joint limits. The actions will be checked one by one.");
+    return;
+  }
+
+  // padded to an even number of primitives for the SSE loop
+  size_t num_joints = min_limits.size(), num_mprims = mp_.size() + mp_.size() % 2;
+  limit_lo_.assign(num_joints, std::vector<double>(num_mprims, 0.0));
+  limit_width_.assign(num_joints, std::vector<double>(num_mprims, 4*M_PI));
+  limit_range_.assign(mp_.size(), false);
+  admissible_.assign(num_mprims, 1);
+
+  // the parent is assumed to be within the limits (the start may not be,
+  // but then it's planned anyway) so only the moving joints are tested
+  for(size_t i = 0; i < mp_.size(); ++i)
+  {
+    if((mp_[i].type != LONG_DISTANCE && mp_[i].type != SHORT_DISTANCE && mp_[i].type != COARSE_DISTANCE) || mp_[i].action.size() != 1 || mp_[i].action[0].size() != num_joints)
+      continue;
+
+    limit_range_[i] = true;
+    for(size_t j = 0; j < num_joints; ++j)
+    {
+      double d = mp_[i].action[0][j];
+      if(d == 0 || continuous[j] || max_limits[j] - min_limits[j] >= 2*M_PI)
+        continue;
+      limit_lo_[j][i] = angles::normalize_angle(min_limits[j] - d);
+      limit_width_[j][i] = max_limits[j] - min_limits[j];
+    }
+  }
+}
+
+void ActionSet::filterJointLimits(const RobotState &parent)
+{
+  size_t num_joints = limit_lo_.size();
+  if(parent.size() < num_joints)
+  {
+    admissible_.assign(admissible_.size(), 1);
+    return;
+  }
+
+  // the lattice's angles are in [0,2pi), lo is in [-pi,pi]
+  std::vector<double> &p = limit_parent_;
+  p.resize(num_joints);
+  for(size_t j = 0; j < num_joints; ++j)
+    p[j] = angles::normalize_angle(parent[j]);
+
+  size_t i = 0;
+#ifdef __SSE2__
+  const __m128d two_pi = _mm_set1_pd(2*M_PI), zero = _mm_setzero_pd();
+  for(; i + 1 < admissible_.size(); i += 2)
+  {
+    __m128d ok = _mm_cmpeq_pd(zero, zero);
+    for(size_t j = 0; j < num_joints; ++j)
+    {
+      __m128d x = _mm_sub_pd(_mm_set1_pd(p[j]), _mm_loadu_pd(&limit_lo_[j][i]));
+      x = _mm_add_pd(x, _mm_and_pd(_mm_cmplt_pd(x, zero), two_pi));
+      ok = _mm_and_pd(ok, _mm_cmple_pd(x, _mm_loadu_pd(&limit_width_[j][i])));
+    }
+    int mask = _mm_movemask_pd(ok);
+    admissible_[i] = mask & 1;
+    admissible_[i+1] = (mask >> 1) & 1;
+  }
+#endif
+  for(; i < admissible_.size(); ++i)
+  {
+    bool ok = true;
+    for(size_t j = 0; j < num_joints; ++j)
+    {
+      double x = p[j] - limit_lo_[j][i];
+      if(x < 0)
+        x += 2*M_PI;
+      ok = ok && (x <= limit_width_[j][i]);
+    }
+    admissible_[i] = ok;
+  }
+}
+
+bool ActionSet::checkJointLimits(const Action &action)
+{
+  for(size_t i = 0; i < action.size(); ++i)
+  {
+    if(!rm_->checkJointLimits(action[i]))
+      return false;
+  }
+  return true;
+}
+
+bool ActionSet::getBFSPathAction(const RobotState &parent, Action &action)
+{
+  std::vector<double> pose, target, pose_d;
+  if(!rm_->computePlanningLinkFK(parent, pose) || !env_->getBFSPathWaypoint(pose[0], pose[1], pose[2], bfs_path_lookahead_, target))
+    return false;
+
+  bfs_path_calls_++;
+  const double eps = 1e-4;
+  double e[3], err = 0, err0 = 0;
+  for(int k = 0; k < 3; ++k)
+    err0 += (target[k] - pose[k]) * (target[k] - pose[k]);
+  err0 = sqrt(err0);
+
+  RobotState q = parent, qd;
+  std::vector<std::vector<double> > J(3, std::vector<double>(q.size(), 0));
+  std::vector<double> dq(q.size(), 0);
+  action.clear();
+  for(int i = 0; i < bfs_path_iterations_; ++i)
+  {
+    for(int k = 0; k < 3; ++k)
+      e[k] = target[k] - pose[k];
+
+    // jacobian of the planning link's position by finite differences
+    for(size_t j = 0; j < q.size(); ++j)
+    {
+      qd = q;
+      qd[j] += eps;
+      if(!rm_->computePlanningLinkFK(qd, pose_d))
+      {
+        bfs_path_failures_++;
+        return false;
+      }
+      for(int k = 0; k < 3; ++k)
+        J[k][j] = (pose_d[k] - pose[k]) / eps;
+    }
+
+    // dq = J^T (J J^T + damping^2 I)^-1 e
+    double A[3][3], y[3];
+    for(int r = 0; r < 3; ++r)
+    {
+      for(int c = 0; c < 3; ++c)
+      {
+        A[r][c] = (r == c) ? bfs_path_damping_ * bfs_path_damping_ : 0.0;
+        for(size_t j = 0; j < q.size(); ++j)
+          A[r][c] += J[r][j] * J[c][j];
+      }
+    }
+    double det = A[0][0]*(A[1][1]*A[2][2] - A[1][2]*A[2][1]) - A[0][1]*(A[1][0]*A[2][2] - A[1][2]*A[2][0]) + A[0][2]*(A[1][0]*A[2][1] - A[1][1]*A[2][0]);
+    if(fabs(det) < 1e-12)
+      break;
+    for(int k = 0; k < 3; ++k)
+    {
+      double B[3][3];
+      for(int r = 0; r < 3; ++r)
+        for(int c = 0; c < 3; ++c)
+          B[r][c] = (c == k) ? e[r] : A[r][c];
+      y[k] = (B[0][0]*(B[1][1]*B[2][2] - B[1][2]*B[2][1]) - B[0][1]*(B[1][0]*B[2][2] - B[1][2]*B[2][0]) + B[0][2]*(B[1][0]*B[2][1] - B[1][1]*B[2][0])) / det;
+    }
+
+    double max_step = 0;
+    for(size_t j = 0; j < q.size(); ++j)
+    {
+      dq[j] = J[0][j]*y[0] + J[1][j]*y[1] + J[2][j]*y[2];
+      max_step = std::max(max_step, fabs(dq[j]));
+    }
+    if(max_step < 1e-6)
+      break;
+    double scale = std::min(1.0, bfs_path_max_step_ / max_step);
+    for(size_t j = 0; j < q.size(); ++j)
+      q[j] = angles::normalize_angle(q[j] + scale * dq[j]);
+
+    if(!rm_->computePlanningLinkFK(q, pose))
+      break;
+    action.push_back(q);
+
+    err = 0;
+    for(int k = 0; k < 3; ++k)
+      err += (target[k] - pose[k]) * (target[k] - pose[k]);
+    err = sqrt(err);
+    if(err < 0.1 * err0)
+      break;
+  }
+
+  // it has to make some progress down the path
+  if(action.empty() || err > 0.5 * err0)
+  {
+    bfs_path_failures_++;
+    return false;
+  }
+  return true;
+}
+
 bool ActionSet::applyMotionPrimitive(const RobotState &state, MotionPrimitive &mp, Action &action)
 {
   action = mp.action;
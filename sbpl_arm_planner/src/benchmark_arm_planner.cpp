@@ -0,0 +1,211 @@
+/** \author Benjamin Cohen */
+
+#include <sbpl_manipulation_components/benchmark.h>
+#include <sbpl_manipulation_components/kdl_robot_model.h>
+#include <sbpl_arm_planner/environment_robarm3d.h>
+#include <boost/thread/thread.hpp>
+
+using namespace sbpl_arm_planner;
+
+/* the hash table is internal to the environment */
+class BenchmarkEnvironment : public EnvironmentROBARM3D
+{
+  public:
+    BenchmarkEnvironment(OccupancyGrid *grid, RobotModel *rmodel, CollisionChecker *cc, ActionSet* as, PlanningParams *pm) : EnvironmentROBARM3D(grid, rmodel, cc, as, pm) {};
+
+    using EnvironmentROBARM3D::getHashBin;
+    using EnvironmentROBARM3D::getHashEntry;
+    using EnvironmentROBARM3D::createHashEntry;
+};
+
+/* none of the benchmarked kernels check for collisions */
+class BenchmarkCollisionChecker : public CollisionChecker
+{
+  public:
+    bool isStateValid(const std::vector<double> &angles, bool verbose, bool visualize, double &dist) { dist = 100; return true; }
+    bool isStateToStateValid(const std::vector<double> &angles0, const std::vector<double> &angles1, int path_length, int num_checks, double &dist) { dist = 100; return true; }
+};
+
+struct HashBinOp
+{
+  BenchmarkEnvironment *env;
+  std::vector<std::vector<int> > coords;
+  unsigned int bin;
+  size_t i;
+
+  void operator()()
+  {
+    bin ^= env->getHashBin(coords[i]);
+    i = (i + 1) % coords.size();
+  }
+};
+
+struct HashEntryOp
+{
+  BenchmarkEnvironment *env;
+  std::vector<std::vector<int> > coords;
+  size_t i;
+  int misses;
+
+  void operator()()
+  {
+    if(env->getHashEntry(coords[i], false) == NULL)
+      misses++;
+    i = (i + 1) % coords.size();
+  }
+};
+
+struct ActionSetOp
+{
+  ActionSet *as;
+  std::vector<std::vector<double> > states;
+  std::vector<Action> actions;
+  size_t i;
+
+  void operator()()
+  {
+    actions.clear();
+    as->getActionSet(states[i], actions);
+    i = (i + 1) % states.size();
+  }
+};
+
+struct BFSOp
+{
+  BFS_3D *bfs;
+  int start[3];
+
+  void operator()()
+  {
+    bfs->run(start[0], start[1], start[2]);
+    // the search runs on the bfs thread
+    while(bfs->isRunning())
+      boost::this_thread::yield();
+  }
+};
+
+bool writeActionSetFile(std::string filename)
+{
+  FILE* file = fopen(filename.c_str(), "w");
+  if(file == NULL)
+    return false;
+  fprintf(file, "Motion_Primitives(degrees): 8 7 4\n");
+  for(int i = 0; i < 8; ++i)
+  {
+    for(int j = 0; j < 7; ++j)
+      fprintf(file, "%d ", (j == i % 4) ? (i < 4 ? 8 : 4) : 0);
+    fprintf(file, "\n");
+  }
+  fclose(file);
+  return true;
+}
+
+int main(int argc, char **argv)
+{
+  std::string json_file;
+  if(argc > 1)
+    json_file = argv[1];
+
+  Benchmark bm("sbpl_arm_planner", 1);
+  unsigned int seed = bm.getSeed();
+
+  // a 2m cube in front of the arm with a few random boxes in it
+  OccupancyGrid grid(2.0, 2.0, 2.0, 0.02, -0.5, -1.0, 0.0);
+  for(int i = 0; i < 5; ++i)
+  {
+    double x = -0.2 + 1.4 * (rand_r(&seed) / double(RAND_MAX));
+    double y = -0.8 + 1.6 * (rand_r(&seed) / double(RAND_MAX));
+    double z = 0.2 + 1.4 * (rand_r(&seed) / double(RAND_MAX));
+    grid.addCube(x, y, z, 0.2, 0.2, 0.2);
+  }
+
+  std::vector<std::string> joints;
+  getSyntheticArmJoints(joints);
+  KDLRobotModel rm("base_link", "tool_link");
+  if(!rm.init(getSyntheticArmURDF(), joints))
+  {
+    ROS_ERROR("Failed to initialize the robot model. Exiting.");
+    return 1;
+  }
+  rm.setPlanningLink("tool_link");
+  BenchmarkCollisionChecker cc;
+
+  PlanningParams prm;
+  prm.planning_joints_ = joints;
+  prm.num_joints_ = joints.size();
+  prm.coord_vals_.resize(prm.num_joints_, 360);
+  prm.coord_delta_.resize(prm.num_joints_, (2.0*M_PI) / 360);
+  prm.use_bfs_heuristic_ = false;
+
+  std::string action_file = "/tmp/benchmark_arm_planner.mprim";
+  if(!writeActionSetFile(action_file))
+  {
+    ROS_ERROR("Failed to write the action set to '%s'. Exiting.", action_file.c_str());
+    return 1;
+  }
+  ActionSet as(action_file);
+  BenchmarkEnvironment env(&grid, &rm, &cc, &as, &prm);
+  if(!env.initEnvironment() || !as.init(&env))
+  {
+    ROS_ERROR("Failed to initialize the environment. Exiting.");
+    return 1;
+  }
+
+  // hash table with 100k states, looked up in random order
+  std::vector<std::vector<int> > coords(100000, std::vector<int>(prm.num_joints_, 0));
+  int endeff[3] = {0};
+  for(size_t i = 0; i < coords.size(); ++i)
+  {
+    for(size_t j = 0; j < coords[i].size(); ++j)
+      coords[i][j] = rand_r(&seed) % prm.coord_vals_[j];
+    if(env.getHashEntry(coords[i], false) == NULL)
+      env.createHashEntry(coords[i], endeff);
+  }
+  for(size_t i = coords.size()-1; i > 0; --i)
+    std::swap(coords[i], coords[rand_r(&seed) % (i+1)]);
+
+  HashBinOp bin;
+  bin.env = &env;
+  bin.coords = coords;
+  bin.bin = 0;
+  bin.i = 0;
+  bm.run("get_hash_bin", bin, 1000000);
+
+  HashEntryOp entry;
+  entry.env = &env;
+  entry.coords = coords;
+  entry.i = 0;
+  entry.misses = 0;
+  bm.run("get_hash_entry", entry, 1000000);
+  ROS_INFO("[sanity check] hash misses: %d", entry.misses);
+
+  ActionSetOp actions;
+  actions.as = &as;
+  actions.i = 0;
+  actions.states.resize(1000);
+  for(size_t i = 0; i < actions.states.size(); ++i)
+    getRandomSyntheticArmState(&seed, actions.states[i]);
+  bm.run("action_set_get_action_set", actions, 100000);
+
+  // BFS over the grid with the obstacles (inflated by the planning link's radius) as walls
+  int dims[3], radius = int(prm.planning_link_sphere_radius_ / grid.getResolution() + 0.5);
+  grid.getGridSize(dims[0], dims[1], dims[2]);
+  BFS_3D bfs(dims[0], dims[1], dims[2]);
+  for(int z = 0; z < dims[2]; ++z)
+    for(int y = 0; y < dims[1]; ++y)
+      for(int x = 0; x < dims[0]; ++x)
+        if(grid.getCell(x,y,z) <= radius)
+          bfs.setWall(x,y,z);
+
+  BFSOp search;
+  search.bfs = &bfs;
+  search.start[0] = dims[0]/2;
+  search.start[1] = dims[1]/2;
+  search.start[2] = dims[2]/2;
+  while(bfs.isWall(search.start[0], search.start[1], search.start[2]) && search.start[2] < dims[2]-1)
+    search.start[2]++;
+  bm.run("bfs_run", search, 20);
+
+  return bm.writeJSON(json_file) ? 0 : 1;
+}
+
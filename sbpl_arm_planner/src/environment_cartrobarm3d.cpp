@@ -70,9 +70,6 @@ EnvironmentCARTROBARM3D::EnvironmentCARTROBARM3D(OccupancyGrid *grid, SBPLKinema
   free_angle_index_ = 2;
   ndof_ = 7;
 
-  mp_dist_.resize(6);
-  mp_gradient_.resize(3);
-
   prms_.environment_type_ = "cartesian";
 }
 
@@ -270,9 +267,6 @@ void EnvironmentCARTROBARM3D::GetSuccs(int SourceStateID, vector<int>* SuccIDV,
       }
     }
 
-    unsigned char dg = int((avgd+0.5)/prms_.xyz_resolution_);
-    computeGradient(prms_.mp_[i], dg, invalid_prim);
-
     if(invalid_prim)
       continue;
 
@@ -1197,7 +1191,7 @@ void EnvironmentCARTROBARM3D::getAdaptiveMotionPrim(int type, EnvROBARM3DHashEnt
   {
     int x,y,z;
     std::vector<int> icoord(ndof_,0);
-    if(!getDistanceGradient(x,y,z))
+    if(!getDistanceGradient(parent,x,y,z))
       ROS_ERROR("I shouldn't be here...");
 
     // get xyz for retracted pose
@@ -1250,7 +1244,7 @@ void EnvironmentCARTROBARM3D::getAdaptiveMotionPrim(int type, EnvROBARM3DHashEnt
   {
     int x,y,z;
     std::vector<int> icoord(ndof_,0);
-    if(!getDistanceGradient(x,y,z))
+    if(!getDistanceGradient(parent,x,y,z))
       ROS_ERROR("I shouldn't be here...");
 
     // get xyz for retracted pose
@@ -1284,7 +1278,7 @@ void EnvironmentCARTROBARM3D::getAdaptiveMotionPrim(int type, EnvROBARM3DHashEnt
     /*
     int x,y,z;
     std::vector<int> icoord(ndof_,0);
-    if(!getDistanceGradient(x,y,z))
+    if(!getDistanceGradient(parent,x,y,z))
       ROS_ERROR("I shouldn't be here...");
 
     // get xyz for retracted pose
@@ -1461,7 +1455,7 @@ bool EnvironmentCARTROBARM3D::getMotionPrimitive(EnvROBARM3DHashEntry_t* parent,
     if(parent->heur > prms_.cost_per_cell_ * 20)
       return false;
     int x, y, z;
-    if(!getDistanceGradient(x,y,z))
+    if(!getDistanceGradient(parent,x,y,z))
       return false;
     getAdaptiveMotionPrim(RETRACT_THEN_SNAP_TO_RPY_THEN_TO_XYZ, parent, mp);
   }
@@ -1476,7 +1470,7 @@ bool EnvironmentCARTROBARM3D::getMotionPrimitive(EnvROBARM3DHashEntry_t* parent,
     }
 
     int x,y,z;
-    if(!getDistanceGradient(x,y,z))
+    if(!getDistanceGradient(parent,x,y,z))
     {
       ROS_ERROR("Zero GRadient");
       return false;
@@ -1487,7 +1481,7 @@ bool EnvironmentCARTROBARM3D::getMotionPrimitive(EnvROBARM3DHashEntry_t* parent,
     if(parent->heur > prms_.cost_per_cell_ * 40)
       return false;
     int x, y, z;
-    if(!getDistanceGradient(x,y,z))
+    if(!getDistanceGradient(parent,x,y,z))
       return false;
     if(parent->heur > prms_.cost_per_cell_ * 5)
       getAdaptiveMotionPrim(RETRACT_THEN_TOWARDS_RPY_THEN_TOWARDS_XYZ, parent, mp);
@@ -1566,70 +1560,24 @@ void EnvironmentCARTROBARM3D::getVector(int x1, int y1, int z1, int x2, int y2,
   ROS_DEBUG("dx: %1.2f dy: %1.2f dz: %1.2f length: %1.2f multiplier: %d unit_double{%1.2f %1.2f %1.2f}  unit_int{%d %d %d}", dx, dy, dz, length, multiplier, dx/length, dy/length, dz/length, xout, yout, zout);
 }
 
-bool EnvironmentCARTROBARM3D::getDistanceGradient(int &x, int &y, int &z)
+bool EnvironmentCARTROBARM3D::getDistanceGradient(EnvROBARM3DHashEntry_t* parent, int &x, int &y, int &z)
 {
-  mp_gradient_[0] = mp_dist_[0] - mp_dist_[1];
-  mp_gradient_[1] = mp_dist_[2] - mp_dist_[3];
-  mp_gradient_[2] = mp_dist_[4] - mp_dist_[5];
-
-  x = mp_gradient_[0];
-  y = mp_gradient_[1];
-  z = mp_gradient_[2];
-
-  if(mp_dist_[0] == -1 ||  mp_dist_[1] == -1)
-  {
-    mp_gradient_[0] = 0;
-    return false;
-  }
-  if(mp_dist_[2] == -1 ||  mp_dist_[3] == -1)
-  {
-    mp_gradient_[1] = 0;
-    return false;
-  }
-  if(mp_dist_[4] == -1 ||  mp_dist_[5] == -1)
-  {
-    mp_gradient_[2] = 0;
+  double gx, gy, gz;
+  if(!grid_->getGradient(parent->coord[0], parent->coord[1], parent->coord[2], gx, gy, gz))
     return false;
-  }
-  if(mp_gradient_[0] == 0 && mp_gradient_[1] == 0 && mp_gradient_[2] == 0)
+
+  // the field is flat away from the obstacles (and inside of them)
+  double norm = sqrt(gx*gx + gy*gy + gz*gz);
+  if(norm < 0.01)
     return false;
 
-  //ROS_INFO("[env] dist:  %2.2f %2.2f %2.2f %2.2f %2.2f %2.2f  (%s)", mp_dist_[0], mp_dist_[1], mp_dist_[2], mp_dist_[3], mp_dist_[4], mp_dist_[5], cspace_->collision_name_.c_str());      
-  double norm = sqrt(mp_gradient_[0]*mp_gradient_[0] + mp_gradient_[1]*mp_gradient_[1] + mp_gradient_[2]*mp_gradient_[2]);
-  ROS_INFO("[env] gradient_x: %2.2f   gradient_y: %2.2f   gradient_z: %2.2f  norm: %2.2f", mp_gradient_[0], mp_gradient_[1], mp_gradient_[2], norm);
-  return true;
-}
+  // direction away from the nearest obstacle (in cells), getVector() rescales it
+  x = int(10.0*gx/norm + (gx < 0 ? -0.5 : 0.5));
+  y = int(10.0*gy/norm + (gy < 0 ? -0.5 : 0.5));
+  z = int(10.0*gz/norm + (gz < 0 ? -0.5 : 0.5));
 
-void EnvironmentCARTROBARM3D::computeGradient(const MotionPrimitive &mp, unsigned char &d, bool collision)
-{
-  if(mp.id < 6 && mp.group == 1)
-  {
-    if(d == 100)
-      mp_dist_[mp.id] = -1;
-    else 
-      mp_dist_[mp.id] = d;
-    /*
-    if(d == 0)
-      ROS_ERROR("%d: distance gradient = 0", mp.id);
-    aviz_->deleteVisualizations("mp_gradient", 0);
-    int hue = 160;
-    if(collision)
-    {
-      hue = 30;
-    }
-      //aviz_->visualizeSphere(cspace_->collision_, hue, "collision_sphere", cspace_->collision_[3]);
-      aviz_->visualizeSphere(cspace_->collision_, hue, "mp_gradient_"+boost::lexical_cast<std::string>(mp.id), cspace_->collision_[3]);
-      geometry_msgs::Pose pose;
-      pose.position.x = cspace_->collision_[0];
-      pose.position.y = cspace_->collision_[1];
-      pose.position.z = cspace_->collision_[2];
-      std::vector<double> color(4,1);
-      aviz_->visualizeText(pose, cspace_->collision_name_, "mp_gradient_"+boost::lexical_cast<std::string>(mp.id), 3, color, 0.02);
-      //aviz_->visualizeText(pose, cspace_->collision_name_, "collision_sphere", 3, color, 0.02);
-    //}
-    //ROS_INFO("[env] %s %d", cspace_->collision_name_.c_str(), int(d)); 
-    */
-  }
+  ROS_DEBUG_NAMED(prms_.expands2_log_, "[env] gradient_x: %2.2f   gradient_y: %2.2f   gradient_z: %2.2f  norm: %2.2f", gx, gy, gz, norm);
+  return true;
 }
 
 int EnvironmentCARTROBARM3D::getXYZRPYHeuristic(int FromStateID, int ToStateID)
@@ -31,6 +31,9 @@
 #include <sbpl_arm_planner/environment_robarm3d.h>
 //#include <bfs3d/BFS_Util.hpp>
 #include <leatherman/viz.h>
+#include <stdlib.h>
+#include <queue>
+#include <algorithm>
 
 #define DEG2RAD(d) ((d)*(M_PI/180.0))
 #define RAD2DEG(r) ((r)*(180.0/M_PI))
@@ -40,13 +43,15 @@ using namespace std;
 namespace sbpl_arm_planner
 {
 
-EnvironmentROBARM3D::EnvironmentROBARM3D(OccupancyGrid *grid, RobotModel *rmodel, CollisionChecker *cc, ActionSet* as, PlanningParams *pm) : bfs_(NULL)
+EnvironmentROBARM3D::EnvironmentROBARM3D(OccupancyGrid *grid, RobotModel *rmodel, CollisionChecker *cc, ActionSet* as, PlanningParams *pm) : bfs_(NULL), bfs_valid_(false), bfs_traced_(true), egraph_(NULL), egraph_validated_(false), egraph_version_(-1), egraph_indexed_(0), rmap_(NULL), debug_code_(SUCCESS), cancel_(NULL)
 {
   grid_ = grid;
   rmodel_ = rmodel;
   cc_ = cc;
   as_ = as;
   prm_ = pm;
+  parallel_ = false;
+  addSearchThread(rmodel_, cc_, as_);
   getHeuristic_ = &sbpl_arm_planner::EnvironmentROBARM3D::getXYZHeuristic;
 }
 
@@ -78,6 +83,9 @@ bool EnvironmentROBARM3D::InitializeMDPCfg(MDPConfig *MDPCfg)
 
 int EnvironmentROBARM3D::GetFromToHeuristic(int FromStateID, int ToStateID)
 {
+  boost::unique_lock<boost::mutex> lock(table_mutex_, boost::defer_lock);
+  if(parallel_)
+    lock.lock();
   return (*this.*getHeuristic_)(FromStateID,ToStateID);
 }
 
@@ -148,11 +156,17 @@ void EnvironmentROBARM3D::PrintEnv_Config(FILE* fOut)
 
 void EnvironmentROBARM3D::GetSuccs(int SourceStateID, vector<int>* SuccIDV, vector<int>* CostV)
 {
+  GetSuccs(SourceStateID, SuccIDV, CostV, 0);
+}
+
+void EnvironmentROBARM3D::GetSuccs(int SourceStateID, vector<int>* SuccIDV, vector<int>* CostV, int thread)
+{
+  TRACE_SCOPE("GetSuccs", "search");
   double dist=0;
-  int endeff[3]={0};
-  int path_length=0, nchecks=0;
   std::vector<int> scoord(prm_->num_joints_,0);
-  std::vector<double> pose(6,0), angles(prm_->num_joints_,0), source_angles(prm_->num_joints_,0);
+  std::vector<double> source_angles(prm_->num_joints_,0);
+  SearchThread &t = search_threads_[thread];
+  EnvironmentStats &stats = getThreadStats(thread);
 
   //clear the successor array
   SuccIDV->clear();
@@ -162,8 +176,17 @@ void EnvironmentROBARM3D::GetSuccs(int SourceStateID, vector<int>* SuccIDV, vect
   if(SourceStateID == pdata_.goal_entry->stateID)
     return;
 
-  //get X, Y, Z for the state
+  //the search was cancelled
+  if(cancel_ != NULL && *cancel_)
+    return;
+
+  //get X, Y, Z for the state (the entries don't move, the table may)
+  boost::unique_lock<boost::mutex> lock(table_mutex_, boost::defer_lock);
+  if(parallel_)
+    lock.lock();
   EnvROBARM3DHashEntry_t* parent_entry = pdata_.StateID2CoordTable[SourceStateID];
+  if(parallel_)
+    lock.unlock();
 
   if(int(parent_entry->coord.size()) < prm_->num_joints_)
     ROS_ERROR("Parent hash entry has broken coords. (# coords: %d)", int(parent_entry->coord.size()));
@@ -177,122 +200,456 @@ void EnvironmentROBARM3D::GetSuccs(int SourceStateID, vector<int>* SuccIDV, vect
   ROS_DEBUG_NAMED(prm_->expands_log_, "\nstate %d: %.2f %.2f %.2f %.2f %.2f %.2f %.2f  endeff: %3d %3d %3d",SourceStateID, source_angles[0],source_angles[1],source_angles[2],source_angles[3],source_angles[4],source_angles[5],source_angles[6], parent_entry->xyz[0],parent_entry->xyz[1],parent_entry->xyz[2]);
  
 
-  int valid = 1;
   std::vector<Action> actions;
-  if(!as_->getActionSet(source_angles, actions))
+  std::vector<int> mprims;
+  bool coarse = isCoarseState(parent_entry);
+  if(coarse)
+    stats.coarse_expansions++;
+  if(!t.as->getActionSet(source_angles, coarse, actions, mprims))
   {
     ROS_WARN("Failed to get successors.");
     return;
   }
 
-  ROS_DEBUG_NAMED(prm_->expands_log_, "[parent: %d] angles: %0.3f %0.3f %0.3f %0.3f %0.3f %0.3f %0.3f  xyz: %3d %3d %3d  #_actions: %d  heur: %d dist: %0.3f", SourceStateID, source_angles[0],source_angles[1],source_angles[2],source_angles[3],source_angles[4],source_angles[5],source_angles[6], parent_entry->xyz[0],parent_entry->xyz[1],parent_entry->xyz[2], int(actions.size()), getXYZHeuristic(SourceStateID, 1), double(bfs_->getDistance(parent_entry->xyz[0],parent_entry->xyz[1], parent_entry->xyz[2])) * grid_->getResolution());
+  int block = -1;
+  if(prm_->defer_primitives_)
+  {
+    if(parallel_)
+      lock.lock();
+    if(!mprim_stats_.isInitialized())
+    {
+      int dims[3];
+      grid_->getGridSize(dims[0], dims[1], dims[2]);
+      mprim_stats_.init(dims[0], dims[1], dims[2], prm_->mprim_stats_block_size_, as_->getNumMotionPrimitives());
+      mprim_stats_.setDeferral(prm_->mprim_stats_min_failures_, prm_->mprim_stats_max_success_rate_, prm_->mprim_stats_retry_every_);
+    }
+    block = mprim_stats_.getBlock(parent_entry->xyz[0], parent_entry->xyz[1], parent_entry->xyz[2]);
+    if(parallel_)
+      lock.unlock();
+  }
+
+  ROS_DEBUG_NAMED(prm_->expands_log_, "[parent: %d] angles: %0.3f %0.3f %0.3f %0.3f %0.3f %0.3f %0.3f  xyz: %3d %3d %3d  #_actions: %d  heur: %d dist: %0.3f", SourceStateID, source_angles[0],source_angles[1],source_angles[2],source_angles[3],source_angles[4],source_angles[5],source_angles[6], parent_entry->xyz[0],parent_entry->xyz[1],parent_entry->xyz[2], int(actions.size()), GetGoalHeuristic(SourceStateID), double(bfs_->getDistance(parent_entry->xyz[0],parent_entry->xyz[1], parent_entry->xyz[2])) * grid_->getResolution());
 
   // check actions for validity
+  std::vector<int> deferred_actions;
+  std::vector<double> pose(6,0);
   for (int i = 0; i < int(actions.size()); ++i)
   {
-    valid = 1;
-    for(size_t j = 0; j < actions[i].size(); ++j)
+    if(prm_->defer_primitives_)
     {
-      ROS_DEBUG_NAMED(prm_->expands_log_, "[ succ: %d] angles: %0.3f %0.3f %0.3f %0.3f %0.3f %0.3f  %0.3f", i, actions[i][j][0], actions[i][j][1], actions[i][j][2], actions[i][j][3], actions[i][j][4], actions[i][j][5], actions[i][j][6]);
-
-      // check joint limits
-      if(!rmodel_->checkJointLimits(actions[i][j]))
-        valid = -1;
-
-      //check for collisions
-      if(!cc_->isStateValid(actions[i][j], prm_->verbose_, false, dist))
+      if(parallel_)
+        lock.lock();
+      bool deferred = mprim_stats_.isDeferred(block, mprims[i]);
+      if(parallel_)
+        lock.unlock();
+
+      // a successor that is a goal state is checked now, the goal entry takes its state
+      if(deferred && !prm_->search_backward_ && t.rm->computePlanningLinkFK(actions[i].back(), pose))
+      {
+        if(parallel_)
+          lock.lock();
+        deferred = !isGoalState(pose, pdata_.goal);
+        if(parallel_)
+          lock.unlock();
+      }
+      if(deferred)
       {
-        ROS_DEBUG_NAMED(prm_->expands_log_, " succ: %2d  dist: %0.3f is in collision.", i, dist);
-        valid = -2;
+        deferred_actions.push_back(i);
+        continue;
       }
 
-      if(valid < 1)
-        break;
+      bool valid = isActionValid(source_angles, actions[i], i, dist, thread);
+      if(parallel_)
+        lock.lock();
+      mprim_stats_.update(block, mprims[i], valid);
+      if(parallel_)
+        lock.unlock();
+      if(!valid)
+        continue;
     }
+    else if(!isActionValid(source_angles, actions[i], i, dist, thread))
+      continue;
 
-    if(valid < 1)
+    // get the successor
+    bool succ_is_goal_state = false;
+    EnvROBARM3DHashEntry_t* succ_entry = getSuccessorEntry(actions[i].back(), dist, succ_is_goal_state, thread);
+    if(succ_entry == NULL)
       continue;
 
-    // check for collisions along path from parent to first waypoint
-    if(!cc_->isStateToStateValid(source_angles, actions[i][0], path_length, nchecks, dist))
+    ROS_DEBUG_NAMED(prm_->expands_log_, "%5i: action: %2d dist: %2d edge_distance_cost: %5d heur: %2d endeff: %3d %3d %3d", succ_entry->stateID, i, int(succ_entry->dist), cost(parent_entry,succ_entry, succ_is_goal_state), GetFromToHeuristic(succ_entry->stateID, pdata_.goal_entry->stateID), succ_entry->xyz[0],succ_entry->xyz[1],succ_entry->xyz[2]);
+
+    //put successor on successor list with the proper cost (a coarse primitive spans factor fine ones)
+    SuccIDV->push_back(succ_entry->stateID);
+    if(t.as->isCoarseMotionPrimitive(mprims[i]))
+      CostV->push_back(cost(parent_entry, succ_entry, succ_is_goal_state) * prm_->coarse_lattice_factor_);
+    else
+      CostV->push_back(cost(parent_entry, succ_entry, succ_is_goal_state));
+  }
+
+  // the edges of deferred primitives aren't checked unless a solution uses them (checkDeferredEdges),
+  // the ones that were found in collision aren't generated again
+  for(size_t j = 0; j < deferred_actions.size(); ++j)
+  {
+    int i = deferred_actions[j];
+    bool succ_is_goal_state = false;
+    EnvROBARM3DHashEntry_t* succ_entry = getSuccessorEntry(actions[i].back(), 0, succ_is_goal_state, thread);
+    if(succ_entry == NULL || std::find(SuccIDV->begin(), SuccIDV->end(), succ_entry->stateID) != SuccIDV->end())
+      continue;
+
+    if(parallel_)
+      lock.lock();
+    std::map<std::pair<int,int>, DeferredEdge>::iterator e = deferred_edges_.find(std::make_pair(SourceStateID, succ_entry->stateID));
+    if(e == deferred_edges_.end())
     {
-      ROS_DEBUG_NAMED(prm_->expands_log_, " succ: %2d  dist: %0.3f is in collision along interpolated path. (path_length: %d)", i, dist, path_length);
-      valid = -3;
+      DeferredEdge &edge = deferred_edges_[std::make_pair(SourceStateID, succ_entry->stateID)];
+      edge.source = source_angles;
+      edge.action = actions[i];
+      edge.block = block;
+      edge.mprim = mprims[i];
+      edge.valid = -1;
     }
+    bool invalid = (e != deferred_edges_.end() && e->second.valid == 0);
+    if(parallel_)
+      lock.unlock();
+    if(invalid)
+      continue;
 
-    if(valid < 1)
+    SuccIDV->push_back(succ_entry->stateID);
+    if(t.as->isCoarseMotionPrimitive(mprims[i]))
+      CostV->push_back(cost(parent_entry, succ_entry, succ_is_goal_state) * prm_->coarse_lattice_factor_);
+    else
+      CostV->push_back(cost(parent_entry, succ_entry, succ_is_goal_state));
+  }
+
+  // successors along & into the experience graph (not used by the parallel search)
+  if(egraph_ != NULL && prm_->use_experience_graph_ && !parallel_)
+    getExperienceGraphSuccs(parent_entry, source_angles, SuccIDV, CostV);
+
+  if(parallel_)
+    lock.lock();
+  pdata_.expanded_states.push_back(SourceStateID);
+  pdata_.stats.expansions++;
+}
+
+bool EnvironmentROBARM3D::checkDeferredEdges(const std::vector<int> &path)
+{
+  boost::unique_lock<boost::mutex> lock(table_mutex_, boost::defer_lock);
+  if(parallel_)
+    lock.lock();
+
+  double dist = 0;
+  bool valid = true;
+  for(size_t i = 0; i + 1 < path.size(); ++i)
+  {
+    std::map<std::pair<int,int>, DeferredEdge>::iterator e = deferred_edges_.find(std::make_pair(path[i], path[i+1]));
+    if(e == deferred_edges_.end() || e->second.valid != -1)
       continue;
 
-    // check for collisions between waypoints
-    for(size_t j = 1; j < actions[i].size(); ++j)
+    DeferredEdge &edge = e->second;
+    edge.valid = isActionValid(edge.source, edge.action, edge.mprim, dist, 0) ? 1 : 0;
+    mprim_stats_.update(edge.block, edge.mprim, edge.valid == 1);
+    pdata_.stats.deferred_edges_checked++;
+    if(edge.valid == 0)
     {
-      //ROS_INFO("[ succ: %d] Checking interpolated path from waypoint %d to waypoint %d.", int(i), int(j-1), int(j));
-      if(!cc_->isStateToStateValid(actions[i][j-1], actions[i][j], path_length, nchecks, dist))
-      {
-        ROS_DEBUG_NAMED(prm_->expands_log_, " succ: %2d  dist: %0.3f is in collision along interpolated path. (path_length: %d)", i, dist, path_length);
-        valid = -4;
-        break;
-      }
+      ROS_DEBUG_NAMED(prm_->expands_log_, "The deferred edge from %d to %d is in collision.", path[i], path[i+1]);
+      pdata_.stats.deferred_edges_rejected++;
+      valid = false;
+    }
+  }
+  return valid;
+}
+
+bool EnvironmentROBARM3D::isCoarseState(EnvROBARM3DHashEntry_t* entry)
+{
+  if(!prm_->use_coarse_lattice_ || entry->dist < prm_->coarse_lattice_clearance_m_)
+    return false;
+
+  // the coarse lattice is every factor'th state of the fine one, counted from the start
+  for(int i = 0; i < prm_->num_joints_; ++i)
+  {
+    if((entry->coord[i] - pdata_.start_entry->coord[i]) % prm_->coarse_lattice_factor_ != 0)
+      return false;
+  }
+  return true;
+}
+
+bool EnvironmentROBARM3D::isActionValid(const RobotState &source_angles, const Action &action, int i, double &dist, int thread)
+{
+  CollisionChecker *cc = search_threads_[thread].cc;
+  EnvironmentStats &stats = getThreadStats(thread);
+  int valid = 1;
+  int path_length=0, nchecks=0;
+
+  for(size_t j = 0; j < action.size(); ++j)
+  {
+    ROS_DEBUG_NAMED(prm_->expands_log_, "[ succ: %d] angles: %0.3f %0.3f %0.3f %0.3f %0.3f %0.3f  %0.3f", i, action[j][0], action[j][1], action[j][2], action[j][3], action[j][4], action[j][5], action[j][6]);
+
+    //check for collisions (the action set already checked the joint limits)
+    stats.state_checks++;
+    if(!cc->isStateValid(action[j], prm_->verbose_, false, dist))
+    {
+      ROS_DEBUG_NAMED(prm_->expands_log_, " succ: %2d  dist: %0.3f is in collision.", i, dist);
+      stats.state_checks_failed++;
+      valid = -2;
     }
 
     if(valid < 1)
-      continue;
+      break;
+  }
 
-    // compute coords
-    anglesToCoord(actions[i].back(), scoord);
+  if(valid < 1)
+    return false;
 
-    // get the successor
-    EnvROBARM3DHashEntry_t* succ_entry;
-    bool succ_is_goal_state = false;
+  // check for collisions along path from parent to first waypoint
+  stats.edge_checks++;
+  if(!cc->isStateToStateValid(source_angles, action[0], path_length, nchecks, dist))
+  {
+    ROS_DEBUG_NAMED(prm_->expands_log_, " succ: %2d  dist: %0.3f is in collision along interpolated path. (path_length: %d)", i, dist, path_length);
+    stats.edge_checks_failed++;
+    valid = -3;
+  }
 
-    // get pose of planning link
-    if(!rmodel_->computePlanningLinkFK(actions[i].back(), pose))
-      continue;
+  if(valid < 1)
+    return false;
+
+  // check for collisions between waypoints
+  for(size_t j = 1; j < action.size(); ++j)
+  {
+    //ROS_INFO("[ succ: %d] Checking interpolated path from waypoint %d to waypoint %d.", int(i), int(j-1), int(j));
+    stats.edge_checks++;
+    if(!cc->isStateToStateValid(action[j-1], action[j], path_length, nchecks, dist))
+    {
+      ROS_DEBUG_NAMED(prm_->expands_log_, " succ: %2d  dist: %0.3f is in collision along interpolated path. (path_length: %d)", i, dist, path_length);
+      stats.edge_checks_failed++;
+      valid = -4;
+      break;
+    }
+  }
+
+  if(valid < 1)
+    return false;
+
+  return true;
+}
+
+EnvROBARM3DHashEntry_t* EnvironmentROBARM3D::getSuccessorEntry(const RobotState &angles, double dist, bool &is_goal, int thread)
+{
+  int endeff[3]={0};
+  std::vector<int> scoord(prm_->num_joints_,0);
+  std::vector<double> pose(6,0);
+  is_goal = false;
+
+  // compute coords
+  anglesToCoord(angles, scoord);
+
+  // get pose of planning link
+  if(!search_threads_[thread].rm->computePlanningLinkFK(angles, pose))
+  {
+    getThreadStats(thread).fk_failures++;
+    return NULL;
+  }
+
+  // discretize planning link pose
+  grid_->worldToGrid(pose[0],pose[1],pose[2],endeff[0],endeff[1],endeff[2]);
+
+  ROS_DEBUG_NAMED(prm_->expands_log_, "[ succ]   pose: %0.3f %0.3f %0.3f   %0.3f %0.3f %0.3f", pose[0], pose[1], pose[2], pose[3], pose[4], pose[5]);
+  ROS_DEBUG_NAMED(prm_->expands_log_, "[ succ]    xyz: %d %d %d  goal: %d %d %d  (diff: %d %d %d)", endeff[0], endeff[1], endeff[2], pdata_.goal_entry->xyz[0], pdata_.goal_entry->xyz[1], pdata_.goal_entry->xyz[2], abs(pdata_.goal_entry->xyz[0] - endeff[0]), abs(pdata_.goal_entry->xyz[1] - endeff[1]), abs(pdata_.goal_entry->xyz[2] - endeff[2]));
+
+  boost::unique_lock<boost::mutex> lock(table_mutex_, boost::defer_lock);
+  if(parallel_)
+    lock.lock();
+
+  //check if this state meets the goal criteria (the goal is a meta state when searching backward)
+  if(!prm_->search_backward_ && isGoalState(pose, pdata_.goal))
+  {
+    is_goal = true;
+
+    for (int k = 0; k < prm_->num_joints_; k++)
+      pdata_.goal_entry->coord[k] = scoord[k];
+
+    pdata_.goal_entry->xyz[0] = endeff[0];
+    pdata_.goal_entry->xyz[1] = endeff[1];
+    pdata_.goal_entry->xyz[2] = endeff[2];
+    pdata_.goal_entry->state = angles;
+    pdata_.goal_entry->dist = dist;
+  }
+
+  //check if hash entry already exists, if not then create one
+  EnvROBARM3DHashEntry_t* succ_entry;
+  if((succ_entry = getHashEntry(scoord, is_goal)) == NULL)
+  {
+    succ_entry = createHashEntry(scoord, endeff);
+    succ_entry->state = angles;
+    succ_entry->dist = dist;
+  }
+  return succ_entry;
+}
 
-    // discretize planning link pose
-    grid_->worldToGrid(pose[0],pose[1],pose[2],endeff[0],endeff[1],endeff[2]);
-   
-    //ROS_DEBUG_NAMED(prm_->expands_log_, "[ succ: %d] %0.3f %0.3f %0.3f %0.3f %0.3f %0.3f %0.3f", int(i), actions[i].back()[0], actions[i].back()[1], actions[i].back()[2], actions[i].back()[3], actions[i].back()[4], actions[i].back()[5], actions[i].back()[6]);
-    ROS_DEBUG_NAMED(prm_->expands_log_, "[ succ: %d]   pose: %0.3f %0.3f %0.3f   %0.3f %0.3f %0.3f", int(i), pose[0], pose[1], pose[2], pose[3], pose[4], pose[5]);
-    ROS_DEBUG_NAMED(prm_->expands_log_, "[ succ: %d]    xyz: %d %d %d  goal: %d %d %d  (diff: %d %d %d)", int(i), endeff[0], endeff[1], endeff[2], pdata_.goal_entry->xyz[0], pdata_.goal_entry->xyz[1], pdata_.goal_entry->xyz[2], abs(pdata_.goal_entry->xyz[0] - endeff[0]), abs(pdata_.goal_entry->xyz[1] - endeff[1]), abs(pdata_.goal_entry->xyz[2] - endeff[2]));
+void EnvironmentROBARM3D::GetPreds(int TargetStateID, vector<int>* PredIDV, vector<int>* CostV)
+{
+  TRACE_SCOPE("GetPreds", "search");
+  double dist=0;
+  int path_length=0, nchecks=0;
+  std::vector<double> target_angles(prm_->num_joints_,0);
+
+  PredIDV->clear();
+  CostV->clear();
+
+  //start state should be absorbing
+  if(TargetStateID == pdata_.start_entry->stateID)
+    return;
+
+  //the search was cancelled
+  if(cancel_ != NULL && *cancel_)
+    return;
 
-    //check if this state meets the goal criteria
-    if(isGoalState(pose, pdata_.goal))
+  //the goal can be reached from any of its IK solutions
+  if(TargetStateID == pdata_.goal_entry->stateID)
+  {
+    for(size_t i = 0; i < pdata_.goal_ik_ids.size(); ++i)
     {
-      succ_is_goal_state = true;
+      PredIDV->push_back(pdata_.goal_ik_ids[i]);
+      CostV->push_back(prm_->cost_multiplier_);
+    }
+    pdata_.expanded_states.push_back(TargetStateID);
+    pdata_.stats.expansions++;
+    return;
+  }
 
-      for (int k = 0; k < prm_->num_joints_; k++)
-        pdata_.goal_entry->coord[k] = scoord[k];
+  EnvROBARM3DHashEntry_t* target_entry = pdata_.StateID2CoordTable[TargetStateID];
+  coordToAngles(target_entry->coord, target_angles);
 
-      pdata_.goal_entry->xyz[0] = endeff[0];
-      pdata_.goal_entry->xyz[1] = endeff[1];
-      pdata_.goal_entry->xyz[2] = endeff[2];
-      pdata_.goal_entry->state = actions[i].back();
-      pdata_.goal_entry->dist = dist;
+  // the motion primitives come in converse pairs & the collision checks
+  // are symmetric, so the predecessors are the states the actions lead to
+  std::vector<Action> actions;
+  if(!as_->getActionSet(target_angles, actions))
+  {
+    ROS_WARN("Failed to get predecessors.");
+    return;
+  }
+
+  for (int i = 0; i < int(actions.size()); ++i)
+  {
+    if(!isActionValid(target_angles, actions[i], i, dist))
+      continue;
+
+    bool is_goal = false;
+    EnvROBARM3DHashEntry_t* pred_entry = getSuccessorEntry(actions[i].back(), dist, is_goal);
+    if(pred_entry == NULL)
+      continue;
+
+    PredIDV->push_back(pred_entry->stateID);
+    CostV->push_back(cost(pred_entry, target_entry, false));
+  }
+
+  // snap to the start configuration when close to it
+  if(double(bfs_->getDistance(target_entry->xyz[0], target_entry->xyz[1], target_entry->xyz[2])) * grid_->getResolution() <= prm_->start_snap_dist_m_)
+  {
+    pdata_.stats.edge_checks++;
+    if(cc_->isStateToStateValid(pdata_.start_entry->state, target_angles, path_length, nchecks, dist))
+    {
+      PredIDV->push_back(pdata_.start_entry->stateID);
+      CostV->push_back(prm_->cost_multiplier_);
     }
+    else
+      pdata_.stats.edge_checks_failed++;
+  }
+
+  pdata_.expanded_states.push_back(TargetStateID);
+  pdata_.stats.expansions++;
+}
+
+int EnvironmentROBARM3D::sampleGoalIKSolutions(int num_seeds, double timeout, std::vector<RobotState> &solutions)
+{
+  std::vector<double> seed, solution, pose;
+  unsigned int rseed = 1;
+  double dist = 0;
+  int num_ik = 0;
+  ros::WallTime start = ros::WallTime::now();
+
+  solutions.clear();
+  for(int i = 0; i <= num_seeds; ++i)
+  {
+    if(timeout > 0 && i > 0 && (ros::WallTime::now() - start).toSec() > timeout)
+      break;
 
-    //check if hash entry already exists, if not then create one
-    if((succ_entry = getHashEntry(scoord, succ_is_goal_state)) == NULL)
+    // the goal pose from the start configuration first, then random poses
+    // within the goal's tolerance from random seeds (the same ones for every request)
+    seed = pdata_.start_entry->state;
+    pose = pdata_.goal.pose;
+    if(i > 0)
     {
-      succ_entry = createHashEntry(scoord, endeff);
-      succ_entry->state = actions[i].back();
-      succ_entry->dist = dist;
+      for(size_t j = 0; j < seed.size(); ++j)
+        seed[j] = (double(rand_r(&rseed)) / double(RAND_MAX)) * 2.0*M_PI - M_PI;
+      for(int k = 0; k < 3; ++k)
+      {
+        pose[k] += (2.0 * double(rand_r(&rseed)) / double(RAND_MAX) - 1.0) * pdata_.goal.xyz_tolerance[k];
+        if(pdata_.goal.type == XYZ_RPY_GOAL)
+          pose[k+3] += (2.0 * double(rand_r(&rseed)) / double(RAND_MAX) - 1.0) * pdata_.goal.rpy_tolerance[k];
+      }
+    }
 
-      ROS_DEBUG_NAMED(prm_->expands_log_, "%5i: action: %2d dist: %2d edge_distance_cost: %5d heur: %2d endeff: %3d %3d %3d", succ_entry->stateID, i, int(succ_entry->dist), cost(parent_entry,succ_entry, succ_is_goal_state), GetFromToHeuristic(succ_entry->stateID, pdata_.goal_entry->stateID), succ_entry->xyz[0],succ_entry->xyz[1],succ_entry->xyz[2]);
+    if(!rmodel_->computeIK(pose, seed, solution) || !rmodel_->checkJointLimits(solution))
+      continue;
+    num_ik++;
+
+    pdata_.stats.state_checks++;
+    if(!cc_->isStateValid(solution, false, false, dist))
+    {
+      pdata_.stats.state_checks_failed++;
+      continue;
     }
+    solutions.push_back(solution);
+  }
+  return num_ik;
+}
 
-    //put successor on successor list with the proper cost
-    SuccIDV->push_back(succ_entry->stateID);
-    CostV->push_back(cost(parent_entry, succ_entry, succ_is_goal_state));
+bool EnvironmentROBARM3D::computeGoalIKSolutions()
+{
+  TRACE_SCOPE("computeGoalIKSolutions", "planner");
+  std::vector<RobotState> solutions;
+  sampleGoalIKSolutions(prm_->num_goal_ik_seeds_, 0, solutions);
+
+  double dist = 0;
+  pdata_.goal_ik_ids.clear();
+  for(size_t i = 0; i < solutions.size(); ++i)
+  {
+    bool is_goal = false;
+    EnvROBARM3DHashEntry_t* entry = getSuccessorEntry(solutions[i], dist, is_goal);
+    if(entry == NULL)
+      continue;
+
+    // skip solutions that land in the same lattice state
+    if(std::find(pdata_.goal_ik_ids.begin(), pdata_.goal_ik_ids.end(), entry->stateID) == pdata_.goal_ik_ids.end())
+      pdata_.goal_ik_ids.push_back(entry->stateID);
   }
 
-  pdata_.expanded_states.push_back(SourceStateID);
+  ROS_INFO("[env] Found %d collision free IK solutions for the goal pose. (%d seeds)", int(pdata_.goal_ik_ids.size()), prm_->num_goal_ik_seeds_ + 1);
+  return !pdata_.goal_ik_ids.empty();
 }
 
-void EnvironmentROBARM3D::GetPreds(int TargetStateID, vector<int>* PredIDV, vector<int>* CostV)
+bool EnvironmentROBARM3D::checkGoalFeasibility()
 {
-  ROS_ERROR("ERROR in pdata_... function: GetPreds is undefined\n");
-  throw new SBPL_Exception();
+  TRACE_SCOPE("checkGoalFeasibility", "planner");
+  int num_ik = sampleGoalIKSolutions(prm_->goal_check_ik_seeds_, prm_->goal_check_timeout_, pdata_.goal_ik_solutions);
+  pdata_.stats.goal_ik_solutions = int(pdata_.goal_ik_solutions.size());
+  if(!pdata_.goal_ik_solutions.empty())
+  {
+    ROS_INFO("[env] Goal check: %d of %d IK solutions of the goal pose are collision free.", int(pdata_.goal_ik_solutions.size()), num_ik);
+    return true;
+  }
+
+  if(num_ik == 0)
+  {
+    debug_code_ = GOAL_NO_IK_SOLUTION;
+    ROS_ERROR("[env] Goal check: No IK solution for the goal pose. (%d seeds)", prm_->goal_check_ik_seeds_ + 1);
+  }
+  else
+  {
+    debug_code_ = GOAL_IN_COLLISION;
+    ROS_ERROR("[env] Goal check: All %d IK solutions of the goal pose are in collision.", num_ik);
+  }
+  return false;
 }
 
 bool EnvironmentROBARM3D::AreEquivalent(int StateID1, int StateID2)
@@ -349,6 +706,7 @@ EnvROBARM3DHashEntry_t* EnvironmentROBARM3D::getHashEntry(const std::vector<int>
     return pdata_.goal_entry;
 
   int binid = getHashBin(coord);
+  pdata_.stats.hash_lookups++;
 
 #if DEBUG
   if ((int)pdata_.Coord2StateIDHashTable[binid].size() > 500)
@@ -371,7 +729,10 @@ EnvROBARM3DHashEntry_t* EnvironmentROBARM3D::getHashEntry(const std::vector<int>
     }
 
     if (j == int(coord.size()))
+    {
+      pdata_.stats.hash_hits++;
       return pdata_.Coord2StateIDHashTable[binid][ind];
+    }
   }
 
   return NULL;
@@ -391,6 +752,7 @@ EnvROBARM3DHashEntry_t* EnvironmentROBARM3D::createHashEntry(const std::vector<i
 
   //insert into the tables
   pdata_.StateID2CoordTable.push_back(HashEntry);
+  pdata_.stats.generated_states++;
 
   //get the hash table bin
   i = getHashBin(HashEntry->coord);
@@ -541,36 +903,97 @@ bool EnvironmentROBARM3D::setStartConfiguration(const std::vector<double> angles
     ROS_ERROR("Start state does not contain enough enough joint positions.");
     return false;
   }
+  RobotState start(angles.begin(), angles.begin() + prm_->num_joints_);
+
+  //check if the start configuration is in collision, move it out or plan anyway
+  pdata_.start_recovery.clear();
+  if(!cc_->isStateValid(start, prm_->verbose_, false, dist))
+  {
+    if(prm_->repair_start_ && repairStartConfiguration(start))
+      ROS_WARN("[env] The starting configuration is in collision. Moved it out of collision in %d steps.", int(pdata_.start_recovery.size()));
+    else
+      ROS_WARN("[env] The starting configuration is in collision. Attempting to plan anyway. (distance to nearest obstacle %0.2fm)", double(dist)*grid_->getResolution());
+  }
+
+  //the clearance of the start decides if it's expanded on the coarse lattice
+  if(prm_->use_coarse_lattice_)
+    cc_->isStateValid(start, false, false, pdata_.start_entry->dist);
 
   //get joint positions of starting configuration
-  if(!rmodel_->computePlanningLinkFK(angles, pose))
+  if(!rmodel_->computePlanningLinkFK(start, pose))
     ROS_WARN("Unable to compute forward kinematics for initial robot state. Attempting to plan anyway.");
-  ROS_INFO("[start]             angles: %0.3f %0.3f %0.3f %0.3f %0.3f %0.3f %0.3f", angles[0], angles[1], angles[2], angles[3], angles[4], angles[5], angles[6]); 
+  ROS_INFO("[start]             angles: %0.3f %0.3f %0.3f %0.3f %0.3f %0.3f %0.3f", start[0], start[1], start[2], start[3], start[4], start[5], start[6]); 
   ROS_INFO("[start] planning_link pose:   xyz: %0.3f %0.3f %0.3f  rpy: %0.3f %0.3f %0.3f", pose[0], pose[1], pose[2], pose[3], pose[4], pose[5]);
 
   //check joint limits of starting configuration but plan anyway
-  if(!rmodel_->checkJointLimits(angles))
+  if(!rmodel_->checkJointLimits(start))
     ROS_WARN("Starting configuration violates the joint limits. Attempting to plan anyway.");
 
-  //check if the start configuration is in collision but plan anyway
-  if(!cc_->isStateValid(angles, prm_->verbose_, false, dist))
-  {
-    ROS_WARN("[env] The starting configuration is in collision. Attempting to plan anyway. (distance to nearest obstacle %0.2fm)", double(dist)*grid_->getResolution());
-  }
-
   //get arm position in environment
-  anglesToCoord(angles, pdata_.start_entry->coord);
+  anglesToCoord(start, pdata_.start_entry->coord);
+  pdata_.start_entry->state = start;
   grid_->worldToGrid(pose[0],pose[1],pose[2],x,y,z);
   pdata_.start_entry->xyz[0] = (int)x;
   pdata_.start_entry->xyz[1] = (int)y;
   pdata_.start_entry->xyz[2] = (int)z;
+  if(prm_->search_backward_)
+  {
+    pdata_.heur_target[0] = pose[0];
+    pdata_.heur_target[1] = pose[1];
+    pdata_.heur_target[2] = pose[2];
+  }
   ROS_INFO("[start]              coord: %d %d %d %d %d %d %d   pose: %d %d %d", pdata_.start_entry->coord[0], pdata_.start_entry->coord[1], pdata_.start_entry->coord[2], pdata_.start_entry->coord[3], pdata_.start_entry->coord[4], pdata_.start_entry->coord[5], pdata_.start_entry->coord[6], x, y, z);
   return true;
 }
 
+bool EnvironmentROBARM3D::repairStartConfiguration(RobotState &angles)
+{
+  TRACE_SCOPE("repairStartConfiguration", "planner");
+  std::vector<double> min_limits, max_limits, step;
+  std::vector<bool> continuous;
+  bool limits = rmodel_->getPlanningJointLimits(min_limits, max_limits, continuous);
+  double dist = 0;
+
+  RobotState q = angles;
+  std::vector<RobotState> path(1, angles);
+  for(int i = 0; i < prm_->start_repair_iterations_; ++i)
+  {
+    if(!cc_->getRepairStep(q, prm_->start_repair_clearance_, step) || step.size() < q.size())
+      return false;
+
+    // the step is linearized, so keep it small
+    double max_step = 0;
+    for(size_t j = 0; j < q.size(); ++j)
+      max_step = std::max(max_step, fabs(step[j]));
+    if(max_step < 1e-6)
+      return false;
+    double scale = std::min(1.0, prm_->start_repair_max_step_ / max_step);
+
+    for(size_t j = 0; j < q.size(); ++j)
+    {
+      q[j] += scale * step[j];
+      if(limits && j < continuous.size() && !continuous[j])
+        q[j] = std::max(min_limits[j], std::min(max_limits[j], q[j]));
+    }
+    pdata_.stats.start_repair_steps++;
+
+    pdata_.stats.state_checks++;
+    if(cc_->isStateValid(q, false, false, dist))
+    {
+      pdata_.start_recovery = path;
+      angles = q;
+      return true;
+    }
+    pdata_.stats.state_checks_failed++;
+    path.push_back(q);
+  }
+  return false;
+}
+
 bool EnvironmentROBARM3D::setGoalPosition(const std::vector <std::vector<double> > &goals, const std::vector<std::vector<double> > &tolerances)
 {
   //goals: {{x1,y1,z1,r1,p1,y1,is_6dof},{x2,y2,z2,r2,p2,y2,is_6dof}...}
+  TRACE_SCOPE("setGoalPosition", "planner");
 
   if(!prm_->ready_to_plan_)
   {
@@ -578,6 +1001,7 @@ bool EnvironmentROBARM3D::setGoalPosition(const std::vector <std::vector<double>
     return false;
   }
 
+  debug_code_ = SUCCESS;
   if(goals.empty())
   {
     ROS_ERROR("[setGoalPosition] No goal constraint set.");
@@ -611,36 +1035,89 @@ bool EnvironmentROBARM3D::setGoalPosition(const std::vector <std::vector<double>
   ROS_DEBUG_NAMED(prm_->expands_log_, "grid: %d %d %d (cells)  xyz: %.2f %.2f %.2f (meters)  (tol: %.3f) rpy: %1.2f %1.2f %1.2f (radians) (tol: %.3f)", pdata_.goal_entry->xyz[0],pdata_.goal_entry->xyz[1], pdata_.goal_entry->xyz[2], pdata_.goal.pose[0], pdata_.goal.pose[1], pdata_.goal.pose[2], pdata_.goal.xyz_tolerance[0], pdata_.goal.pose[3], pdata_.goal.pose[4], pdata_.goal.pose[5], pdata_.goal.rpy_tolerance[0]);
 
 
-  // push obstacles into bfs grid
-  ros::WallTime start = ros::WallTime::now();
-  start = ros::WallTime::now();
-  int dimX, dimY, dimZ;
-  grid_->getGridSize(dimX, dimY, dimZ);
-  int walls=0;
-  for (int z = 0; z < dimZ - 2; z++)
-    for (int y = 0; y < dimY - 2; y++)
-      for (int x = 0; x < dimX - 2; x++)
-        if(grid_->getDistance(x,y,z) <= prm_->planning_link_sphere_radius_)
-        {
-          bfs_->setWall(x + 1, y + 1, z + 1); //, true);
-          walls++;
-        }
-  double set_walls_time = (ros::WallTime::now() - start).toSec();
-  ROS_INFO("[env] %0.5fsec to set walls in new bfs. (%d walls (%0.3f percent))", set_walls_time, walls, double(walls)/double(dimX*dimY*dimZ));
-
-  /*
-  start = ros::WallTime::now();
-  ROS_ERROR("sphere radius: %0.3fm  %dcells", prm_->planning_link_sphere_radius_, int(prm_->planning_link_sphere_radius_/grid_->getResolution() + 0.5));
-  setDistanceField(bfs_, grid_->getDistanceFieldPtr(), int(prm_->planning_link_sphere_radius_/grid_->getResolution() + 0.5));
-  ROS_INFO("[env] %0.5fsec to set walls in bfs.", (ros::WallTime::now() - start).toSec());
-  */
   if((pdata_.goal_entry->xyz[0] < 0) || (pdata_.goal_entry->xyz[1] < 0) || (pdata_.goal_entry->xyz[2] < 0))
   {
     ROS_ERROR("Goal is out of bounds. Can't run BFS with {%d %d %d} as start.", pdata_.goal_entry->xyz[0], pdata_.goal_entry->xyz[1], pdata_.goal_entry->xyz[2]);
     return false;
   }
-  bfs_->run(pdata_.goal_entry->xyz[0], pdata_.goal_entry->xyz[1], pdata_.goal_entry->xyz[2]);
-  //bfs_->configure(pdata_.goal_entry->xyz[0], pdata_.goal_entry->xyz[1], pdata_.goal_entry->xyz[2]);
+
+  if(rmap_ != NULL && !checkGoalReachability())
+    return false;
+
+  // fail before the time budget is spent on a goal that can't be reached
+  pdata_.goal_ik_solutions.clear();
+  if(prm_->goal_check_ && !prm_->search_backward_ && pdata_.goal.type == XYZ_RPY_GOAL && !checkGoalFeasibility())
+    return false;
+
+  // a backward search is guided toward the start
+  int *bfs_seed = pdata_.goal_entry->xyz;
+  if(prm_->search_backward_)
+    bfs_seed = pdata_.start_entry->xyz;
+  else
+  {
+    pdata_.heur_target[0] = pdata_.goal.pose[0];
+    pdata_.heur_target[1] = pdata_.goal.pose[1];
+    pdata_.heur_target[2] = pdata_.goal.pose[2];
+  }
+
+  // the heuristic only depends on the goal cell, so reuse it if the world hasn't changed
+  if(bfs_valid_ && bfs_goal_[0] == bfs_seed[0] && bfs_goal_[1] == bfs_seed[1] && bfs_goal_[2] == bfs_seed[2])
+  {
+    ROS_INFO("[env] Goal is in the same cell as the previous goal. Reusing the bfs.");
+    pdata_.stats.bfs_reused++;
+  }
+  else
+  {
+    // push obstacles into bfs grid
+    double trace_start = Tracer::now();
+    ros::WallTime start = ros::WallTime::now();
+    int dimX, dimY, dimZ;
+    grid_->getGridSize(dimX, dimY, dimZ);
+    int walls=0;
+    for (int z = 0; z < dimZ - 2; z++)
+      for (int y = 0; y < dimY - 2; y++)
+        for (int x = 0; x < dimX - 2; x++)
+          if(grid_->getDistance(x,y,z) <= prm_->planning_link_sphere_radius_)
+          {
+            bfs_->setWall(x + 1, y + 1, z + 1); //, true);
+            walls++;
+          }
+    double set_walls_time = (ros::WallTime::now() - start).toSec();
+    ROS_INFO("[env] %0.5fsec to set walls in new bfs. (%d walls (%0.3f percent))", set_walls_time, walls, double(walls)/double(dimX*dimY*dimZ));
+    pdata_.stats.set_walls_time += set_walls_time;
+    pdata_.stats.bfs_runs++;
+    if(Tracer::isEnabled())
+      Tracer::addEvent("set walls", "heuristic", trace_start, Tracer::now());
+
+    /*
+    start = ros::WallTime::now();
+    ROS_ERROR("sphere radius: %0.3fm  %dcells", prm_->planning_link_sphere_radius_, int(prm_->planning_link_sphere_radius_/grid_->getResolution() + 0.5));
+    setDistanceField(bfs_, grid_->getDistanceFieldPtr(), int(prm_->planning_link_sphere_radius_/grid_->getResolution() + 0.5));
+    ROS_INFO("[env] %0.5fsec to set walls in bfs.", (ros::WallTime::now() - start).toSec());
+    */
+    bfs_->run(bfs_seed[0], bfs_seed[1], bfs_seed[2]);
+    bfs_traced_ = false;
+    //bfs_->configure(pdata_.goal_entry->xyz[0], pdata_.goal_entry->xyz[1], pdata_.goal_entry->xyz[2]);
+    for(int i = 0; i < 3; ++i)
+      bfs_goal_[i] = bfs_seed[i];
+    bfs_valid_ = true;
+  }
+
+  // the backward search starts from the IK solutions of the goal pose
+  if(prm_->search_backward_ && !computeGoalIKSolutions())
+  {
+    ROS_ERROR("[env] Can't search backward without a collision free IK solution for the goal pose.");
+    return false;
+  }
+
+  // bias the heuristic toward the experience graph
+  getHeuristic_ = &sbpl_arm_planner::EnvironmentROBARM3D::getXYZHeuristic;
+  if(egraph_ != NULL && prm_->use_experience_graph_ && !prm_->search_backward_ && egraph_->getNumNodes() > 0)
+  {
+    indexExperienceGraph();
+    computeExperienceGraphHeuristic();
+    getHeuristic_ = &sbpl_arm_planner::EnvironmentROBARM3D::getExperienceGraphHeuristic;
+  }
 
   pdata_.near_goal = false; 
   pdata_.t_start = clock();
@@ -765,7 +1242,7 @@ int EnvironmentROBARM3D::getXYZHeuristic(int FromStateID, int ToStateID)
   {
     double x, y, z;
     grid_->gridToWorld(FromHashEntry->xyz[0],FromHashEntry->xyz[1],FromHashEntry->xyz[2], x, y, z);
-    FromHashEntry->heur = getEuclideanDistance(x, y, z, pdata_.goal.pose[0], pdata_.goal.pose[1], pdata_.goal.pose[2]) * prm_->cost_per_meter_;
+    FromHashEntry->heur = getEuclideanDistance(x, y, z, pdata_.heur_target[0], pdata_.heur_target[1], pdata_.heur_target[2]) * prm_->cost_per_meter_;
   }
   return FromHashEntry->heur;
 }
@@ -775,12 +1252,17 @@ bool EnvironmentROBARM3D::convertStateIDPathToJointTrajectory(const std::vector<
   if(idpath.empty())
     return false;
 
+  // the goal of a backward search is a meta state without a configuration
+  size_t num_points = idpath.size();
+  if(prm_->search_backward_ && idpath.back() == pdata_.goal_entry->stateID)
+    num_points--;
+
   traj.header.frame_id = prm_->planning_frame_;
   traj.joint_names = prm_->planning_joints_;
-  traj.points.resize(idpath.size());
+  traj.points.resize(num_points);
   
   std::vector<double> angles;
-  for(size_t i = 0; i < idpath.size(); ++i)
+  for(size_t i = 0; i < num_points; ++i)
   {
     traj.points[i].positions.resize(prm_->num_joints_);
     StateID2Angles(idpath[i], angles);
@@ -792,6 +1274,506 @@ bool EnvironmentROBARM3D::convertStateIDPathToJointTrajectory(const std::vector<
   return true;
 }
 
+void EnvironmentROBARM3D::getStats(std::map<std::string, double> &stats)
+{
+  // the collision checks of the other search threads are counted by the threads
+  EnvironmentStats s = pdata_.stats;
+  for(size_t i = 1; i < search_threads_.size(); ++i)
+  {
+    const EnvironmentStats &t = search_threads_[i].stats;
+    s.state_checks += t.state_checks;
+    s.state_checks_failed += t.state_checks_failed;
+    s.edge_checks += t.edge_checks;
+    s.edge_checks_failed += t.edge_checks_failed;
+    s.fk_failures += t.fk_failures;
+    s.coarse_expansions += t.coarse_expansions;
+  }
+  stats["expansions (env)"] = s.expansions;
+  stats["generated states"] = s.generated_states;
+  stats["hash lookups"] = s.hash_lookups;
+  stats["hash hit rate"] = s.hash_lookups > 0 ? double(s.hash_hits) / double(s.hash_lookups) : 0.0;
+  stats["state collision checks"] = s.state_checks;
+  stats["state collision checks failed"] = s.state_checks_failed;
+  stats["edge collision checks"] = s.edge_checks;
+  stats["edge collision checks failed"] = s.edge_checks_failed;
+  stats["fk failures"] = s.fk_failures;
+  stats["bfs runs"] = s.bfs_runs;
+  stats["bfs reuse rate"] = (s.bfs_runs + s.bfs_reused) > 0 ? double(s.bfs_reused) / double(s.bfs_runs + s.bfs_reused) : 0.0;
+  stats["bfs set walls time"] = s.set_walls_time;
+  if(rmap_ != NULL)
+    stats["goal flagged unreachable"] = s.goal_flagged_unreachable;
+  if(prm_->goal_check_)
+    stats["goal ik solutions"] = s.goal_ik_solutions;
+  if(prm_->repair_start_)
+    stats["start repair steps"] = s.start_repair_steps;
+  if(prm_->use_coarse_lattice_)
+    stats["coarse expansions"] = s.coarse_expansions;
+  if(egraph_ != NULL && prm_->use_experience_graph_)
+  {
+    stats["egraph nodes"] = egraph_->getNumNodes();
+    stats["egraph successors"] = s.egraph_succs;
+    stats["egraph shortcuts"] = s.egraph_shortcuts;
+    stats["egraph snaps"] = s.egraph_snaps;
+    stats["egraph validation time"] = s.egraph_validation_time;
+  }
+  // a reused bfs was searched for an earlier request
+  if(bfs_ != NULL)
+    stats["bfs search time"] = s.bfs_runs > 0 ? bfs_->getSearchTime() : 0.0;
+  if(prm_->defer_primitives_)
+  {
+    mprim_stats_.getStats(stats);
+    stats["deferred edges checked"] = s.deferred_edges_checked;
+    stats["deferred edges rejected"] = s.deferred_edges_rejected;
+  }
+  as_->getStats(stats);
+  for(size_t i = 1; i < search_threads_.size(); ++i)
+  {
+    std::map<std::string, double> as_stats;
+    search_threads_[i].as->getStats(as_stats);
+    for(std::map<std::string, double>::const_iterator it = as_stats.begin(); it != as_stats.end(); ++it)
+      stats[it->first] += it->second;
+  }
+}
+
+void EnvironmentROBARM3D::resetStats()
+{
+  memset(&pdata_.stats, 0, sizeof(pdata_.stats));
+  for(size_t i = 0; i < search_threads_.size(); ++i)
+  {
+    memset(&search_threads_[i].stats, 0, sizeof(search_threads_[i].stats));
+    search_threads_[i].as->resetStats();
+  }
+  mprim_stats_.resetStats();
+}
+
+void EnvironmentROBARM3D::addTraceEvents()
+{
+  // bfs3d isn't traced itself, the search thread just keeps its times
+  if(!Tracer::isEnabled() || bfs_ == NULL || bfs_traced_ || bfs_->isRunning())
+    return;
+
+  double start = bfs_->getSearchStartTime();
+  Tracer::addEvent("bfs", "BFS_3D::search", "heuristic", start, start + bfs_->getSearchTime());
+  bfs_traced_ = true;
+}
+
+void EnvironmentROBARM3D::invalidateHeuristic()
+{
+  bfs_valid_ = false;
+  egraph_validated_ = false;
+  mprim_stats_.reset();
+  deferred_edges_.clear();
+}
+
+bool EnvironmentROBARM3D::checkGoalReachability()
+{
+  // the map is in the kinematics frame
+  KDL::Frame T_kinematics_to_planning;
+  rmodel_->getKinematicsToPlanningTransform(T_kinematics_to_planning);
+  const std::vector<double> &p = pdata_.goal.pose;
+  KDL::Frame f = T_kinematics_to_planning.Inverse() * KDL::Frame(KDL::Rotation::RPY(p[3], p[4], p[5]), KDL::Vector(p[0], p[1], p[2]));
+
+  if(!rmap_->isReachable(f.p.x(), f.p.y(), f.p.z()))
+  {
+    pdata_.stats.goal_flagged_unreachable = 1;
+    debug_code_ = GOAL_UNREACHABLE;
+    ROS_ERROR("[env] The goal position {%0.3f %0.3f %0.3f} is out of the reachability map of the planning link.", p[0], p[1], p[2]);
+    return false;
+  }
+
+  if(pdata_.goal.type == XYZ_RPY_GOAL && !rmap_->isReachable(f))
+  {
+    pdata_.stats.goal_flagged_unreachable = 1;
+    if(prm_->reachability_reject_orientation_)
+    {
+      debug_code_ = GOAL_UNREACHABLE;
+      ROS_ERROR("[env] The goal orientation {%0.3f %0.3f %0.3f} wasn't reached at {%0.3f %0.3f %0.3f} when the reachability map was sampled.", p[3], p[4], p[5], p[0], p[1], p[2]);
+      return false;
+    }
+    ROS_WARN("[env] The goal orientation {%0.3f %0.3f %0.3f} wasn't reached at {%0.3f %0.3f %0.3f} when the reachability map was sampled. It may be unreachable.", p[3], p[4], p[5], p[0], p[1], p[2]);
+  }
+  return true;
+}
+
+void EnvironmentROBARM3D::setExperienceGraph(ExperienceGraph *egraph)
+{
+  egraph_ = egraph;
+  egraph_version_ = -1;
+  egraph_validated_ = false;
+}
+
+void EnvironmentROBARM3D::setCancelFlag(const volatile bool *cancel)
+{
+  cancel_ = cancel;
+}
+
+void EnvironmentROBARM3D::addSearchThread(RobotModel *rm, CollisionChecker *cc, ActionSet *as)
+{
+  SearchThread t;
+  t.rm = rm;
+  t.cc = cc;
+  t.as = as;
+  memset(&t.stats, 0, sizeof(t.stats));
+  search_threads_.push_back(t);
+}
+
+void EnvironmentROBARM3D::setParallelSearch(bool parallel)
+{
+  if(parallel && max_joint_steps_.empty())
+    as_->getMaxJointSteps(max_joint_steps_);
+  parallel_ = parallel;
+}
+
+int EnvironmentROBARM3D::getLowerBoundCost(int FromStateID, int ToStateID)
+{
+  if(FromStateID == ToStateID)
+    return 0;
+
+  // the IK snap reaches the goal from anywhere
+  if(FromStateID == pdata_.goal_entry->stateID || ToStateID == pdata_.goal_entry->stateID)
+    return prm_->cost_multiplier_;
+
+  boost::unique_lock<boost::mutex> lock(table_mutex_, boost::defer_lock);
+  if(parallel_)
+    lock.lock();
+  const RobotState &from = pdata_.StateID2CoordTable[FromStateID]->state;
+  const RobotState &to = pdata_.StateID2CoordTable[ToStateID]->state;
+  if(parallel_)
+    lock.unlock();
+
+  // every edge costs at least cost_multiplier_ & moves a joint by at most its max step
+  double edges = 1;
+  for(size_t i = 0; i < max_joint_steps_.size() && i < from.size() && i < to.size(); ++i)
+  {
+    if(max_joint_steps_[i] > 0)
+      edges = std::max(edges, floor(fabs(angles::shortest_angular_distance(from[i], to[i])) / max_joint_steps_[i]));
+  }
+  return int(edges) * prm_->cost_multiplier_;
+}
+
+int EnvironmentROBARM3D::getSuccessorCost(int FromStateID, int ToStateID)
+{
+  // expands the state again, without counting it or moving the goal entry
+  EnvironmentStats s = pdata_.stats;
+  size_t num_expanded = pdata_.expanded_states.size();
+  EnvROBARM3DHashEntry_t goal = *pdata_.goal_entry;
+
+  std::vector<int> succs, costs;
+  GetSuccs(FromStateID, &succs, &costs, 0);
+
+  pdata_.stats = s;
+  pdata_.expanded_states.resize(num_expanded);
+  *pdata_.goal_entry = goal;
+
+  int c = -1;
+  for(size_t i = 0; i < succs.size(); ++i)
+  {
+    if(succs[i] == ToStateID && (c < 0 || costs[i] < c))
+      c = costs[i];
+  }
+  return c;
+}
+
+int EnvironmentROBARM3D::getCellIndex(int x, int y, int z) const
+{
+  int dimX, dimY, dimZ;
+  grid_->getGridSize(dimX, dimY, dimZ);
+  return x + dimX*(y + dimY*z);
+}
+
+void EnvironmentROBARM3D::indexExperienceGraph()
+{
+  ros::WallTime start = ros::WallTime::now();
+  int num_nodes = egraph_->getNumNodes();
+  std::vector<double> pose(6,0);
+  std::vector<int> coord(prm_->num_joints_,0);
+
+  // paths are appended, only renumbered nodes are indexed again
+  if(egraph_version_ != egraph_->getVersion())
+  {
+    egraph_version_ = egraph_->getVersion();
+    egraph_indexed_ = 0;
+    egraph_node_ok_.clear();
+    egraph_node_valid_.clear();
+    egraph_edge_valid_.clear();
+    egraph_xyz_.clear();
+    egraph_coord2node_.clear();
+    egraph_cell2nodes_.clear();
+  }
+
+  egraph_node_ok_.resize(num_nodes, false);
+  egraph_node_valid_.resize(num_nodes, -1);
+  egraph_edge_valid_.resize(num_nodes);
+  egraph_xyz_.resize(3*num_nodes, 0);
+  for(int i = egraph_indexed_; i < num_nodes; ++i)
+  {
+    const ExperienceGraph::Node &n = egraph_->getNode(i);
+    if(!rmodel_->computePlanningLinkFK(n.angles, pose))
+      continue;
+    grid_->worldToGrid(pose[0],pose[1],pose[2],egraph_xyz_[3*i],egraph_xyz_[3*i+1],egraph_xyz_[3*i+2]);
+    if(!rmodel_->checkJointLimits(n.angles))
+      continue;
+
+    egraph_node_ok_[i] = true;
+    anglesToCoord(n.angles, coord);
+    egraph_coord2node_[coord] = i;
+    egraph_cell2nodes_[getCellIndex(egraph_xyz_[3*i],egraph_xyz_[3*i+1],egraph_xyz_[3*i+2])].push_back(i);
+  }
+  int num_new = num_nodes - egraph_indexed_;
+  egraph_indexed_ = num_nodes;
+
+  // the scene changed, nothing is known about the collisions anymore
+  if(!egraph_validated_)
+  {
+    for(int i = 0; i < num_nodes; ++i)
+    {
+      egraph_node_valid_[i] = egraph_node_ok_[i] ? -1 : 0;
+      egraph_edge_valid_[i].assign(egraph_->getNode(i).edges.size(), -1);
+    }
+    egraph_validated_ = true;
+  }
+  else
+  {
+    // edges are appended to the nodes
+    for(int i = 0; i < num_nodes; ++i)
+    {
+      egraph_edge_valid_[i].resize(egraph_->getNode(i).edges.size(), -1);
+      if(!egraph_node_ok_[i])
+        egraph_node_valid_[i] = 0;
+    }
+  }
+
+  double t = (ros::WallTime::now() - start).toSec();
+  pdata_.stats.egraph_validation_time += t;
+  ROS_DEBUG("[env] Indexed %d new nodes of the experience graph in %0.4fsec. (nodes: %d)", num_new, t, num_nodes);
+}
+
+bool EnvironmentROBARM3D::isExperienceGraphNodeValid(int n)
+{
+  if(egraph_node_valid_[n] < 0)
+  {
+    ros::WallTime start = ros::WallTime::now();
+    double dist = 0;
+    egraph_node_valid_[n] = cc_->isStateValid(egraph_->getNode(n).angles, false, false, dist) ? 1 : 0;
+    pdata_.stats.egraph_validation_time += (ros::WallTime::now() - start).toSec();
+  }
+  return egraph_node_valid_[n] == 1;
+}
+
+bool EnvironmentROBARM3D::isExperienceGraphEdgeValid(int n, int j)
+{
+  if(egraph_edge_valid_[n][j] >= 0)
+    return egraph_edge_valid_[n][j] == 1;
+
+  int m = egraph_->getNode(n).edges[j];
+  signed char valid = 0;
+  if(isExperienceGraphNodeValid(n) && isExperienceGraphNodeValid(m))
+  {
+    ros::WallTime start = ros::WallTime::now();
+    int path_length=0, nchecks=0;
+    double dist=0;
+    valid = cc_->isStateToStateValid(egraph_->getNode(n).angles, egraph_->getNode(m).angles, path_length, nchecks, dist) ? 1 : 0;
+    pdata_.stats.egraph_validation_time += (ros::WallTime::now() - start).toSec();
+  }
+
+  // edges are stored in both directions
+  egraph_edge_valid_[n][j] = valid;
+  const std::vector<int> &back = egraph_->getNode(m).edges;
+  for(size_t k = 0; k < back.size(); ++k)
+  {
+    if(back[k] == n)
+      egraph_edge_valid_[m][k] = valid;
+  }
+  return valid == 1;
+}
+
+void EnvironmentROBARM3D::computeExperienceGraphHeuristic()
+{
+  int num_nodes = egraph_->getNumNodes();
+  egraph_heur_.assign(num_nodes, INT_MAX);
+  egraph_next_.assign(num_nodes, -1);
+
+  // a node can leave the graph & head to the goal (inflated bfs cost) or
+  // follow edges to a node that is closer to the goal (unless they're known
+  // to be invalid, the others are checked when the search uses them)
+  std::priority_queue<std::pair<int,int>, std::vector<std::pair<int,int> >, std::greater<std::pair<int,int> > > q;
+  for(int i = 0; i < num_nodes; ++i)
+  {
+    if(egraph_node_valid_[i] == 0)
+      continue;
+    int h = getBFSCostToGoal(egraph_xyz_[3*i], egraph_xyz_[3*i+1], egraph_xyz_[3*i+2]);
+    if(h == INT_MAX)
+      continue;
+    egraph_heur_[i] = int(std::min(double(INT_MAX-1), prm_->egraph_epsilon_ * h));
+    q.push(std::make_pair(egraph_heur_[i], i));
+  }
+
+  while(!q.empty())
+  {
+    std::pair<int,int> top = q.top();
+    q.pop();
+    int n = top.second;
+    if(top.first > egraph_heur_[n])
+      continue;
+
+    const std::vector<int> &edges = egraph_->getNode(n).edges;
+    for(size_t j = 0; j < edges.size(); ++j)
+    {
+      int m = edges[j];
+      if(egraph_edge_valid_[n][j] == 0 || egraph_node_valid_[m] == 0)
+        continue;
+      if(egraph_heur_[n] + prm_->cost_multiplier_ < egraph_heur_[m])
+      {
+        egraph_heur_[m] = egraph_heur_[n] + prm_->cost_multiplier_;
+        egraph_next_[m] = n;
+        q.push(std::make_pair(egraph_heur_[m], m));
+      }
+    }
+  }
+
+  // put the nodes that lead to the goal in buckets, so a state only looks at the ones nearby
+  std::map<int, int> bucket_ids;
+  egraph_buckets_.clear();
+  int dimX, dimY, dimZ;
+  grid_->getGridSize(dimX, dimY, dimZ);
+  int bx = (dimX + egraph_bucket_size_ - 1) / egraph_bucket_size_, by = (dimY + egraph_bucket_size_ - 1) / egraph_bucket_size_;
+  for(int i = 0; i < num_nodes; ++i)
+  {
+    if(egraph_heur_[i] == INT_MAX)
+      continue;
+    int b[3];
+    for(int k = 0; k < 3; ++k)
+      b[k] = std::max(0, egraph_xyz_[3*i+k]) / egraph_bucket_size_;
+    std::pair<std::map<int, int>::iterator, bool> it = bucket_ids.insert(std::make_pair(b[0] + bx*(b[1] + by*b[2]), int(egraph_buckets_.size())));
+    if(it.second)
+    {
+      EGraphBucket bucket;
+      for(int k = 0; k < 3; ++k)
+      {
+        bucket.lo[k] = b[k] * egraph_bucket_size_;
+        bucket.hi[k] = bucket.lo[k] + egraph_bucket_size_ - 1;
+      }
+      bucket.min_heur = INT_MAX;
+      egraph_buckets_.push_back(bucket);
+    }
+    EGraphBucket &bucket = egraph_buckets_[it.first->second];
+    bucket.nodes.push_back(i);
+    bucket.min_heur = std::min(bucket.min_heur, egraph_heur_[i]);
+  }
+}
+
+int EnvironmentROBARM3D::getExperienceGraphHeuristic(int FromStateID, int ToStateID)
+{
+  EnvROBARM3DHashEntry_t* FromHashEntry = pdata_.StateID2CoordTable[FromStateID];
+  const int *xyz = FromHashEntry->xyz;
+
+  // go straight to the goal...
+  int h = getXYZHeuristic(FromStateID, ToStateID);
+  double best = (h == INT_MAX) ? double(INT_MAX) : prm_->egraph_epsilon_ * h;
+
+  // ...or travel to the graph first and follow it (skipping the buckets that can't be better)
+  double cost_per_cell = prm_->egraph_epsilon_ * prm_->cost_per_cell_;
+  for(size_t b = 0; b < egraph_buckets_.size(); ++b)
+  {
+    const EGraphBucket &bucket = egraph_buckets_[b];
+    double d2 = 0;
+    for(int k = 0; k < 3; ++k)
+    {
+      int d = std::max(0, std::max(bucket.lo[k] - xyz[k], xyz[k] - bucket.hi[k]));
+      d2 += double(d)*d;
+    }
+    if(cost_per_cell * sqrt(d2) + bucket.min_heur >= best)
+      continue;
+
+    for(size_t j = 0; j < bucket.nodes.size(); ++j)
+    {
+      int i = bucket.nodes[j];
+      double dx = xyz[0] - egraph_xyz_[3*i];
+      double dy = xyz[1] - egraph_xyz_[3*i+1];
+      double dz = xyz[2] - egraph_xyz_[3*i+2];
+      double d = cost_per_cell * sqrt(dx*dx + dy*dy + dz*dz) + egraph_heur_[i];
+      if(d < best)
+        best = d;
+    }
+  }
+
+  FromHashEntry->heur = int(std::min(double(INT_MAX), best));
+  return FromHashEntry->heur;
+}
+
+void EnvironmentROBARM3D::getExperienceGraphSuccs(EnvROBARM3DHashEntry_t* parent, const RobotState &parent_angles, vector<int>* SuccIDV, vector<int>* CostV)
+{
+  bool is_goal;
+  int path_length=0, nchecks=0;
+  double dist=0;
+  EnvROBARM3DHashEntry_t* succ_entry;
+
+  if(!egraph_validated_ || egraph_heur_.empty())
+    return;
+
+  std::map<std::vector<int>, int>::const_iterator it = egraph_coord2node_.find(parent->coord);
+  if(it != egraph_coord2node_.end())
+  {
+    // on the graph: its neighbours...
+    int n = it->second;
+    const std::vector<int> &edges = egraph_->getNode(n).edges;
+    for(size_t j = 0; j < edges.size(); ++j)
+    {
+      if(!isExperienceGraphEdgeValid(n, j))
+        continue;
+      if((succ_entry = getSuccessorEntry(egraph_->getNode(edges[j]).angles, 0, is_goal)) == NULL)
+        continue;
+      SuccIDV->push_back(succ_entry->stateID);
+      CostV->push_back(prm_->cost_multiplier_);
+      pdata_.stats.egraph_succs++;
+    }
+
+    // ...and a shortcut to where the graph stops heading for the goal (or to an invalid edge)
+    int end = n, length = 0;
+    while(egraph_next_[end] >= 0 && length < egraph_->getNumNodes())
+    {
+      const std::vector<int> &next_edges = egraph_->getNode(end).edges;
+      size_t j = 0;
+      while(j < next_edges.size() && next_edges[j] != egraph_next_[end])
+        j++;
+      if(j == next_edges.size() || !isExperienceGraphEdgeValid(end, j))
+        break;
+      end = egraph_next_[end];
+      length++;
+    }
+    if(length > 1 && (succ_entry = getSuccessorEntry(egraph_->getNode(end).angles, 0, is_goal)) != NULL)
+    {
+      SuccIDV->push_back(succ_entry->stateID);
+      CostV->push_back(length * prm_->cost_multiplier_);
+      pdata_.stats.egraph_shortcuts++;
+    }
+    return;
+  }
+
+  // near the graph: snap onto nodes with the planning link in the same cell
+  std::map<int, std::vector<int> >::const_iterator cit = egraph_cell2nodes_.find(getCellIndex(parent->xyz[0], parent->xyz[1], parent->xyz[2]));
+  if(cit == egraph_cell2nodes_.end())
+    return;
+
+  for(size_t j = 0; j < cit->second.size(); ++j)
+  {
+    if(!isExperienceGraphNodeValid(cit->second[j]))
+      continue;
+    const RobotState &angles = egraph_->getNode(cit->second[j]).angles;
+    pdata_.stats.edge_checks++;
+    if(!cc_->isStateToStateValid(parent_angles, angles, path_length, nchecks, dist))
+    {
+      pdata_.stats.edge_checks_failed++;
+      continue;
+    }
+    if((succ_entry = getSuccessorEntry(angles, dist, is_goal)) == NULL)
+      continue;
+    SuccIDV->push_back(succ_entry->stateID);
+    CostV->push_back(prm_->cost_multiplier_);
+    pdata_.stats.egraph_snaps++;
+  }
+}
+
 double EnvironmentROBARM3D::getDistanceToGoal(double x, double y, double z)
 {
   double dist;
@@ -801,11 +1783,60 @@ double EnvironmentROBARM3D::getDistanceToGoal(double x, double y, double z)
   if(prm_->use_bfs_heuristic_)
     dist = double(bfs_->getDistance(dx, dy, dz)) * grid_->getResolution();
   else
-    dist = getEuclideanDistance(x, y, z, pdata_.goal.pose[0], pdata_.goal.pose[1], pdata_.goal.pose[2]);
+    dist = getEuclideanDistance(x, y, z, pdata_.heur_target[0], pdata_.heur_target[1], pdata_.heur_target[2]);
 
   return dist;
 }
 
+bool EnvironmentROBARM3D::getBFSPathWaypoint(double x, double y, double z, int num_cells, std::vector<double> &waypoint)
+{
+  if(!prm_->use_bfs_heuristic_ || bfs_ == NULL)
+    return false;
+
+  int dims[3], c[3], n[3];
+  grid_->getGridSize(dims[0], dims[1], dims[2]);
+  grid_->worldToGrid(x, y, z, c[0], c[1], c[2]);
+  if(c[0] < 0 || c[1] < 0 || c[2] < 0 || c[0] >= dims[0] || c[1] >= dims[1] || c[2] >= dims[2])
+    return false;
+
+  // unreached cells are negative, the walls are at INT_MAX
+  int d = bfs_->getDistance(c[0], c[1], c[2]);
+  if(d <= 0 || d >= INT_MAX)
+    return false;
+
+  // steepest descent over the 26 neighbors
+  int steps = 0;
+  for(; steps < num_cells && d > 0; ++steps)
+  {
+    int best[3] = {c[0], c[1], c[2]}, best_d = d;
+    for(int dz = -1; dz <= 1; ++dz)
+      for(int dy = -1; dy <= 1; ++dy)
+        for(int dx = -1; dx <= 1; ++dx)
+        {
+          n[0] = c[0] + dx; n[1] = c[1] + dy; n[2] = c[2] + dz;
+          if(n[0] < 0 || n[1] < 0 || n[2] < 0 || n[0] >= dims[0] || n[1] >= dims[1] || n[2] >= dims[2])
+            continue;
+          int nd = bfs_->getDistance(n[0], n[1], n[2]);
+          if(nd >= 0 && nd < best_d)
+          {
+            best_d = nd;
+            best[0] = n[0]; best[1] = n[1]; best[2] = n[2];
+          }
+        }
+    if(best_d == d)
+      break;
+    c[0] = best[0]; c[1] = best[1]; c[2] = best[2];
+    d = best_d;
+  }
+
+  if(steps == 0)
+    return false;
+
+  waypoint.resize(3);
+  grid_->gridToWorld(c[0], c[1], c[2], waypoint[0], waypoint[1], waypoint[2]);
+  return true;
+}
+
 std::vector<double> EnvironmentROBARM3D::getGoal()
 {
   return pdata_.goal.pose;
@@ -0,0 +1,243 @@
+/** \author Benjamin Cohen */
+
+#include <sbpl_arm_planner/experience_graph.h>
+#include <ros/ros.h>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <angles/angles.h>
+
+using namespace sbpl_arm_planner;
+
+ExperienceGraph::ExperienceGraph() : num_paths_(0), version_(0)
+{
+}
+
+void ExperienceGraph::clear()
+{
+  nodes_.clear();
+  index_.clear();
+  num_paths_ = 0;
+  version_++;
+}
+
+void ExperienceGraph::setResolution(const std::vector<double> &resolution)
+{
+  resolution_ = resolution;
+
+  // the nodes that are now the same are kept apart, only new ones are merged
+  index_.clear();
+  std::vector<int> key;
+  for(size_t i = 0; i < nodes_.size(); ++i)
+  {
+    getKey(nodes_[i].angles, key);
+    index_.insert(std::make_pair(key, int(i)));
+  }
+}
+
+void ExperienceGraph::getKey(const RobotState &angles, std::vector<int> &key) const
+{
+  // like the lattice, 0 & 2*pi are the same angle
+  key.resize(angles.size());
+  for(size_t j = 0; j < angles.size(); ++j)
+  {
+    double res = j < resolution_.size() ? resolution_[j] : 1e-6;
+    int num_vals = int(floor(2*M_PI / res + 0.5));
+    key[j] = int(floor(angles::normalize_angle_positive(angles[j]) / res + 0.5));
+    if(key[j] >= num_vals)
+      key[j] = 0;
+  }
+}
+
+int ExperienceGraph::getNumEdges() const
+{
+  int n = 0;
+  for(size_t i = 0; i < nodes_.size(); ++i)
+    n += nodes_[i].edges.size();
+  return n / 2;
+}
+
+int ExperienceGraph::getNode(const RobotState &angles)
+{
+  std::vector<int> key;
+  getKey(angles, key);
+  boost::unordered_map<std::vector<int>, int>::const_iterator it = index_.find(key);
+  if(it != index_.end())
+  {
+    nodes_[it->second].last_used = num_paths_;
+    return it->second;
+  }
+
+  Node n;
+  n.angles = angles;
+  n.last_used = num_paths_;
+  nodes_.push_back(n);
+  index_[key] = int(nodes_.size()) - 1;
+  return int(nodes_.size()) - 1;
+}
+
+void ExperienceGraph::addEdge(int from, int to)
+{
+  if(from == to)
+    return;
+
+  for(size_t i = 0; i < nodes_[from].edges.size(); ++i)
+  {
+    if(nodes_[from].edges[i] == to)
+      return;
+  }
+  nodes_[from].edges.push_back(to);
+  nodes_[to].edges.push_back(from);
+}
+
+void ExperienceGraph::addPath(const std::vector<RobotState> &path)
+{
+  num_paths_++;
+  int prev = -1;
+  for(size_t i = 0; i < path.size(); ++i)
+  {
+    int id = getNode(path[i]);
+    if(prev >= 0)
+      addEdge(prev, id);
+    prev = id;
+  }
+  ROS_INFO("[egraph] Added a path with %d waypoints. The graph has %d nodes and %d edges.", int(path.size()), getNumNodes(), getNumEdges());
+}
+
+bool ExperienceGraph::prune(int max_nodes)
+{
+  if(max_nodes < 0 || int(nodes_.size()) <= max_nodes)
+    return false;
+
+  // the most recently used nodes are kept (the newer of two that were used together)
+  std::vector<std::pair<int,int> > order(nodes_.size());
+  for(size_t i = 0; i < nodes_.size(); ++i)
+    order[i] = std::make_pair(-nodes_[i].last_used, -int(i));
+  std::nth_element(order.begin(), order.begin() + max_nodes, order.end());
+
+  std::vector<int> new_id(nodes_.size(), -1);
+  std::vector<bool> keep(nodes_.size(), false);
+  for(int i = 0; i < max_nodes; ++i)
+    keep[-order[i].second] = true;
+
+  std::vector<Node> nodes;
+  nodes.reserve(max_nodes);
+  for(size_t i = 0; i < nodes_.size(); ++i)
+  {
+    if(!keep[i])
+      continue;
+    new_id[i] = nodes.size();
+    nodes.push_back(nodes_[i]);
+  }
+  for(size_t i = 0; i < nodes.size(); ++i)
+  {
+    std::vector<int> edges;
+    for(size_t j = 0; j < nodes[i].edges.size(); ++j)
+    {
+      if(new_id[nodes[i].edges[j]] >= 0)
+        edges.push_back(new_id[nodes[i].edges[j]]);
+    }
+    nodes[i].edges = edges;
+  }
+
+  int num_removed = int(nodes_.size()) - max_nodes;
+  nodes_.swap(nodes);
+  setResolution(resolution_);
+  version_++;
+  ROS_INFO("[egraph] Removed the %d least recently used nodes. The graph has %d nodes and %d edges.", num_removed, getNumNodes(), getNumEdges());
+  return true;
+}
+
+bool ExperienceGraph::load(std::string filename)
+{
+  FILE* file = fopen(filename.c_str(), "r");
+  if(file == NULL)
+  {
+    ROS_WARN("[egraph] Failed to open '%s'. Starting with an empty experience graph.", filename.c_str());
+    return false;
+  }
+
+  char sTemp[1024];
+  int num_nodes = 0, num_joints = 0, num_edges = 0;
+  if(fscanf(file, "%1023s %d %d", sTemp, &num_nodes, &num_joints) != 3 || strcmp(sTemp, "Experience_Graph:") != 0)
+  {
+    ROS_ERROR("[egraph] '%s' should begin with 'Experience_Graph: <# nodes> <# joints>'.", filename.c_str());
+    fclose(file);
+    return false;
+  }
+
+  // nodes that are the same at the resolution are merged
+  clear();
+  std::vector<int> ids(num_nodes, -1);
+  RobotState angles(num_joints, 0);
+  for(int i = 0; i < num_nodes; ++i)
+  {
+    for(int j = 0; j < num_joints; ++j)
+    {
+      if(fscanf(file, "%lf", &(angles[j])) != 1)
+      {
+        ROS_ERROR("[egraph] End of file reached while reading node %d.", i);
+        clear();
+        fclose(file);
+        return false;
+      }
+    }
+    ids[i] = getNode(angles);
+  }
+
+  if(fscanf(file, "%1023s %d", sTemp, &num_edges) == 2 && strcmp(sTemp, "Edges:") == 0)
+  {
+    int from, to;
+    for(int i = 0; i < num_edges; ++i)
+    {
+      if(fscanf(file, "%d %d", &from, &to) != 2 || from < 0 || to < 0 || from >= num_nodes || to >= num_nodes)
+      {
+        ROS_ERROR("[egraph] Edge %d is broken.", i);
+        break;
+      }
+      addEdge(ids[from], ids[to]);
+    }
+  }
+  fclose(file);
+
+  ROS_INFO("[egraph] Loaded '%s' with %d nodes and %d edges.", filename.c_str(), getNumNodes(), getNumEdges());
+  return true;
+}
+
+bool ExperienceGraph::save(std::string filename) const
+{
+  std::string tmp_filename = filename + ".tmp";
+  FILE* file = fopen(tmp_filename.c_str(), "w");
+  if(file == NULL)
+  {
+    ROS_ERROR("[egraph] Failed to open '%s' for writing.", tmp_filename.c_str());
+    return false;
+  }
+
+  int num_joints = nodes_.empty() ? 0 : int(nodes_[0].angles.size());
+  fprintf(file, "Experience_Graph: %d %d\n", getNumNodes(), num_joints);
+  for(size_t i = 0; i < nodes_.size(); ++i)
+  {
+    for(size_t j = 0; j < nodes_[i].angles.size(); ++j)
+      fprintf(file, "%0.6f ", nodes_[i].angles[j]);
+    fprintf(file, "\n");
+  }
+
+  fprintf(file, "Edges: %d\n", getNumEdges());
+  for(size_t i = 0; i < nodes_.size(); ++i)
+  {
+    for(size_t j = 0; j < nodes_[i].edges.size(); ++j)
+    {
+      if(nodes_[i].edges[j] > int(i))
+        fprintf(file, "%d %d\n", int(i), nodes_[i].edges[j]);
+    }
+  }
+  if(fclose(file) != 0 || rename(tmp_filename.c_str(), filename.c_str()) != 0)
+  {
+    ROS_ERROR("[egraph] Failed to write '%s'.", filename.c_str());
+    return false;
+  }
+  return true;
+}
+
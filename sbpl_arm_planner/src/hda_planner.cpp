@@ -0,0 +1,305 @@
+/** \author Benjamin Cohen */
+
+#include <sbpl_arm_planner/hda_planner.h>
+#include <limits.h>
+#include <float.h>
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+using namespace sbpl_arm_planner;
+
+HDAPlanner::HDAPlanner(EnvironmentROBARM3D *env) : env_(env), start_id_(-1), goal_id_(-1), w_(-1), initial_w_(100.0), solution_cost_(INT_MAX), done_(false), n_sent_(0), n_received_(0)
+{
+  force_planning_from_scratch();
+}
+
+HDAPlanner::~HDAPlanner()
+{
+  clearWorkers();
+}
+
+void HDAPlanner::clearWorkers()
+{
+  for(size_t i = 0; i < workers_.size(); ++i)
+    delete workers_[i];
+  workers_.clear();
+}
+
+int HDAPlanner::set_start(int start_stateID)
+{
+  start_id_ = start_stateID;
+  return 1;
+}
+
+int HDAPlanner::set_goal(int goal_stateID)
+{
+  goal_id_ = goal_stateID;
+  return 1;
+}
+
+int HDAPlanner::set_search_mode(bool bSearchUntilFirstSolution)
+{
+  // the first goal that's reached isn't within w of the optimal cost, the
+  // interface stops after the first w of the schedule instead
+  return 1;
+}
+
+int HDAPlanner::force_planning_from_scratch()
+{
+  w_ = -1;
+  n_expands_ = 0;
+  n_messages_ = 0;
+  n_reexpands_ = 0;
+  solution_eps_ = -1;
+  initial_eps_ = -1;
+  initial_eps_time_ = 0;
+  final_eps_time_ = 0;
+  n_expands_init_solution_ = 0;
+  t_start_ = ros::WallTime::now();
+  return 1;
+}
+
+int HDAPlanner::replan(double allocated_time_secs, std::vector<int>* solution_stateIDs_V)
+{
+  int solcost;
+  return replan(allocated_time_secs, solution_stateIDs_V, &solcost);
+}
+
+int HDAPlanner::replan(double allocated_time_secs, std::vector<int>* solution_stateIDs_V, int* solcost)
+{
+  ReplanParams params(allocated_time_secs);
+  params.initial_eps = initial_w_;
+  params.final_eps = initial_w_;
+  return replan(solution_stateIDs_V, params, solcost);
+}
+
+int HDAPlanner::replan(std::vector<int>* solution_stateIDs_V, ReplanParams params)
+{
+  int solcost;
+  return replan(solution_stateIDs_V, params, &solcost);
+}
+
+int HDAPlanner::replan(std::vector<int>* solution_stateIDs_V, ReplanParams params, int* solcost)
+{
+  solution_stateIDs_V->clear();
+  if(start_id_ < 0 || goal_id_ < 0)
+  {
+    ROS_ERROR("[hda] The start & goal have to be set before planning.");
+    return 0;
+  }
+
+  // the next inflation of the schedule, the last one is searched once
+  if(w_ < 0)
+    w_ = params.initial_eps;
+  else if(w_ <= params.final_eps)
+    return 0;
+  else
+    w_ = std::max(params.final_eps, w_ - params.dec_eps);
+  if(w_ < 1.0)
+    w_ = 1.0;
+
+  int num_threads = env_->getNumSearchThreads();
+  clearWorkers();
+  for(int i = 0; i < num_threads; ++i)
+  {
+    Worker *w = new Worker;
+    w->min_f = DBL_MAX;
+    w->n_expands = 0;
+    w->n_messages = 0;
+    w->n_reexpands = 0;
+    workers_.push_back(w);
+  }
+  solution_cost_ = INT_MAX;
+  done_ = false;
+  n_sent_ = 0;
+  n_received_ = 0;
+  deadline_ = ros::WallTime::now() + ros::WallDuration(std::max(params.max_time, 0.0));
+
+  Worker &owner = *workers_[getOwner(start_id_)];
+  relax(owner, start_id_, 0, -1);
+  publishMinF(owner);
+
+  // thread 0 is this one
+  env_->setParallelSearch(true);
+  boost::thread_group threads;
+  for(int i = 1; i < num_threads; ++i)
+    threads.create_thread(boost::bind(&HDAPlanner::search, this, i));
+  search(0);
+  threads.join_all();
+  env_->setParallelSearch(false);
+
+  int n_expands = 0;
+  size_t n_states = 0;
+  for(int i = 0; i < num_threads; ++i)
+  {
+    n_states += workers_[i]->states.size();
+    n_expands += workers_[i]->n_expands;
+    n_messages_ += workers_[i]->n_messages;
+    n_reexpands_ += workers_[i]->n_reexpands;
+  }
+  n_expands_ += n_expands;
+
+  if(solution_cost_ == INT_MAX)
+  {
+    ROS_INFO("[hda] No solution found with w: %0.3f  (expansions: %d  threads: %d)", w_, n_expands, num_threads);
+    return 0;
+  }
+
+  // follow the parents from the goal, the g-values decrease along the way
+  for(int id = goal_id_; id >= 0; id = workers_[getOwner(id)]->states[id].parent)
+  {
+    solution_stateIDs_V->push_back(id);
+    if(solution_stateIDs_V->size() > n_states)
+    {
+      ROS_ERROR("[hda] The parents of the goal lead to a cycle.");
+      solution_stateIDs_V->clear();
+      return 0;
+    }
+  }
+  std::reverse(solution_stateIDs_V->begin(), solution_stateIDs_V->end());
+  *solcost = solution_cost_;
+
+  solution_eps_ = w_;
+  final_eps_time_ = (ros::WallTime::now() - t_start_).toSec();
+  if(initial_eps_ < 0)
+  {
+    initial_eps_ = solution_eps_;
+    initial_eps_time_ = final_eps_time_;
+    n_expands_init_solution_ = n_expands_;
+  }
+  ROS_INFO("[hda] Solution with w: %0.3f  cost: %d  (expansions: %d  messages: %d  threads: %d)", w_, *solcost, n_expands, n_messages_, num_threads);
+  return 1;
+}
+
+int HDAPlanner::getOwner(int id) const
+{
+  // the ids are handed out in order, so they're scattered first (Knuth)
+  return int((unsigned int)(id) * 2654435761u % (unsigned int)(workers_.size()));
+}
+
+void HDAPlanner::relax(Worker &w, int id, int g, int parent)
+{
+  boost::unordered_map<int, SearchState>::iterator it = w.states.find(id);
+  if(it == w.states.end())
+  {
+    SearchState s;
+    s.g = INT_MAX;
+    s.h = -1;
+    s.parent = -1;
+    s.closed = false;
+    s.f = -1;
+    it = w.states.insert(std::make_pair(id, s)).first;
+  }
+
+  SearchState &s = it->second;
+  if(g >= s.g)
+    return;
+  s.g = g;
+  s.parent = parent;
+
+  // the goal isn't expanded
+  if(id == goal_id_)
+  {
+    if(g < solution_cost_)
+      solution_cost_ = g;
+    return;
+  }
+
+  if(s.f >= 0)
+    w.open.erase(std::make_pair(s.f, id));
+  if(s.h < 0)
+    s.h = env_->GetGoalHeuristic(id);
+  s.f = double(g) + w_ * double(s.h);
+  w.open.insert(std::make_pair(s.f, id));
+}
+
+void HDAPlanner::publishMinF(Worker &w)
+{
+  w.min_f = w.open.empty() ? DBL_MAX : w.open.begin()->first;
+  __sync_synchronize();
+}
+
+bool HDAPlanner::isDone()
+{
+  long sent = n_sent_;
+  __sync_synchronize();
+  if(n_received_ != sent)
+    return false;
+  for(size_t i = 0; i < workers_.size(); ++i)
+  {
+    if(workers_[i]->min_f < double(solution_cost_))
+      return false;
+  }
+  // nothing was sent while looking at the workers
+  __sync_synchronize();
+  return n_sent_ == sent;
+}
+
+void HDAPlanner::search(int thread)
+{
+  Worker &w = *workers_[thread];
+  std::vector<int> succs, costs;
+  Message m;
+  while(!done_)
+  {
+    if(ros::WallTime::now() > deadline_)
+    {
+      done_ = true;
+      break;
+    }
+
+    // the successors that the other workers found for the states of this one
+    long n_received = 0;
+    while(w.queue.pop(m))
+    {
+      relax(w, m.id, m.g, m.parent);
+      n_received++;
+    }
+    if(n_received > 0)
+    {
+      publishMinF(w);
+      __sync_fetch_and_add(&n_received_, n_received);
+    }
+
+    // nothing left that can lead to a cheaper solution, unless a message shows up
+    if(w.open.empty() || w.open.begin()->first >= double(solution_cost_))
+    {
+      if(isDone())
+        done_ = true;
+      else
+        boost::this_thread::yield();
+      continue;
+    }
+
+    // min_f stays at the f-value of this state (or less) until it's expanded
+    int id = w.open.begin()->second;
+    SearchState &s = w.states[id];
+    w.open.erase(w.open.begin());
+    s.f = -1;
+    if(s.closed)
+      w.n_reexpands++;
+    s.closed = true;
+    int g = s.g;
+
+    env_->GetSuccs(id, &succs, &costs, thread);
+    w.n_expands++;
+
+    for(size_t i = 0; i < succs.size(); ++i)
+    {
+      int owner = getOwner(succs[i]);
+      if(owner == thread)
+      {
+        relax(w, succs[i], g + costs[i], id);
+        continue;
+      }
+      m.id = succs[i];
+      m.g = g + costs[i];
+      m.parent = id;
+      __sync_fetch_and_add(&n_sent_, 1);
+      workers_[owner]->queue.push(m);
+      w.n_messages++;
+    }
+    publishMinF(w);
+  }
+}
@@ -0,0 +1,244 @@
+/** \author Benjamin Cohen */
+
+#include <sbpl_arm_planner/pase_planner.h>
+#include <limits.h>
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+using namespace sbpl_arm_planner;
+
+PASEPlanner::PASEPlanner(EnvironmentROBARM3D *env, double epsilon, int max_candidates) : env_(env), epsilon_(epsilon), max_candidates_(max_candidates), start_id_(-1), goal_id_(-1), first_solution_only_(false), w_(-1), initial_w_(100.0), done_(false), found_(false)
+{
+  if(epsilon_ < 1.0)
+    epsilon_ = 1.0;
+  if(max_candidates_ < 1)
+    max_candidates_ = 1;
+  force_planning_from_scratch();
+}
+
+int PASEPlanner::set_start(int start_stateID)
+{
+  start_id_ = start_stateID;
+  return 1;
+}
+
+int PASEPlanner::set_goal(int goal_stateID)
+{
+  goal_id_ = goal_stateID;
+  return 1;
+}
+
+int PASEPlanner::set_search_mode(bool bSearchUntilFirstSolution)
+{
+  first_solution_only_ = bSearchUntilFirstSolution;
+  return 1;
+}
+
+int PASEPlanner::force_planning_from_scratch()
+{
+  w_ = -1;
+  n_expands_ = 0;
+  n_waits_ = 0;
+  solution_eps_ = -1;
+  initial_eps_ = -1;
+  initial_eps_time_ = 0;
+  final_eps_time_ = 0;
+  n_expands_init_solution_ = 0;
+  t_start_ = ros::WallTime::now();
+  return 1;
+}
+
+int PASEPlanner::replan(double allocated_time_secs, std::vector<int>* solution_stateIDs_V)
+{
+  int solcost;
+  return replan(allocated_time_secs, solution_stateIDs_V, &solcost);
+}
+
+int PASEPlanner::replan(double allocated_time_secs, std::vector<int>* solution_stateIDs_V, int* solcost)
+{
+  ReplanParams params(allocated_time_secs);
+  params.initial_eps = initial_w_;
+  params.final_eps = initial_w_;
+  params.return_first_solution = first_solution_only_;
+  return replan(solution_stateIDs_V, params, solcost);
+}
+
+int PASEPlanner::replan(std::vector<int>* solution_stateIDs_V, ReplanParams params)
+{
+  int solcost;
+  return replan(solution_stateIDs_V, params, &solcost);
+}
+
+int PASEPlanner::replan(std::vector<int>* solution_stateIDs_V, ReplanParams params, int* solcost)
+{
+  solution_stateIDs_V->clear();
+  if(start_id_ < 0 || goal_id_ < 0)
+  {
+    ROS_ERROR("[pase] The start & goal have to be set before planning.");
+    return 0;
+  }
+
+  // the next inflation of the schedule, the last one is searched once
+  if(w_ < 0)
+    w_ = params.initial_eps;
+  else if(w_ <= params.final_eps)
+    return 0;
+  else
+    w_ = std::max(params.final_eps, w_ - params.dec_eps);
+  if(w_ < 1.0)
+    w_ = 1.0;
+
+  states_.clear();
+  open_.clear();
+  being_expanded_.clear();
+  done_ = false;
+  found_ = false;
+  deadline_ = ros::WallTime::now() + ros::WallDuration(std::max(params.max_time, 0.0));
+
+  getState(start_id_).g = 0;
+  insert(start_id_);
+
+  // thread 0 is this one
+  env_->setParallelSearch(true);
+  int num_threads = env_->getNumSearchThreads();
+  boost::thread_group threads;
+  for(int i = 1; i < num_threads; ++i)
+    threads.create_thread(boost::bind(&PASEPlanner::search, this, i));
+  search(0);
+  threads.join_all();
+  env_->setParallelSearch(false);
+
+  if(!found_)
+  {
+    ROS_INFO("[pase] No solution found with w: %0.3f  (expansions: %d  threads: %d)", w_, n_expands_, num_threads);
+    return 0;
+  }
+
+  // follow the parents from the goal
+  for(int id = goal_id_; id >= 0; id = states_[id].parent)
+    solution_stateIDs_V->push_back(id);
+  std::reverse(solution_stateIDs_V->begin(), solution_stateIDs_V->end());
+  *solcost = states_[goal_id_].g;
+
+  solution_eps_ = w_ * epsilon_;
+  final_eps_time_ = (ros::WallTime::now() - t_start_).toSec();
+  if(initial_eps_ < 0)
+  {
+    initial_eps_ = solution_eps_;
+    initial_eps_time_ = final_eps_time_;
+    n_expands_init_solution_ = n_expands_;
+  }
+  ROS_INFO("[pase] Solution with w: %0.3f  bound: %0.3f  cost: %d  (expansions: %d  waits: %d  threads: %d)", w_, solution_eps_, *solcost, n_expands_, n_waits_, num_threads);
+  return 1;
+}
+
+PASEPlanner::SearchState& PASEPlanner::getState(int id)
+{
+  // the env creates the states while they're expanded
+  if(id >= int(states_.size()))
+  {
+    SearchState s;
+    s.g = INT_MAX;
+    s.h = -1;
+    s.parent = -1;
+    s.closed = false;
+    s.f = -1;
+    states_.resize(id + 1, s);
+  }
+  return states_[id];
+}
+
+void PASEPlanner::insert(int id)
+{
+  SearchState &s = states_[id];
+  if(s.f >= 0)
+    open_.erase(std::make_pair(s.f, id));
+  if(s.h < 0)
+    s.h = env_->GetGoalHeuristic(id);
+  s.f = double(s.g) + w_ * double(s.h);
+  open_.insert(std::make_pair(s.f, id));
+}
+
+bool PASEPlanner::isSafe(int id, int ahead_id)
+{
+  const SearchState &s = states_[id], &a = states_[ahead_id];
+  if(s.g <= a.g)
+    return true;
+  return double(s.g) <= double(a.g) + epsilon_ * double(env_->getLowerBoundCost(ahead_id, id));
+}
+
+int PASEPlanner::selectState()
+{
+  int n = 0;
+  std::set<std::pair<double, int> >::iterator it, ahead;
+  for(it = open_.begin(); it != open_.end() && n < max_candidates_; ++it, ++n)
+  {
+    int id = it->second;
+    bool safe = true;
+    for(size_t i = 0; i < being_expanded_.size() && safe; ++i)
+      safe = isSafe(id, being_expanded_[i]);
+    for(ahead = open_.begin(); ahead != it && safe; ++ahead)
+      safe = isSafe(id, ahead->second);
+    if(safe)
+      return id;
+  }
+  return -1;
+}
+
+void PASEPlanner::search(int thread)
+{
+  std::vector<int> succs, costs;
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  while(!done_)
+  {
+    if(ros::WallTime::now() > deadline_ || (open_.empty() && being_expanded_.empty()))
+    {
+      done_ = true;
+      break;
+    }
+
+    // wait for an expansion to finish if nothing is safe to expand
+    int id = open_.empty() ? -1 : selectState();
+    if(id < 0)
+    {
+      n_waits_++;
+      cond_.timed_wait(lock, boost::posix_time::milliseconds(10));
+      continue;
+    }
+
+    if(id == goal_id_)
+    {
+      found_ = true;
+      done_ = true;
+      break;
+    }
+
+    SearchState &s = states_[id];
+    open_.erase(std::make_pair(s.f, id));
+    s.f = -1;
+    s.closed = true;
+    int g = s.g;
+    being_expanded_.push_back(id);
+
+    lock.unlock();
+    env_->GetSuccs(id, &succs, &costs, thread);
+    lock.lock();
+    n_expands_++;
+
+    for(size_t i = 0; i < succs.size(); ++i)
+    {
+      SearchState &c = getState(succs[i]);
+      if(c.closed || g + costs[i] >= c.g)
+        continue;
+      c.g = g + costs[i];
+      c.parent = id;
+      insert(succs[i]);
+    }
+
+    being_expanded_.erase(std::find(being_expanded_.begin(), being_expanded_.end(), id));
+    cond_.notify_all();
+  }
+  cond_.notify_all();
+}
+
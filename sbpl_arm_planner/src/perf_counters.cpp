@@ -0,0 +1,165 @@
+/** \author Benjamin Cohen */
+
+#include <sbpl_arm_planner/perf_counters.h>
+#include <ros/console.h>
+#include <string.h>
+#include <errno.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+using namespace sbpl_arm_planner;
+
+static const char* counter_names[PerfCounters::NUMBER_OF_COUNTERS] = {"cycles", "instructions", "llc misses", "branch misses"};
+
+PerfCounters::PerfCounters() : tid_(-1), warned_(false)
+{
+  for(int i = 0; i < NUMBER_OF_COUNTERS; ++i)
+  {
+    fd_[i] = -1;
+    started_[i] = false;
+  }
+}
+
+PerfCounters::~PerfCounters()
+{
+  close();
+}
+
+bool PerfCounters::open()
+{
+#ifdef __linux__
+  long tid = syscall(SYS_gettid);
+  if(tid == tid_)
+    return isOpen();
+  close();
+  tid_ = tid;
+
+  const unsigned long long configs[NUMBER_OF_COUNTERS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+  int err = 0;
+  for(int i = 0; i < NUMBER_OF_COUNTERS; ++i)
+  {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = configs[i];
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // the counters are multiplexed if there aren't enough of them
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    fd_[i] = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    if(fd_[i] < 0)
+      err = errno;
+  }
+
+  if(err != 0 && !warned_)
+  {
+    ROS_WARN("[perf] Failed to open some of the hardware performance counters (%s). They won't be in the stats.", strerror(err));
+    warned_ = true;
+  }
+  return isOpen();
+#else
+  if(!warned_)
+  {
+    ROS_WARN("[perf] Hardware performance counters are only supported on Linux.");
+    warned_ = true;
+  }
+  return false;
+#endif
+}
+
+void PerfCounters::close()
+{
+  for(int i = 0; i < NUMBER_OF_COUNTERS; ++i)
+  {
+#ifdef __linux__
+    if(fd_[i] >= 0)
+      ::close(fd_[i]);
+#endif
+    fd_[i] = -1;
+    started_[i] = false;
+  }
+  tid_ = -1;
+}
+
+bool PerfCounters::isOpen()
+{
+  for(int i = 0; i < NUMBER_OF_COUNTERS; ++i)
+  {
+    if(fd_[i] >= 0)
+      return true;
+  }
+  return false;
+}
+
+void PerfCounters::reset()
+{
+  counts_.clear();
+}
+
+void PerfCounters::reset(const std::string &phase)
+{
+  counts_.erase(phase);
+}
+
+void PerfCounters::start()
+{
+  if(!open())
+    return;
+
+  for(int i = 0; i < NUMBER_OF_COUNTERS; ++i)
+    started_[i] = (fd_[i] >= 0) && readCounter(i, start_[i]);
+}
+
+void PerfCounters::stop(const std::string &phase)
+{
+  if(!isOpen())
+    return;
+
+  // -1 for the counters that couldn't be read
+  std::vector<double> &counts = counts_[phase];
+  counts.assign(NUMBER_OF_COUNTERS, -1);
+
+  for(int i = 0; i < NUMBER_OF_COUNTERS; ++i)
+  {
+    unsigned long long v[3];
+    if(!started_[i] || !readCounter(i, v))
+      continue;
+
+    // scale up the count if the counter was multiplexed with others
+    double enabled = v[1] - start_[i][1], running = v[2] - start_[i][2];
+    counts[i] = v[0] - start_[i][0];
+    if(running > 0 && running < enabled)
+      counts[i] *= enabled / running;
+    started_[i] = false;
+  }
+}
+
+bool PerfCounters::readCounter(int i, unsigned long long v[3])
+{
+#ifdef __linux__
+  // value, time enabled, time running
+  return read(fd_[i], v, 3*sizeof(unsigned long long)) == ssize_t(3*sizeof(unsigned long long));
+#else
+  return false;
+#endif
+}
+
+void PerfCounters::getStats(std::map<std::string, double> &stats)
+{
+  for(std::map<std::string, std::vector<double> >::const_iterator it = counts_.begin(); it != counts_.end(); ++it)
+  {
+    for(int j = 0; j < NUMBER_OF_COUNTERS; ++j)
+    {
+      if(it->second[j] >= 0)
+        stats[it->first + " " + counter_names[j]] = it->second[j];
+    }
+  }
+}
+
@@ -0,0 +1,428 @@
+/** \author Benjamin Cohen */
+
+#include <sbpl_arm_planner/planner_pool.h>
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+using namespace sbpl_arm_planner;
+
+PlannerPool::PlannerPool(distance_field::PropagationDistanceField* df) : df_(df), portfolio_first_solution_(true)
+{
+}
+
+PlannerPool::~PlannerPool()
+{
+  for(size_t i = 0; i < planners_.size(); ++i)
+    delete planners_[i];
+}
+
+bool PlannerPool::addPlanner(RobotModel *rm, CollisionChecker *cc, ActionSet *as)
+{
+  if(rm == NULL || cc == NULL || as == NULL)
+  {
+    ROS_ERROR("[pool] Planners need their own robot model, collision checker and action set.");
+    return false;
+  }
+  planners_.push_back(new SBPLArmPlannerInterface(rm, cc, as, df_));
+  planner_scenes_.push_back(arm_navigation_msgs::PlanningSceneConstPtr());
+  return true;
+}
+
+bool PlannerPool::addSearchThread(RobotModel *rm, CollisionChecker *cc, ActionSet *as)
+{
+  if(planners_.empty())
+  {
+    ROS_ERROR("[pool] Search threads are added to a planner, add the planner first.");
+    return false;
+  }
+  return planners_.back()->addSearchThread(rm, cc, as);
+}
+
+bool PlannerPool::init()
+{
+  if(planners_.empty())
+  {
+    ROS_ERROR("[pool] No planners were added to the pool.");
+    return false;
+  }
+
+  boost::mutex::scoped_lock lock(idle_mutex_);
+  idle_.clear();
+  for(size_t i = 0; i < planners_.size(); ++i)
+  {
+    if(!planners_[i]->init())
+    {
+      ROS_ERROR("[pool] Failed to initialize planner %d.", int(i));
+      return false;
+    }
+    idle_.push_back(i);
+    default_configs_.push_back(planners_[i]->getConfiguration());
+  }
+  ROS_INFO("[pool] Initialized %d planners.", int(planners_.size()));
+  return true;
+}
+
+int PlannerPool::size()
+{
+  return int(planners_.size());
+}
+
+int PlannerPool::acquirePlanner()
+{
+  boost::mutex::scoped_lock lock(idle_mutex_);
+  while(idle_.empty())
+    idle_cond_.wait(lock);
+  int id = idle_.front();
+  idle_.pop_front();
+  return id;
+}
+
+int PlannerPool::tryAcquirePlanner()
+{
+  boost::mutex::scoped_lock lock(idle_mutex_);
+  if(idle_.empty())
+    return -1;
+  int id = idle_.front();
+  idle_.pop_front();
+  return id;
+}
+
+void PlannerPool::releasePlanner(int id)
+{
+  {
+    boost::mutex::scoped_lock lock(idle_mutex_);
+    idle_.push_back(id);
+  }
+  idle_cond_.notify_one();
+}
+
+bool PlannerPool::applyScene(int id, const arm_navigation_msgs::PlanningSceneConstPtr& planning_scene)
+{
+  // the caller holds the scene lock exclusively
+  if(!planners_[id]->setPlanningScene(planning_scene))
+    return false;
+  planner_scenes_[id] = planning_scene;
+  scene_ = planning_scene;
+  return true;
+}
+
+bool PlannerPool::lockScene(const std::vector<int> &ids, const arm_navigation_msgs::PlanningSceneConstPtr& planning_scene, double &preprocess_time)
+{
+  preprocess_time = 0;
+
+  // only one thread can hold the upgrade lock, so the check and the
+  // update of the scene can't interleave with another request's
+  scene_mutex_.lock_upgrade();
+
+  std::vector<int> stale;
+  for(size_t i = 0; i < ids.size(); ++i)
+  {
+    if(scene_ != planning_scene || planner_scenes_[ids[i]] != planning_scene)
+      stale.push_back(ids[i]);
+  }
+
+  if(!stale.empty())
+  {
+    ros::WallTime t_preprocess = ros::WallTime::now();
+    scene_mutex_.unlock_upgrade_and_lock();
+    bool b_scene = true;
+    for(size_t i = 0; i < stale.size(); ++i)
+    {
+      if(!applyScene(stale[i], planning_scene))
+      {
+        ROS_ERROR("[pool] Planner %d failed to set the planning scene.", stale[i]);
+        b_scene = false;
+      }
+    }
+    scene_mutex_.unlock_and_lock_upgrade();
+    preprocess_time = (ros::WallTime::now() - t_preprocess).toSec();
+
+    if(!b_scene)
+    {
+      scene_mutex_.unlock_upgrade();
+      return false;
+    }
+  }
+  scene_mutex_.unlock_upgrade_and_lock_shared();
+  return true;
+}
+
+bool PlannerPool::solve(const arm_navigation_msgs::PlanningSceneConstPtr& planning_scene,
+                        const arm_navigation_msgs::GetMotionPlan::Request &req,
+                        arm_navigation_msgs::GetMotionPlan::Response &res,
+                        std::map<std::string, double> *stats)
+{
+  if(planners_.empty() || !planning_scene)
+    return false;
+
+  std::vector<PlannerConfiguration> portfolio;
+  bool first_solution;
+  {
+    boost::mutex::scoped_lock lock(idle_mutex_);
+    portfolio = portfolio_;
+    first_solution = portfolio_first_solution_;
+  }
+  if(!portfolio.empty())
+    return solvePortfolio(portfolio, first_solution, planning_scene, req, res, stats);
+
+  ros::WallTime t_wait = ros::WallTime::now();
+  int id = acquirePlanner();
+  double wait_time = (ros::WallTime::now() - t_wait).toSec();
+
+  double preprocess_time = 0;
+  if(!lockScene(std::vector<int>(1,id), planning_scene, preprocess_time))
+  {
+    releasePlanner(id);
+    return false;
+  }
+
+  res.robot_state = planning_scene->robot_state;
+  bool b_ret = planners_[id]->planKinematicPath(req, res);
+
+  if(stats)
+  {
+    *stats = planners_[id]->getPlannerStats();
+    (*stats)["pool planner id"] = id;
+    (*stats)["pool wait time"] = wait_time;
+    (*stats)["pool preprocess time"] = preprocess_time;
+  }
+  scene_mutex_.unlock_shared();
+
+  releasePlanner(id);
+  ROS_DEBUG("[pool] Planner %d finished (success: %d, waited: %0.3fsec)", id, b_ret, wait_time);
+  return b_ret;
+}
+
+bool PlannerPool::solveBatch(const arm_navigation_msgs::PlanningSceneConstPtr& planning_scene,
+                             const std::vector<arm_navigation_msgs::GetMotionPlan::Request> &reqs,
+                             std::vector<BatchPlanningResult> &results)
+{
+  results.clear();
+  if(planners_.empty() || !planning_scene || reqs.empty())
+    return false;
+
+  results.resize(reqs.size());
+  for(size_t i = 0; i < results.size(); ++i)
+  {
+    results[i].success = false;
+    results[i].cost = 0;
+    results[i].planning_time = 0;
+    results[i].planner_id = -1;
+  }
+
+  // group the goals by the grid cell they fall in
+  std::map<std::vector<int>, std::vector<int> > cells;
+  for(size_t i = 0; i < reqs.size(); ++i)
+  {
+    std::vector<int> cell(3,-1);
+    if(!reqs[i].motion_plan_request.goal_constraints.position_constraints.empty())
+    {
+      const geometry_msgs::Point &p = reqs[i].motion_plan_request.goal_constraints.position_constraints[0].position;
+      df_->worldToGrid(p.x, p.y, p.z, cell[0], cell[1], cell[2]);
+    }
+    cells[cell].push_back(i);
+  }
+
+  // block for one planner, then take whatever else is idle
+  std::vector<int> ids(1, acquirePlanner());
+  int id;
+  while(ids.size() < cells.size() && (id = tryAcquirePlanner()) >= 0)
+    ids.push_back(id);
+
+  double preprocess_time = 0;
+  if(!lockScene(ids, planning_scene, preprocess_time))
+  {
+    for(size_t i = 0; i < ids.size(); ++i)
+      releasePlanner(ids[i]);
+    return false;
+  }
+
+  // hand out the largest groups first to the least loaded planner
+  std::vector<std::pair<int, std::vector<int> > > groups;
+  for(std::map<std::vector<int>, std::vector<int> >::iterator it = cells.begin(); it != cells.end(); ++it)
+    groups.push_back(std::make_pair(-int(it->second.size()), it->second));
+  std::sort(groups.begin(), groups.end());
+
+  std::vector<std::vector<int> > assigned(ids.size());
+  for(size_t i = 0; i < groups.size(); ++i)
+  {
+    size_t k = 0;
+    for(size_t j = 1; j < assigned.size(); ++j)
+    {
+      if(assigned[j].size() < assigned[k].size())
+        k = j;
+    }
+    assigned[k].insert(assigned[k].end(), groups[i].second.begin(), groups[i].second.end());
+  }
+
+  ros::WallTime t_batch = ros::WallTime::now();
+  boost::thread_group threads;
+  for(size_t i = 0; i < ids.size(); ++i)
+  {
+    if(!assigned[i].empty())
+      threads.create_thread(boost::bind(&PlannerPool::planBatch, this, ids[i], assigned[i], &reqs, planning_scene, &results));
+  }
+  threads.join_all();
+  scene_mutex_.unlock_shared();
+
+  for(size_t i = 0; i < ids.size(); ++i)
+    releasePlanner(ids[i]);
+
+  int num_solved = 0;
+  for(size_t i = 0; i < results.size(); ++i)
+  {
+    if(results[i].success)
+      num_solved++;
+  }
+  ROS_INFO("[pool] Batch of %d goals (%d cells) on %d planners: %d solved in %0.3fsec (preprocess: %0.3fsec)", int(reqs.size()), int(cells.size()), int(ids.size()), num_solved, (ros::WallTime::now() - t_batch).toSec(), preprocess_time);
+  return num_solved > 0;
+}
+
+void PlannerPool::planBatch(int id, const std::vector<int> &req_ids,
+                            const std::vector<arm_navigation_msgs::GetMotionPlan::Request> *reqs,
+                            arm_navigation_msgs::PlanningSceneConstPtr planning_scene,
+                            std::vector<BatchPlanningResult> *results)
+{
+  for(size_t i = 0; i < req_ids.size(); ++i)
+  {
+    BatchPlanningResult &r = (*results)[req_ids[i]];
+    arm_navigation_msgs::GetMotionPlan::Response res;
+    res.robot_state = planning_scene->robot_state;
+
+    ros::WallTime t_plan = ros::WallTime::now();
+    r.success = planners_[id]->planKinematicPath((*reqs)[req_ids[i]], res);
+    r.planning_time = (ros::WallTime::now() - t_plan).toSec();
+    r.planner_id = id;
+    r.stats = planners_[id]->getPlannerStats();
+    r.cost = r.stats["solution cost"];
+    if(r.success)
+      r.trajectory = res.trajectory.joint_trajectory;
+  }
+}
+
+
+void PlannerPool::setPortfolio(const std::vector<PlannerConfiguration> &configs, bool first_solution)
+{
+  boost::mutex::scoped_lock lock(idle_mutex_);
+  portfolio_ = configs;
+  portfolio_first_solution_ = first_solution;
+  if(configs.size() > planners_.size())
+    ROS_WARN("[pool] The portfolio has %d configurations but there are only %d planners. Only the first %d will be used.", int(configs.size()), int(planners_.size()), int(planners_.size()));
+}
+
+bool PlannerPool::solvePortfolio(const std::vector<PlannerConfiguration> &portfolio, bool first_solution,
+                                 const arm_navigation_msgs::PlanningSceneConstPtr& planning_scene,
+                                 const arm_navigation_msgs::GetMotionPlan::Request &req,
+                                 arm_navigation_msgs::GetMotionPlan::Response &res,
+                                 std::map<std::string, double> *stats)
+{
+  // block for one planner, then take whatever else is idle
+  ros::WallTime t_wait = ros::WallTime::now();
+  std::vector<int> ids(1, acquirePlanner());
+  int id;
+  while(ids.size() < portfolio.size() && (id = tryAcquirePlanner()) >= 0)
+    ids.push_back(id);
+  double wait_time = (ros::WallTime::now() - t_wait).toSec();
+
+  double preprocess_time = 0;
+  if(!lockScene(ids, planning_scene, preprocess_time))
+  {
+    for(size_t i = 0; i < ids.size(); ++i)
+      releasePlanner(ids[i]);
+    return false;
+  }
+
+  volatile bool cancel = false;
+  int winner = -1;
+  boost::mutex winner_mutex;
+  std::vector<BatchPlanningResult> results(ids.size());
+
+  ros::WallTime t_race = ros::WallTime::now();
+  boost::thread_group threads;
+  for(size_t i = 0; i < ids.size(); ++i)
+  {
+    results[i].success = false;
+    results[i].cost = 0;
+    results[i].planner_id = ids[i];
+    // a racer that keeps improving its solution would only finish at the time limit
+    PlannerConfiguration config = portfolio[i];
+    if(first_solution)
+      config.first_solution = true;
+    planners_[ids[i]]->setConfiguration(config);
+    planners_[ids[i]]->setCancelFlag(&cancel);
+    threads.create_thread(boost::bind(&PlannerPool::planPortfolio, this, int(i), ids[i], first_solution, &req, planning_scene, &results[i], &cancel, &winner, &winner_mutex));
+  }
+  threads.join_all();
+  scene_mutex_.unlock_shared();
+
+  // without first_solution, take the cheapest
+  if(!first_solution)
+  {
+    for(size_t i = 0; i < results.size(); ++i)
+    {
+      if(results[i].success && (winner < 0 || results[i].cost < results[winner].cost))
+        winner = i;
+    }
+  }
+
+  for(size_t i = 0; i < ids.size(); ++i)
+  {
+    planners_[ids[i]]->setCancelFlag(NULL);
+    planners_[ids[i]]->setConfiguration(default_configs_[ids[i]]);
+    releasePlanner(ids[i]);
+  }
+
+  if(winner >= 0)
+  {
+    res.robot_state = planning_scene->robot_state;
+    res.trajectory.joint_trajectory = results[winner].trajectory;
+    res.planning_time = ros::Duration((ros::WallTime::now() - t_race).toSec());
+  }
+
+  if(stats)
+  {
+    *stats = (winner >= 0) ? results[winner].stats : results[0].stats;
+    (*stats)["pool planner id"] = (winner >= 0) ? ids[winner] : -1;
+    (*stats)["pool wait time"] = wait_time;
+    (*stats)["pool preprocess time"] = preprocess_time;
+    (*stats)["portfolio size"] = ids.size();
+    (*stats)["portfolio winner"] = winner;
+    (*stats)["portfolio time"] = (ros::WallTime::now() - t_race).toSec();
+  }
+
+  ROS_INFO("[pool] Portfolio of %d planners finished in %0.3fsec. (winner: config %d)", int(ids.size()), (ros::WallTime::now() - t_race).toSec(), winner);
+  return winner >= 0;
+}
+
+void PlannerPool::planPortfolio(int index, int id, bool first_solution, const arm_navigation_msgs::GetMotionPlan::Request *req,
+                                arm_navigation_msgs::PlanningSceneConstPtr planning_scene,
+                                BatchPlanningResult *result, volatile bool *cancel,
+                                int *winner, boost::mutex *winner_mutex)
+{
+  arm_navigation_msgs::GetMotionPlan::Response res;
+  res.robot_state = planning_scene->robot_state;
+
+  ros::WallTime t_plan = ros::WallTime::now();
+  bool b_ret = planners_[id]->planKinematicPath(*req, res);
+  result->planning_time = (ros::WallTime::now() - t_plan).toSec();
+  result->stats = planners_[id]->getPlannerStats();
+  result->cost = result->stats["solution cost"];
+  if(b_ret)
+    result->trajectory = res.trajectory.joint_trajectory;
+
+  if(!first_solution || !b_ret)
+  {
+    result->success = b_ret;
+    return;
+  }
+
+  // the first one to finish wins & the others are cancelled
+  boost::mutex::scoped_lock lock(*winner_mutex);
+  if(*winner < 0 && !*cancel)
+  {
+    result->success = true;
+    *winner = index;
+    *cancel = true;
+  }
+}
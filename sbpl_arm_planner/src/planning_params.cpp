@@ -33,13 +33,159 @@
  
 namespace sbpl_arm_planner {
 
+namespace {
+
+/* Reads parameters out of an XML-RPC struct the way a NodeHandle reads them
+ * off the parameter server, so init() doesn't need a master to run. */
+class XmlRpcParams
+{
+  public:
+    XmlRpcParams(const XmlRpc::XmlRpcValue &params) : params_(params) {}
+
+    bool hasParam(const std::string &name)
+    {
+      return find(name) != NULL;
+    }
+
+    bool getParam(const std::string &name, XmlRpc::XmlRpcValue &v)
+    {
+      XmlRpc::XmlRpcValue *p = find(name);
+      if(p == NULL)
+        return false;
+      v = *p;
+      return true;
+    }
+
+    bool getParam(const std::string &name, std::string &v)
+    {
+      XmlRpc::XmlRpcValue *p = find(name);
+      if(p == NULL || p->getType() != XmlRpc::XmlRpcValue::TypeString)
+        return false;
+      v = std::string(*p);
+      return true;
+    }
+
+    bool getParam(const std::string &name, double &v)
+    {
+      XmlRpc::XmlRpcValue *p = find(name);
+      if(p == NULL)
+        return false;
+      if(p->getType() == XmlRpc::XmlRpcValue::TypeDouble)
+        v = double(*p);
+      else if(p->getType() == XmlRpc::XmlRpcValue::TypeInt)
+        v = int(*p);
+      else
+        return false;
+      return true;
+    }
+
+    bool getParam(const std::string &name, int &v)
+    {
+      XmlRpc::XmlRpcValue *p = find(name);
+      if(p == NULL || p->getType() != XmlRpc::XmlRpcValue::TypeInt)
+        return false;
+      v = int(*p);
+      return true;
+    }
+
+    bool getParam(const std::string &name, bool &v)
+    {
+      XmlRpc::XmlRpcValue *p = find(name);
+      if(p == NULL || p->getType() != XmlRpc::XmlRpcValue::TypeBoolean)
+        return false;
+      v = bool(*p);
+      return true;
+    }
+
+    template <typename T>
+    bool param(const std::string &name, T &v, const T &default_val)
+    {
+      if(getParam(name, v))
+        return true;
+      v = default_val;
+      return false;
+    }
+
+  private:
+    XmlRpc::XmlRpcValue params_;
+
+    XmlRpc::XmlRpcValue* find(const std::string &name)
+    {
+      std::vector<std::string> keys;
+      boost::split(keys, name, boost::is_any_of("/"));
+      XmlRpc::XmlRpcValue *p = &params_;
+      for(size_t i = 0; i < keys.size(); ++i)
+      {
+        if(p->getType() != XmlRpc::XmlRpcValue::TypeStruct || !p->hasMember(keys[i]))
+          return NULL;
+        p = &(*p)[keys[i]];
+      }
+      return p;
+    }
+};
+
+}
+
 PlanningParams::PlanningParams()
 {
   allowed_time_ = 10.0;
   epsilon_ = 10;
   use_bfs_heuristic_ = true;
   ready_to_plan_ = false;
+  search_backward_ = false;
+  num_goal_ik_seeds_ = 10;
+  start_snap_dist_m_ = 0.2;
+  use_experience_graph_ = false;
+  egraph_epsilon_ = 5.0;
+  egraph_max_nodes_ = 10000;
+  repair_start_ = true;
+  start_repair_iterations_ = 20;
+  start_repair_max_step_ = 0.05;
+  start_repair_clearance_ = 0.02;
+  goal_check_ = false;
+  goal_check_ik_seeds_ = 10;
+  goal_check_timeout_ = 0.05;
+  goal_check_max_snap_dist_ = 0.5;
+  use_swept_volume_ = false;
+  swept_volume_clearance_ = 0.02;
+  reachability_reject_orientation_ = false;
+  reachability_orientation_tolerance_ = 0.5;
+  defer_primitives_ = false;
+  mprim_stats_block_size_ = 8;
+  mprim_stats_min_failures_ = 20;
+  mprim_stats_max_success_rate_ = 0.05;
+  mprim_stats_retry_every_ = 16;
+  use_coarse_lattice_ = false;
+  coarse_lattice_factor_ = 2;
+  coarse_lattice_goal_dist_m_ = 0.4;
+  coarse_lattice_clearance_m_ = 0.15;
+  use_bfs_path_mprim_ = false;
+  bfs_path_lookahead_ = 8;
+  bfs_path_iterations_ = 5;
+  bfs_path_max_step_ = 0.1;
+  bfs_path_damping_ = 0.05;
+  num_search_threads_ = 1;
+  use_pase_ = false;
+  pase_epsilon_ = 2.0;
+  pase_max_candidates_ = 16;
+  use_hda_ = false;
+  use_prefix_commit_ = false;
+  prefix_commit_waypoints_ = 8;
+  prefix_commit_refine_fraction_ = 0.5;
+
+  schedule_.first_solution_time = 0.0;
+  schedule_.retry_eps_factor = 2.0;
+  schedule_.initial_eps = 100.0;
+  schedule_.final_eps = 1.0;
+  schedule_.eps_step = 0.2;
+  schedule_.eps_decrease_ratio = 0.0;
+  schedule_.min_improvement_rate = 0.0;
+  schedule_.patience = 2;
+  schedule_.iteration_growth = 0.0;
 
+  use_perf_counters_ = false;
+  trace_latency_threshold_ = 0.0;
+  trace_buffer_size_ = 1 << 18;
   verbose_ = false;
   verbose_heuristics_ = false;
   verbose_collisions_ = false;
@@ -70,6 +216,18 @@ PlanningParams::PlanningParams()
 bool PlanningParams::init()
 {
   ros::NodeHandle nh("~");
+  XmlRpc::XmlRpcValue params;
+  if(!ros::param::get(nh.getNamespace(), params))
+  {
+    ROS_ERROR("Failed to get the parameters in '%s'.", nh.getNamespace().c_str());
+    return false;
+  }
+  return init(params);
+}
+
+bool PlanningParams::init(const XmlRpc::XmlRpcValue &params)
+{
+  XmlRpcParams nh(params);
 
   /* planning */
   nh.param("planning/epsilon", epsilon_, 10.0);
@@ -83,8 +241,114 @@ bool PlanningParams::init()
   nh.param<std::string>("planning/planning_frame",planning_frame_,"");
   nh.param<std::string>("planning/group_name",group_name_,"");
 
+  /* anytime search schedule */
+  nh.param("planning/schedule/first_solution_time", schedule_.first_solution_time, 0.0);
+  nh.param("planning/schedule/retry_epsilon_factor", schedule_.retry_eps_factor, 2.0);
+  nh.param("planning/schedule/initial_epsilon", schedule_.initial_eps, epsilon_);
+  nh.param("planning/schedule/final_epsilon", schedule_.final_eps, 1.0);
+  nh.param("planning/schedule/epsilon_step", schedule_.eps_step, 0.2);
+  nh.param("planning/schedule/epsilon_decrease_ratio", schedule_.eps_decrease_ratio, 0.0);
+  nh.param("planning/schedule/min_improvement_rate", schedule_.min_improvement_rate, 0.0);
+  nh.param("planning/schedule/patience", schedule_.patience, 2);
+  nh.param("planning/schedule/iteration_growth", schedule_.iteration_growth, 0.0);
+
+  /* search direction */
+  std::string search_direction;
+  nh.param<std::string>("planning/search_direction", search_direction, "forward");
+  search_backward_ = (search_direction.compare("backward") == 0);
+  if(!search_backward_ && search_direction.compare("forward") != 0)
+    ROS_WARN("Search direction '%s' isn't supported. Searching forward.", search_direction.c_str());
+  nh.param("planning/backward_search/ik_seeds", num_goal_ik_seeds_, 10);
+  nh.param("planning/backward_search/start_snap_distance", start_snap_dist_m_, 0.2);
+
+  /* experience graph */
+  nh.param("planning/experience_graph/use", use_experience_graph_, false);
+  nh.param("planning/experience_graph/epsilon", egraph_epsilon_, 5.0);
+  nh.param<std::string>("planning/experience_graph/file", egraph_file_, "");
+  nh.param("planning/experience_graph/max_nodes", egraph_max_nodes_, 10000);
+
+  /* start repair */
+  nh.param("planning/start_repair/use", repair_start_, true);
+  nh.param("planning/start_repair/iterations", start_repair_iterations_, 20);
+  nh.param("planning/start_repair/max_step", start_repair_max_step_, 0.05);
+  nh.param("planning/start_repair/clearance", start_repair_clearance_, 0.02);
+
+  /* goal feasibility check */
+  nh.param("planning/goal_check/use", goal_check_, false);
+  nh.param("planning/goal_check/ik_seeds", goal_check_ik_seeds_, 10);
+  nh.param("planning/goal_check/timeout", goal_check_timeout_, 0.05);
+  nh.param("planning/goal_check/max_snap_distance", goal_check_max_snap_dist_, 0.5);
+
+  /* reachability map */
+  nh.param<std::string>("planning/reachability/file", reachability_file_, "");
+  nh.param("planning/reachability/reject_orientation", reachability_reject_orientation_, false);
+  nh.param("planning/reachability/orientation_tolerance", reachability_orientation_tolerance_, 0.5);
+
+  /* swept volume of the trajectory */
+  nh.param("planning/swept_volume/use", use_swept_volume_, false);
+  nh.param("planning/swept_volume/clearance", swept_volume_clearance_, 0.02);
+
+  /* primitive statistics */
+  nh.param("planning/primitive_stats/defer", defer_primitives_, false);
+  nh.param("planning/primitive_stats/block_size", mprim_stats_block_size_, 8);
+  nh.param("planning/primitive_stats/min_failures", mprim_stats_min_failures_, 20);
+  nh.param("planning/primitive_stats/max_success_rate", mprim_stats_max_success_rate_, 0.05);
+  nh.param("planning/primitive_stats/retry_every", mprim_stats_retry_every_, 16);
+
+  /* coarse lattice */
+  nh.param("planning/coarse_lattice/use", use_coarse_lattice_, false);
+  nh.param("planning/coarse_lattice/factor", coarse_lattice_factor_, 2);
+  nh.param("planning/coarse_lattice/min_goal_distance", coarse_lattice_goal_dist_m_, 0.4);
+  nh.param("planning/coarse_lattice/min_clearance", coarse_lattice_clearance_m_, 0.15);
+  if(use_coarse_lattice_ && coarse_lattice_factor_ < 2)
+  {
+    ROS_WARN("The coarse lattice factor has to be at least 2. Not using the coarse lattice. (factor: %d)", coarse_lattice_factor_);
+    use_coarse_lattice_ = false;
+  }
+
+  /* bfs path primitive */
+  nh.param("planning/bfs_path_primitive/use", use_bfs_path_mprim_, false);
+  nh.param("planning/bfs_path_primitive/lookahead", bfs_path_lookahead_, 8);
+  nh.param("planning/bfs_path_primitive/iterations", bfs_path_iterations_, 5);
+  nh.param("planning/bfs_path_primitive/max_step", bfs_path_max_step_, 0.1);
+  nh.param("planning/bfs_path_primitive/damping", bfs_path_damping_, 0.05);
+  if(use_bfs_path_mprim_ && !use_bfs_heuristic_)
+  {
+    ROS_WARN("The bfs path primitive needs the bfs heuristic. Not using it.");
+    use_bfs_path_mprim_ = false;
+  }
+
+  /* parallel search */
+  nh.param("planning/search_threads", num_search_threads_, 1);
+  nh.param("planning/pase/use", use_pase_, false);
+  nh.param("planning/pase/epsilon", pase_epsilon_, 2.0);
+  nh.param("planning/pase/max_candidates", pase_max_candidates_, 16);
+  nh.param("planning/hda/use", use_hda_, false);
+
+  /* streaming the start of the first solution */
+  nh.param("planning/prefix_commit/use", use_prefix_commit_, false);
+  nh.param("planning/prefix_commit/waypoints", prefix_commit_waypoints_, 8);
+  nh.param("planning/prefix_commit/refine_fraction", prefix_commit_refine_fraction_, 0.5);
+  if(use_prefix_commit_ && prefix_commit_waypoints_ < 1)
+  {
+    ROS_WARN("The committed prefix needs at least 1 waypoint. Not committing a prefix.");
+    use_prefix_commit_ = false;
+  }
+  if(use_prefix_commit_ && search_backward_)
+  {
+    ROS_WARN("The prefix can't be committed in the backward search. Not committing a prefix.");
+    use_prefix_commit_ = false;
+  }
+
   /* logging */
   nh.param ("debug/print_out_path", print_path_, true);
+  nh.param<std::string>("debug/stats/file", stats_file_, "");
+  nh.param<std::string>("debug/stats/format", stats_format_, "csv");
+  nh.param<std::string>("debug/record_requests_dir", record_dir_, "");
+  nh.param("debug/stats/perf_counters", use_perf_counters_, false);
+  nh.param<std::string>("debug/trace/dir", trace_dir_, "");
+  nh.param("debug/trace/latency_threshold", trace_latency_threshold_, 0.0);
+  nh.param("debug/trace/buffer_size", trace_buffer_size_, 1 << 18);
   nh.param<std::string>("debug/logging/expands", expands_log_level_, "info");
   nh.param<std::string>("debug/logging/expands2", expands2_log_level_, "info");
   nh.param<std::string>("debug/logging/ik", ik_log_level_, "info");
@@ -144,8 +408,57 @@ void PlanningParams::printParams(std::string stream)
   ROS_INFO_NAMED(stream,"%40s: %.2f", "epsilon",epsilon_);
   ROS_INFO_NAMED(stream,"%40s: %s", "use dijkstra heuristic", use_bfs_heuristic_ ? "yes" : "no");
   ROS_INFO_NAMED(stream,"%40s: %s", "sbpl search mode", search_mode_ ? "stop_after_first_sol" : "run_until_timeout");
+  ROS_INFO_NAMED(stream,"%40s: %0.3fsec  (retry epsilon factor: %0.2f)", "schedule: first solution target", schedule_.first_solution_time, schedule_.retry_eps_factor);
+  ROS_INFO_NAMED(stream,"%40s: %0.2f -> %0.2f (step: %0.2f ratio: %0.2f)", "schedule: epsilon", schedule_.initial_eps, schedule_.final_eps, schedule_.eps_step, schedule_.eps_decrease_ratio);
+  ROS_INFO_NAMED(stream,"%40s: %0.3f/sec (patience: %d)", "schedule: min improvement rate", schedule_.min_improvement_rate, schedule_.patience);
+  ROS_INFO_NAMED(stream,"%40s: %0.2f", "schedule: iteration growth", schedule_.iteration_growth);
+  ROS_INFO_NAMED(stream,"%40s: %s", "search direction", search_backward_ ? "backward" : "forward");
+  if(search_backward_)
+    ROS_INFO_NAMED(stream,"%40s: %d seeds  (start snap: %0.3fm)", "goal ik solutions", num_goal_ik_seeds_, start_snap_dist_m_);
+  ROS_INFO_NAMED(stream,"%40s: %s", "use experience graph", use_experience_graph_ ? "yes" : "no");
+  if(use_experience_graph_)
+  {
+    ROS_INFO_NAMED(stream,"%40s: %0.2f", "experience graph epsilon", egraph_epsilon_);
+    ROS_INFO_NAMED(stream,"%40s: %s", "experience graph file", egraph_file_.c_str());
+    ROS_INFO_NAMED(stream,"%40s: %d", "experience graph max nodes", egraph_max_nodes_);
+  }
+  ROS_INFO_NAMED(stream,"%40s: %s", "repair colliding start", repair_start_ ? "yes" : "no");
+  if(repair_start_)
+    ROS_INFO_NAMED(stream,"%40s: %d  (max step: %0.3frad  clearance: %0.3fm)", "start repair iterations", start_repair_iterations_, start_repair_max_step_, start_repair_clearance_);
+  ROS_INFO_NAMED(stream,"%40s: %s", "goal feasibility check", goal_check_ ? "yes" : "no");
+  if(goal_check_)
+  {
+    ROS_INFO_NAMED(stream,"%40s: %d seeds  (timeout: %0.3fsec)", "goal check ik solutions", goal_check_ik_seeds_, goal_check_timeout_);
+    ROS_INFO_NAMED(stream,"%40s: %0.3frad", "goal check max snap distance", goal_check_max_snap_dist_);
+  }
+  ROS_INFO_NAMED(stream,"%40s: %s", "reachability map", reachability_file_.empty() ? "none" : reachability_file_.c_str());
+  if(!reachability_file_.empty())
+    ROS_INFO_NAMED(stream,"%40s: %s  (tolerance: %0.2frad)", "reachability: reject orientation", reachability_reject_orientation_ ? "yes" : "no", reachability_orientation_tolerance_);
+  ROS_INFO_NAMED(stream,"%40s: %s", "swept volume", use_swept_volume_ ? "yes" : "no");
+  if(use_swept_volume_)
+    ROS_INFO_NAMED(stream,"%40s: %0.3fm", "swept volume clearance", swept_volume_clearance_);
+  ROS_INFO_NAMED(stream,"%40s: %s", "defer failing primitives", defer_primitives_ ? "yes" : "no");
+  if(defer_primitives_)
+    ROS_INFO_NAMED(stream,"%40s: %d cells  (min failures: %d  max success rate: %0.2f  retry every: %d)", "primitive stats block", mprim_stats_block_size_, mprim_stats_min_failures_, mprim_stats_max_success_rate_, mprim_stats_retry_every_);
+  ROS_INFO_NAMED(stream,"%40s: %s", "coarse lattice", use_coarse_lattice_ ? "yes" : "no");
+  if(use_coarse_lattice_)
+    ROS_INFO_NAMED(stream,"%40s: %d  (min goal distance: %0.3fm  min clearance: %0.3fm)", "coarse lattice factor", coarse_lattice_factor_, coarse_lattice_goal_dist_m_, coarse_lattice_clearance_m_);
+  ROS_INFO_NAMED(stream,"%40s: %s", "bfs path primitive", use_bfs_path_mprim_ ? "yes" : "no");
+  if(use_bfs_path_mprim_)
+    ROS_INFO_NAMED(stream,"%40s: %d cells  (iterations: %d  max step: %0.3frad  damping: %0.3f)", "bfs path lookahead", bfs_path_lookahead_, bfs_path_iterations_, bfs_path_max_step_, bfs_path_damping_);
+  ROS_INFO_NAMED(stream,"%40s: %d", "search threads", num_search_threads_);
+  ROS_INFO_NAMED(stream,"%40s: %s", "parallel search (pa*se)", use_pase_ ? "yes" : "no");
+  if(use_pase_)
+    ROS_INFO_NAMED(stream,"%40s: %0.2f  (max candidates: %d)", "pa*se epsilon", pase_epsilon_, pase_max_candidates_);
+  ROS_INFO_NAMED(stream,"%40s: %s", "parallel search (hda*)", use_hda_ ? "yes" : "no");
+  ROS_INFO_NAMED(stream,"%40s: %s", "prefix commit", use_prefix_commit_ ? "yes" : "no");
+  if(use_prefix_commit_)
+    ROS_INFO_NAMED(stream,"%40s: %d  (refine fraction: %0.2f)", "prefix commit waypoints", prefix_commit_waypoints_, prefix_commit_refine_fraction_);
   ROS_INFO_NAMED(stream,"%40s: %s", "postprocessing: shortcut", shortcut_path_ ? "yes" : "no");
   ROS_INFO_NAMED(stream,"%40s: %s", "postprocessing: interpolate", interpolate_path_ ? "yes" : "no");
+  ROS_INFO_NAMED(stream,"%40s: %s", "stats: perf counters", use_perf_counters_ ? "yes" : "no");
+  if(!trace_dir_.empty())
+    ROS_INFO_NAMED(stream,"%40s: %s (requests over %0.3fsec)", "trace dir", trace_dir_.c_str(), trace_latency_threshold_);
   ROS_INFO_NAMED(stream,"%40s: %0.3fsec", "time_per_waypoint", waypoint_time_);
   
   ROS_INFO_NAMED(stream,"%40s: %d", "cost per cell", cost_per_cell_);
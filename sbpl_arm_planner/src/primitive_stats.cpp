@@ -0,0 +1,94 @@
+/** \author Benjamin Cohen */
+
+#include <sbpl_arm_planner/primitive_stats.h>
+#include <string.h>
+
+using namespace sbpl_arm_planner;
+
+PrimitiveStats::PrimitiveStats() : block_size_(1), num_mprims_(0), min_failures_(20), max_success_rate_(0.05), retry_every_(16)
+{
+  for(int i = 0; i < 3; ++i)
+  {
+    dims_[i] = 0;
+    num_blocks_[i] = 0;
+  }
+  resetStats();
+}
+
+void PrimitiveStats::init(int dim_x, int dim_y, int dim_z, int block_size, int num_mprims)
+{
+  dims_[0] = dim_x;
+  dims_[1] = dim_y;
+  dims_[2] = dim_z;
+  block_size_ = block_size > 0 ? block_size : 1;
+  for(int i = 0; i < 3; ++i)
+    num_blocks_[i] = (dims_[i] + block_size_ - 1) / block_size_;
+  num_mprims_ = num_mprims;
+  entries_.resize(num_blocks_[0] * num_blocks_[1] * num_blocks_[2] * num_mprims_);
+  reset();
+}
+
+void PrimitiveStats::setDeferral(int min_failures, double max_success_rate, int retry_every)
+{
+  min_failures_ = min_failures;
+  max_success_rate_ = max_success_rate;
+  retry_every_ = retry_every > 0 ? retry_every : 1;
+}
+
+void PrimitiveStats::reset()
+{
+  if(!entries_.empty())
+    memset(&entries_[0], 0, entries_.size() * sizeof(Entry));
+}
+
+int PrimitiveStats::getBlock(int x, int y, int z)
+{
+  if(x < 0 || y < 0 || z < 0 || x >= dims_[0] || y >= dims_[1] || z >= dims_[2])
+    return -1;
+  return ((z / block_size_) * num_blocks_[1] + (y / block_size_)) * num_blocks_[0] + (x / block_size_);
+}
+
+bool PrimitiveStats::isDeferred(int block, int mprim)
+{
+  if(block < 0 || mprim < 0 || mprim >= num_mprims_)
+    return false;
+
+  Entry &e = entries_[block * num_mprims_ + mprim];
+  if(e.failures < min_failures_ || (e.tries - e.failures) > max_success_rate_ * e.tries)
+    return false;
+
+  if(++e.deferred % retry_every_ == 0)
+    return false;
+  num_deferred_++;
+  return true;
+}
+
+void PrimitiveStats::update(int block, int mprim, bool valid)
+{
+  num_evaluated_++;
+  if(valid)
+    num_valid_++;
+
+  if(block < 0 || mprim < 0 || mprim >= num_mprims_)
+    return;
+
+  Entry &e = entries_[block * num_mprims_ + mprim];
+  e.tries++;
+  if(!valid)
+    e.failures++;
+}
+
+void PrimitiveStats::getStats(std::map<std::string, double> &stats)
+{
+  stats["primitives evaluated"] = num_evaluated_;
+  stats["primitives deferred"] = num_deferred_;
+  stats["primitive success rate"] = num_evaluated_ > 0 ? double(num_valid_) / num_evaluated_ : 0.0;
+}
+
+void PrimitiveStats::resetStats()
+{
+  num_evaluated_ = 0;
+  num_valid_ = 0;
+  num_deferred_ = 0;
+}
+
@@ -0,0 +1,121 @@
+/** \author Benjamin Cohen */
+
+#include <sbpl_arm_planner/request_recorder.h>
+#include <rosbag/bag.h>
+#include <std_msgs/String.h>
+#include <std_msgs/UInt32.h>
+#include <boost/crc.hpp>
+#include <fstream>
+#include <sstream>
+
+using namespace sbpl_arm_planner;
+
+RequestRecorder::RequestRecorder() : count_(0)
+{
+}
+
+bool RequestRecorder::init(std::string directory, std::string param_ns, std::string action_file)
+{
+  if(directory.empty())
+    return false;
+
+  directory_ = directory;
+  param_ns_ = param_ns;
+  action_file_ = action_file;
+  ROS_INFO("[recorder] Recording planning requests to '%s'.", directory_.c_str());
+  return true;
+}
+
+std::string RequestRecorder::record(const arm_navigation_msgs::PlanningScene &scene, const arm_navigation_msgs::GetMotionPlan::Request &req, const std::map<std::string, double> &stats)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+
+  std::stringstream filename;
+  filename << directory_ << "/request_" << ros::WallTime::now().sec << "_" << count_++ << ".bag";
+
+  // messages in a bag need a time, it isn't used for anything else
+  ros::Time t = ros::Time::now();
+  if(t.isZero())
+    t = ros::TIME_MIN;
+
+  try
+  {
+    rosbag::Bag bag(filename.str(), rosbag::bagmode::Write);
+
+    bag.write(RECORD_SCENE_TOPIC, t, scene);
+    bag.write(RECORD_REQUEST_TOPIC, t, req.motion_plan_request);
+
+    std_msgs::String str;
+    ros::param::get("robot_description", str.data);
+    bag.write(RECORD_ROBOT_DESCRIPTION_TOPIC, t, str);
+
+    XmlRpc::XmlRpcValue params;
+    if(ros::param::get(param_ns_, params))
+      str.data = params.toXml();
+    else
+    {
+      ROS_WARN("[recorder] Failed to get the parameters in '%s'.", param_ns_.c_str());
+      str.data = "";
+    }
+    bag.write(RECORD_PARAMS_TOPIC, t, str);
+
+    std_msgs::UInt32 crc;
+    crc.data = getFileChecksum(action_file_, str.data);
+    bag.write(RECORD_ACTION_SET_TOPIC, t, str);
+    bag.write(RECORD_ACTION_SET_HASH_TOPIC, t, crc);
+
+    str.data = statsToString(stats);
+    bag.write(RECORD_STATS_TOPIC, t, str);
+    bag.close();
+  }
+  catch(rosbag::BagException &e)
+  {
+    ROS_ERROR("[recorder] Failed to record the request to '%s': %s", filename.str().c_str(), e.what());
+    return "";
+  }
+
+  ROS_INFO("[recorder] Recorded the request to '%s'.", filename.str().c_str());
+  return filename.str();
+}
+
+unsigned int RequestRecorder::getFileChecksum(std::string filename, std::string &contents)
+{
+  std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+  if(!file.is_open())
+  {
+    contents = "";
+    return 0;
+  }
+  std::stringstream ss;
+  ss << file.rdbuf();
+  contents = ss.str();
+
+  boost::crc_32_type crc;
+  crc.process_bytes(contents.data(), contents.size());
+  return crc.checksum();
+}
+
+std::string RequestRecorder::statsToString(const std::map<std::string, double> &stats)
+{
+  std::stringstream ss;
+  ss.precision(9);
+  for(std::map<std::string, double>::const_iterator it = stats.begin(); it != stats.end(); ++it)
+    ss << it->first << ": " << it->second << std::endl;
+  return ss.str();
+}
+
+std::map<std::string, double> RequestRecorder::stringToStats(const std::string &str)
+{
+  std::map<std::string, double> stats;
+  std::stringstream ss(str);
+  std::string line;
+  while(std::getline(ss, line))
+  {
+    size_t i = line.rfind(": ");
+    if(i == std::string::npos)
+      continue;
+    stats[line.substr(0, i)] = atof(line.substr(i+2).c_str());
+  }
+  return stats;
+}
+
@@ -30,53 +30,171 @@
 
 #include <sbpl_arm_planner/sbpl_arm_planner_interface.h>
 #include <visualization_msgs/Marker.h>
-
-clock_t starttime;
+#include <boost/bind.hpp>
+#include <limits>
 
 using namespace sbpl_arm_planner;
 
 SBPLArmPlannerInterface::SBPLArmPlannerInterface(RobotModel *rm, CollisionChecker *cc, ActionSet* as, distance_field::PropagationDistanceField* df) : 
-  nh_("~"), planner_(NULL), sbpl_arm_env_(NULL), prm_(NULL)
+  nh_("~"), planner_(NULL), sbpl_arm_env_(NULL), prm_(NULL), stats_writer_(NULL), recorder_(NULL), perf_(NULL), egraph_(NULL), egraph_dirty_(false), rmap_(NULL), swept_volume_(NULL), swept_volume_time_(-1), cancel_(NULL), prefix_cost_(0), prefix_commit_time_(-1), use_pase_(false), use_hda_(false)
 {
   rm_ = rm;
   cc_ = cc;
   as_ = as;
   df_ = df;
   planner_initialized_ = false;
+  preprocess_time_ = 0;
+  set_start_time_ = 0;
+  set_goal_time_ = 0;
+  search_time_ = 0;
+  postprocess_time_ = 0;
+  planning_succeeded_ = false;
+  trace_start_ = 0;
 }
 
 SBPLArmPlannerInterface::~SBPLArmPlannerInterface()
 {
+  // the last paths may not have been saved yet
+  if(egraph_save_thread_.joinable())
+    egraph_save_thread_.join();
+  if(egraph_ != NULL && egraph_dirty_ && !egraph_->save(prm_->egraph_file_))
+    ROS_WARN("Failed to save the experience graph. (file: %s)", prm_->egraph_file_.c_str());
+
   if(planner_ != NULL)
     delete planner_;
   if(sbpl_arm_env_ != NULL)
     delete sbpl_arm_env_;
   if(prm_ != NULL)
     delete prm_;
+  if(stats_writer_ != NULL)
+    delete stats_writer_;
+  if(recorder_ != NULL)
+    delete recorder_;
+  if(perf_ != NULL)
+    delete perf_;
+  if(egraph_ != NULL)
+    delete egraph_;
+  if(rmap_ != NULL)
+    delete rmap_;
+  if(swept_volume_ != NULL)
+    delete swept_volume_;
 }
 
 bool SBPLArmPlannerInterface::init()
+{
+  prm_ = new sbpl_arm_planner::PlanningParams();
+  if(!prm_->init())
+    return false;
+  return initialize();
+}
+
+bool SBPLArmPlannerInterface::init(const XmlRpc::XmlRpcValue &params)
+{
+  prm_ = new sbpl_arm_planner::PlanningParams();
+  if(!prm_->init(params))
+    return false;
+  return initialize();
+}
+
+bool SBPLArmPlannerInterface::initialize()
 {
   if(!initializePlannerAndEnvironment())
     return false;
 
+  if(!prm_->stats_file_.empty())
+  {
+    stats_writer_ = new StatsWriter();
+    if(stats_writer_->open(prm_->stats_file_, prm_->stats_format_))
+      stats_callback_ = boost::bind(&StatsWriter::write, stats_writer_, _1);
+  }
+
+  if(!prm_->record_dir_.empty())
+  {
+    recorder_ = new RequestRecorder();
+    if(!recorder_->init(prm_->record_dir_, nh_.getNamespace(), as_->getActionFile()))
+    {
+      delete recorder_;
+      recorder_ = NULL;
+    }
+  }
+
+  if(prm_->use_perf_counters_)
+    perf_ = new PerfCounters();
+
+  if(!prm_->trace_dir_.empty())
+  {
+    Tracer::setBufferSize(prm_->trace_buffer_size_);
+    Tracer::setEnabled(true);
+  }
+
+  if(prm_->use_experience_graph_)
+  {
+    // waypoints in the same lattice cell are one node
+    egraph_ = new ExperienceGraph();
+    egraph_->setResolution(prm_->coord_delta_);
+    if(!prm_->egraph_file_.empty() && !egraph_->load(prm_->egraph_file_))
+      ROS_WARN("Failed to load the experience graph. Starting with an empty one. (file: %s)", prm_->egraph_file_.c_str());
+    egraph_->prune(prm_->egraph_max_nodes_);
+    sbpl_arm_env_->setExperienceGraph(egraph_);
+  }
+
+  if(!prm_->reachability_file_.empty())
+  {
+    rmap_ = new ReachabilityMap();
+    if(!rmap_->load(prm_->reachability_file_))
+    {
+      ROS_WARN("Failed to load the reachability map. Goals won't be checked against it. (file: %s)", prm_->reachability_file_.c_str());
+      delete rmap_;
+      rmap_ = NULL;
+    }
+    else
+    {
+      rmap_->setOrientationTolerance(prm_->reachability_orientation_tolerance_);
+      sbpl_arm_env_->setReachabilityMap(rmap_);
+    }
+  }
+
+  if(prm_->use_swept_volume_)
+  {
+    // the spheres come from the collision space
+    if(dynamic_cast<SBPLCollisionSpace*>(cc_) == NULL)
+      ROS_WARN("The swept volume needs an SBPLCollisionSpace as the collision checker. Not using it.");
+    else
+      swept_volume_ = new SweptVolume(grid_);
+  }
+
   planner_initialized_ = true;
   ROS_INFO("The SBPL arm planner node initialized succesfully.");
   return true;
 }
 
-bool SBPLArmPlannerInterface::initializePlannerAndEnvironment()
+bool SBPLArmPlannerInterface::addSearchThread(RobotModel *rm, CollisionChecker *cc, ActionSet *as)
 {
-  prm_ = new sbpl_arm_planner::PlanningParams();
-  if(!prm_->init())
+  if(rm == NULL || cc == NULL || as == NULL || rm == rm_ || cc == cc_ || as == as_)
+  {
+    ROS_ERROR("Search threads need their own robot model, collision checker and action set.");
     return false;
+  }
+  search_rm_.push_back(rm);
+  search_cc_.push_back(cc);
+  search_as_.push_back(as);
+  return true;
+}
 
+bool SBPLArmPlannerInterface::initializePlannerAndEnvironment()
+{
   grid_ = new sbpl_arm_planner::OccupancyGrid(df_);
   sbpl_arm_env_ = new sbpl_arm_planner::EnvironmentROBARM3D(grid_, rm_, cc_, as_, prm_);
 
   if(!sbpl_arm_env_)
     return false;
 
+  if(prm_->use_coarse_lattice_)
+    as_->setCoarseMprims(prm_->coarse_lattice_factor_, prm_->coarse_lattice_goal_dist_m_);
+  if(prm_->use_bfs_path_mprim_)
+    as_->setBFSPathMprim(prm_->bfs_path_lookahead_, prm_->bfs_path_iterations_, prm_->bfs_path_max_step_, prm_->bfs_path_damping_);
+  as_->setIKSnapFallback(prm_->goal_check_max_snap_dist_);
+
   if(!as_->init(sbpl_arm_env_))
   {
     ROS_ERROR("Failed to initialize the action set.");
@@ -84,8 +202,47 @@ bool SBPLArmPlannerInterface::initializePlannerAndEnvironment()
   } 
   //as_->print();
 
-  //initialize environment  
-  planner_ = new ARAPlanner(sbpl_arm_env_, true);
+  // the action sets of the other search threads are set up like the planner's
+  for(size_t i = 0; i < search_as_.size(); ++i)
+  {
+    if(prm_->use_coarse_lattice_)
+      search_as_[i]->setCoarseMprims(prm_->coarse_lattice_factor_, prm_->coarse_lattice_goal_dist_m_);
+    if(prm_->use_bfs_path_mprim_)
+      search_as_[i]->setBFSPathMprim(prm_->bfs_path_lookahead_, prm_->bfs_path_iterations_, prm_->bfs_path_max_step_, prm_->bfs_path_damping_);
+    search_as_[i]->setIKSnapFallback(prm_->goal_check_max_snap_dist_);
+    search_as_[i]->setUseMultiresMprims(as_->getUseMultiresMprims());
+    if(!search_as_[i]->init(sbpl_arm_env_, search_rm_[i]))
+    {
+      ROS_ERROR("Failed to initialize the action set of search thread %d.", int(i+1));
+      return false;
+    }
+    sbpl_arm_env_->addSearchThread(search_rm_[i], search_cc_[i], search_as_[i]);
+  }
+
+  //initialize environment (the parallel search is forward only & doesn't use the experience graph)
+  bool parallel = (prm_->use_pase_ || prm_->use_hda_) && !prm_->search_backward_ && !prm_->use_experience_graph_;
+  if((prm_->use_pase_ || prm_->use_hda_) && !parallel)
+    ROS_WARN("The parallel search doesn't support the backward search or the experience graph. Using ARA*.");
+  if(prm_->use_pase_ && prm_->use_hda_)
+    ROS_WARN("Both PA*SE & HDA* were requested. Using HDA*.");
+  use_hda_ = parallel && prm_->use_hda_;
+  use_pase_ = parallel && !use_hda_;
+  if(sbpl_arm_env_->getNumSearchThreads() != std::max(prm_->num_search_threads_, 1))
+    ROS_WARN("planning/search_threads is %d but the planner was given %d search threads (see addSearchThread).", prm_->num_search_threads_, sbpl_arm_env_->getNumSearchThreads());
+  if(parallel && sbpl_arm_env_->getNumSearchThreads() == 1)
+    ROS_WARN("The parallel search only has one search thread, set planning/search_threads & add them with addSearchThread.");
+  if(use_hda_)
+  {
+    planner_ = new HDAPlanner(sbpl_arm_env_);
+    ROS_INFO("Using the hash distributed search with %d threads.", sbpl_arm_env_->getNumSearchThreads());
+  }
+  else if(use_pase_)
+  {
+    planner_ = new PASEPlanner(sbpl_arm_env_, prm_->pase_epsilon_, prm_->pase_max_candidates_);
+    ROS_INFO("Using the parallel search with %d threads.", sbpl_arm_env_->getNumSearchThreads());
+  }
+  else
+    planner_ = new ARAPlanner(sbpl_arm_env_, !prm_->search_backward_);
 
   //initialize arm planner environment
   if(!sbpl_arm_env_->initEnvironment())
@@ -101,8 +258,8 @@ bool SBPLArmPlannerInterface::initializePlannerAndEnvironment()
     return false;
   }
 
-  //set epsilon
-  planner_->set_initialsolution_eps(100.0);
+  //set epsilon (each request sets it again from the search schedule)
+  planner_->set_initialsolution_eps(prm_->schedule_.initial_eps);
 
   //set search mode (true - settle with first solution)
   planner_->set_search_mode(prm_->search_mode_);
@@ -117,31 +274,83 @@ bool SBPLArmPlannerInterface::solve(const arm_navigation_msgs::PlanningSceneCons
   if(!planner_initialized_)
     return false;
 
+  // the trace of a request is the spans of this thread (& the others) since now
+  trace_start_ = Tracer::now();
+  if(Tracer::isEnabled())
+    Tracer::clearThread();
+
   // preprocess
-  clock_t t_preprocess = clock();
-  cc_->setPlanningScene(*planning_scene); 
-  prm_->planning_frame_ = planning_scene->collision_map.header.frame_id;
-  grid_->setReferenceFrame(prm_->planning_frame_);
-  // TODO: set kinematics to planning frame
-  double preprocess_time = (clock() - t_preprocess) / (double)CLOCKS_PER_SEC;
+  if(!setPlanningScene(planning_scene))
+    return false;
 
   // plan
-  clock_t t_plan = clock();
+  ros::WallTime t_plan = ros::WallTime::now();
   res.robot_state = planning_scene->robot_state;
-  if(!planToPosition(req,res))
+  bool b_ret = planToPosition(req,res);
+
+  if(recorder_)
+    recorder_->record(*planning_scene, req, getPlannerStats());
+
+  if(Tracer::isEnabled())
+  {
+    double t_end = Tracer::now();
+    Tracer::addEvent("solve", "planner", trace_start_, t_end);
+    if(!prm_->trace_dir_.empty() && t_end - trace_start_ >= prm_->trace_latency_threshold_)
+    {
+      char filename[64];
+      ros::WallTime now = ros::WallTime::now();
+      snprintf(filename, sizeof(filename), "/trace_%u.%09u.json", now.sec, now.nsec);
+      writeTrace(prm_->trace_dir_ + filename);
+    }
+  }
+
+  if(!b_ret)
   {
     ROS_ERROR("Failed to plan.");
     return false;
   }
 
   res_ = res;
-  double plan_time = (clock() - t_plan) / (double)CLOCKS_PER_SEC;
-  ROS_INFO("t_plan: %0.3fsec  t_preprocess: %0.3fsec", plan_time, preprocess_time);
+  double plan_time = (ros::WallTime::now() - t_plan).toSec();
+  ROS_INFO("t_plan: %0.3fsec  t_preprocess: %0.3fsec", plan_time, preprocess_time_);
+  return true;
+}
+
+bool SBPLArmPlannerInterface::setPlanningScene(const arm_navigation_msgs::PlanningSceneConstPtr& planning_scene)
+{
+  TRACE_SCOPE("setPlanningScene", "planner");
+  ros::WallTime t_preprocess = ros::WallTime::now();
+  if(perf_)
+    perf_->start();
+  cc_->setPlanningScene(*planning_scene); 
+
+  // the obstacles went into the shared distance field, the checkers of the
+  // other search threads only need the robot's state & attached objects
+  if(!search_cc_.empty())
+  {
+    arm_navigation_msgs::PlanningScene robot_scene;
+    robot_scene.robot_state = planning_scene->robot_state;
+    robot_scene.attached_collision_objects = planning_scene->attached_collision_objects;
+    robot_scene.collision_map.header = planning_scene->collision_map.header;
+    for(size_t i = 0; i < search_cc_.size(); ++i)
+      search_cc_[i]->setPlanningScene(robot_scene);
+  }
+  prm_->planning_frame_ = planning_scene->collision_map.header.frame_id;
+  grid_->setReferenceFrame(prm_->planning_frame_);
+  // TODO: set kinematics to planning frame
+
+  // obstacles may have moved (the field is shared, so the grid can't tell)
+  grid_->invalidateGradient();
+  sbpl_arm_env_->invalidateHeuristic();
+  preprocess_time_ = (ros::WallTime::now() - t_preprocess).toSec();
+  if(perf_)
+    perf_->stop("preprocessing");
   return true;
 }
 
 bool SBPLArmPlannerInterface::setStart(const sensor_msgs::JointState &state)
 {
+  TRACE_SCOPE("setStart", "planner");
   std::vector<double> initial_positions;
   if(!leatherman::getJointPositions(state, prm_->planning_joints_, initial_positions))
   {
@@ -249,14 +458,177 @@ bool SBPLArmPlannerInterface::planKinematicPath(const arm_navigation_msgs::GetMo
 
 bool SBPLArmPlannerInterface::plan(trajectory_msgs::JointTrajectory &traj)
 {
+  TRACE_SCOPE("plan", "search");
   bool b_ret = false;
-  std::vector<int> solution_state_ids;
+  std::vector<int> solution_state_ids, ids;
+  const SearchSchedule &sched = prm_->schedule_;
+  search_trace_.clear();
+  committed_ids_.clear();
+  prefix_cost_ = 0;
+  prefix_.points.clear();
+  prefix_commit_time_ = -1;
 
   //reinitialize the search space
   planner_->force_planning_from_scratch();
 
-  //plan
-  b_ret = planner_->replan(prm_->allowed_time_, &solution_state_ids, &solution_cost_);
+  // every call searches a single inflation (the next one of the schedule)
+  // & returns, ARA* reuses its previous search unless it was reinitialized.
+  // The first solution mode of ARA* would ignore max_time & not decrease
+  // epsilon, so it isn't used.
+  ReplanParams params(prm_->allowed_time_);
+  params.dec_eps = sched.eps_step;
+  params.return_first_solution = false;
+
+  int cost = 0, num_slow = 0;
+  double eps = sched.initial_eps, target = sched.initial_eps, t_last_solution = 0, t_last_iteration = 0;
+  double deadline = prm_->allowed_time_;
+  bool suffix_pending = false;
+  std::string stop_reason = "out of time";
+  ros::WallTime t_start = ros::WallTime::now();
+  while(true)
+  {
+    if(cancel_ != NULL && *cancel_)
+    {
+      stop_reason = "cancelled";
+      break;
+    }
+
+    double elapsed = (ros::WallTime::now() - t_start).toSec();
+    params.max_time = deadline - elapsed;
+    if(params.max_time <= 0)
+      break;
+
+    // the first search only gets the time until the target for the first solution, if it
+    // misses it the search starts over with a larger inflation & the rest of the time
+    bool capped = false;
+    if(!b_ret && sched.first_solution_time > elapsed && sched.first_solution_time - elapsed < params.max_time)
+    {
+      params.max_time = sched.first_solution_time - elapsed;
+      capped = true;
+    }
+
+    // predict if another iteration can finish in time
+    if(b_ret && sched.iteration_growth > 0 && t_last_iteration * sched.iteration_growth > params.max_time)
+    {
+      stop_reason = "next iteration would miss the deadline";
+      break;
+    }
+
+    // ARA* steps from the last inflation down to the target by dec_eps
+    params.initial_eps = target;
+    params.final_eps = target;
+
+    if(!planner_->replan(&ids, params, &cost) || ids.empty())
+    {
+      // (a search that ran out of states before the cut off won't do better)
+      if(capped && sched.retry_eps_factor > 1.0 && (ros::WallTime::now() - t_start).toSec() >= sched.first_solution_time - 1e-3 && (cancel_ == NULL || !*cancel_))
+      {
+        target *= sched.retry_eps_factor;
+        eps = target;
+        ROS_WARN("[schedule] No solution found within the %0.3fsec target. Searching again with eps: %0.3f.", sched.first_solution_time, target);
+        planner_->force_planning_from_scratch();
+        continue;
+      }
+      if(!b_ret && sched.first_solution_time > 0 && (ros::WallTime::now() - t_start).toSec() > sched.first_solution_time)
+        ROS_WARN("[schedule] No solution found within the %0.3fsec target.", sched.first_solution_time);
+      break;
+    }
+
+    // the edges of deferred primitives are checked once a solution uses them, if one is in
+    // collision the search starts over (without it) at the same inflation
+    if(prm_->defer_primitives_ && !sbpl_arm_env_->checkDeferredEdges(ids))
+    {
+      ROS_INFO("[schedule] The solution has a deferred edge that is in collision. Searching again.");
+      planner_->force_planning_from_scratch();
+      continue;
+    }
+
+    // a search from the committed state only finds the cost of the rest
+    cost += prefix_cost_;
+
+    // out of time before the target was reached, ARA* returns the last solution again
+    double t_now = (ros::WallTime::now() - t_start).toSec();
+    if(b_ret && planner_->get_solution_eps() >= eps - 1e-6)
+      break;
+    eps = planner_->get_solution_eps();
+
+    SearchIteration it;
+    it.time = t_now;
+    it.eps = eps;
+    it.cost = cost;
+    it.expansions = planner_->get_n_expands();
+    search_trace_.push_back(it);
+    ROS_INFO("[schedule] solution %d: eps: %0.3f  cost: %d  expansions: %d  time: %0.3fsec", int(search_trace_.size()), eps, cost, it.expansions, t_now);
+
+    if(!b_ret)
+    {
+      if(sched.first_solution_time > 0 && t_now > sched.first_solution_time)
+        ROS_WARN("[schedule] First solution found after %0.3fsec, the target was %0.3fsec.", t_now, sched.first_solution_time);
+    }
+    else if(sched.min_improvement_rate > 0)
+    {
+      double rate = (double(solution_cost_ - cost) / double(solution_cost_)) / std::max(t_now - t_last_solution, 1e-6);
+      if(rate < sched.min_improvement_rate)
+        num_slow++;
+      else
+        num_slow = 0;
+    }
+
+    t_last_iteration = t_now - t_last_solution;
+    t_last_solution = t_now;
+    // the first solution from the committed state replaces the rest of the first one
+    if(!b_ret || suffix_pending || cost <= solution_cost_)
+    {
+      solution_state_ids = ids;
+      solution_cost_ = cost;
+    }
+    b_ret = true;
+    suffix_pending = false;
+
+    // stream the start of the first solution & search again from its end for the rest, the rest of
+    // the first solution is kept in case nothing is found before the robot gets there
+    if(committed_ids_.empty() && prm_->use_prefix_commit_ && !prm_->search_backward_ && prefix_callback_ && commitPrefix(solution_state_ids))
+    {
+      solution_state_ids.erase(solution_state_ids.begin(), solution_state_ids.begin() + committed_ids_.size() - 1);
+      if(planner_->set_start(committed_ids_.back()) == 0)
+      {
+        ROS_ERROR("[prefix] Failed to set the committed state as the start. Keeping the rest of the first solution.");
+        stop_reason = "failed to search from the committed state";
+        break;
+      }
+      planner_->force_planning_from_scratch();
+
+      // the rest has to be found before the robot gets to the end of the prefix, every
+      // search after this one is given the time that's left until then (max_time)
+      deadline = std::min(deadline, t_now + prm_->prefix_commit_refine_fraction_ * prefix_.points.back().time_from_start.toSec());
+      suffix_pending = true;
+    }
+
+    if(prm_->search_mode_)
+    {
+      stop_reason = "first solution requested";
+      break;
+    }
+    if(target <= sched.final_eps + 1e-6)
+    {
+      stop_reason = "reached the final epsilon";
+      break;
+    }
+    if(num_slow >= sched.patience)
+    {
+      stop_reason = "cost stopped improving";
+      break;
+    }
+
+    // the next inflation
+    params.dec_eps = sched.eps_step;
+    if(sched.eps_decrease_ratio > 0)
+      params.dec_eps = std::max(sched.eps_step, (target - sched.final_eps) * sched.eps_decrease_ratio);
+    target = std::max(sched.final_eps, target - params.dec_eps);
+  }
+
+  if(b_ret)
+    ROS_INFO("[schedule] Stopped after %d solutions (%s).", int(search_trace_.size()), stop_reason.c_str());
 
   //check if an empty plan was received.
   if(b_ret && solution_state_ids.size() <= 0)
@@ -265,6 +637,10 @@ bool SBPLArmPlannerInterface::plan(trajectory_msgs::JointTrajectory &traj)
     b_ret = false;
   }
 
+  // the committed states are put back in front of the rest
+  if(b_ret && !committed_ids_.empty())
+    solution_state_ids.insert(solution_state_ids.begin(), committed_ids_.begin(), committed_ids_.end() - 1);
+
   // if a path is returned, then pack it into msg form
   if(b_ret && (solution_state_ids.size() > 0))
   {
@@ -278,7 +654,7 @@ bool SBPLArmPlannerInterface::plan(trajectory_msgs::JointTrajectory &traj)
 
 bool SBPLArmPlannerInterface::planToPosition(const arm_navigation_msgs::GetMotionPlan::Request &req, arm_navigation_msgs::GetMotionPlan::Response &res)
 {
-  starttime = clock();
+  t_start_ = ros::WallTime::now();
   int status = 0;
   prm_->allowed_time_ = req.motion_plan_request.allowed_planning_time.toSec();
   req_ = req.motion_plan_request;
@@ -294,26 +670,61 @@ bool SBPLArmPlannerInterface::planToPosition(const arm_navigation_msgs::GetMotio
   //sbpl_arm_planner::transformPose(pscene_, gpose, gpose_out, req.motion_plan_request.goal_constraints[0].position_constraints[0].header.frame_id, prm_->planning_frame);
   goal_constraints.orientation_constraints[0].orientation = gpose_out.orientation;
 
+  sbpl_arm_env_->resetStats();
+  set_start_time_ = 0;
+  set_goal_time_ = 0;
+  search_time_ = 0;
+  postprocess_time_ = 0;
+  planning_succeeded_ = false;
+  swept_volume_time_ = -1;
+  if(swept_volume_ != NULL)
+    swept_volume_->clear();
+  if(perf_)
+  {
+    perf_->reset("set goal");
+    perf_->reset("search");
+    perf_->reset("postprocessing");
+  }
+
   // set start
   ROS_INFO("Setting start.");
+  ros::WallTime t_phase = ros::WallTime::now();
   if(!setStart(req.motion_plan_request.start_state.joint_state))
   {
     status = -1;
     ROS_ERROR("Failed to set initial configuration of robot.");
   }
+  set_start_time_ = (ros::WallTime::now() - t_phase).toSec();
 
-  // set goal
+  // set goal (the walls & the bfs for the heuristic)
   ROS_INFO("Setting goal.");
+  t_phase = ros::WallTime::now();
+  if(perf_)
+    perf_->start();
   if(!setGoalPosition(goal_constraints) && status == 0)
   {
     status = -2;
     ROS_ERROR("Failed to set goal position.");
   }
+  set_goal_time_ = (ros::WallTime::now() - t_phase).toSec();
+  if(perf_)
+    perf_->stop("set goal");
   
   // plan 
   ROS_INFO("Calling planner"); 
-  if(status == 0 && plan(res.trajectory.joint_trajectory))
+  t_phase = ros::WallTime::now();
+  if(perf_)
+    perf_->start();
+  bool b_plan = (status == 0 && plan(res.trajectory.joint_trajectory));
+  search_time_ = (ros::WallTime::now() - t_phase).toSec();
+  if(perf_)
+    perf_->stop("search");
+  if(b_plan)
   {
+    // the path from the lattice, before it's shortcut & interpolated
+    if(egraph_ != NULL)
+      addExperience(res.trajectory.joint_trajectory);
+
     res.trajectory.joint_trajectory.header.seq = req.motion_plan_request.goal_constraints.position_constraints[0].header.seq; 
     res.trajectory.joint_trajectory.header.stamp = ros::Time::now();
 
@@ -322,23 +733,47 @@ bool SBPLArmPlannerInterface::planToPosition(const arm_navigation_msgs::GetMotio
     for(size_t i = 1; i < res.trajectory.joint_trajectory.points.size(); i++)
       res.trajectory.joint_trajectory.points[i].time_from_start.fromSec(res.trajectory.joint_trajectory.points[i-1].time_from_start.toSec() + prm_->waypoint_time_);
 
-    res.planning_time = ros::Duration((clock() - starttime) / (double)CLOCKS_PER_SEC);
+    res.planning_time = ros::Duration((ros::WallTime::now() - t_start_).toSec());
 
-    // shortcut path
-    if(prm_->shortcut_path_)
+    t_phase = ros::WallTime::now();
+    if(perf_)
+      perf_->start();
+    std::vector<trajectory_msgs::JointTrajectoryPoint> &points = res.trajectory.joint_trajectory.points;
+    if(committed_ids_.empty())
     {
-      trajectory_msgs::JointTrajectory straj;
-      if(!interpolateTrajectory(cc_, res.trajectory.joint_trajectory.points, straj.points))
-        ROS_WARN("Failed to interpolate planned trajectory with %d waypoints before shortcutting.", int(res.trajectory.joint_trajectory.points.size()));
-      
-      shortcutTrajectory(cc_, straj.points,res.trajectory.joint_trajectory.points);
+      postProcessPath(points);
+      addStartRecoveryPath(points);
     }
+    else
+    {
+      // the streamed prefix is kept as is, the rest starts at its last point
+      std::vector<trajectory_msgs::JointTrajectoryPoint> suffix(points.begin() + committed_ids_.size() - 1, points.end());
+      double duration = prm_->waypoint_time_ * (suffix.size() - 1);
+      postProcessPath(suffix);
+      double t0 = prefix_.points.back().time_from_start.toSec();
+      for(size_t i = 1; i < suffix.size(); ++i)
+        suffix[i].time_from_start.fromSec(t0 + duration * double(i) / double(suffix.size() - 1));
+      points = prefix_.points;
+      points.insert(points.end(), suffix.begin() + 1, suffix.end());
+    }
+
+    postprocess_time_ = (ros::WallTime::now() - t_phase).toSec();
+    if(perf_)
+      perf_->stop("postprocessing");
 
-    // interpolate path
-    if(prm_->interpolate_path_)
+    if(swept_volume_ != NULL)
     {
-      trajectory_msgs::JointTrajectory itraj = res.trajectory.joint_trajectory;
-      interpolateTrajectory(cc_, itraj.points, res.trajectory.joint_trajectory.points);
+      t_phase = ros::WallTime::now();
+      std::vector<std::vector<double> > path(points.size());
+      std::vector<double> times(points.size());
+      for(size_t i = 0; i < points.size(); ++i)
+      {
+        path[i] = points[i].positions;
+        times[i] = points[i].time_from_start.toSec();
+      }
+      if(!swept_volume_->build(static_cast<SBPLCollisionSpace*>(cc_), path, times, prm_->swept_volume_clearance_))
+        ROS_WARN("Failed to build the swept volume of the trajectory.");
+      swept_volume_time_ = (ros::WallTime::now() - t_phase).toSec();
     }
 
     if(prm_->print_path_)
@@ -350,12 +785,149 @@ bool SBPLArmPlannerInterface::planToPosition(const arm_navigation_msgs::GetMotio
     ROS_ERROR("Failed to plan within alotted time frame (%0.2f seconds).", prm_->allowed_time_);
   }
 
+  planning_succeeded_ = (status == 0);
+  if(status == 0)
+    res.error_code.val = arm_navigation_msgs::ArmNavigationErrorCodes::SUCCESS;
+  else if(status == -2 && sbpl_arm_env_->getDebugCode() == GOAL_IN_COLLISION)
+    res.error_code.val = arm_navigation_msgs::ArmNavigationErrorCodes::GOAL_IN_COLLISION;
+  else if(status == -2 && (sbpl_arm_env_->getDebugCode() == GOAL_NO_IK_SOLUTION || sbpl_arm_env_->getDebugCode() == GOAL_UNREACHABLE))
+    res.error_code.val = arm_navigation_msgs::ArmNavigationErrorCodes::NO_IK_SOLUTION;
+  else
+    res.error_code.val = arm_navigation_msgs::ArmNavigationErrorCodes::PLANNING_FAILED;
+
+  if(stats_callback_)
+    stats_callback_(getPlannerStats());
+
   if(status == 0)
     return true;
 
   return false;
 }
 
+void SBPLArmPlannerInterface::postProcessPath(std::vector<trajectory_msgs::JointTrajectoryPoint> &points)
+{
+  // shortcut path
+  if(prm_->shortcut_path_)
+  {
+    TRACE_SCOPE("shortcutTrajectory", "postprocessing");
+    std::vector<trajectory_msgs::JointTrajectoryPoint> spoints;
+    if(!interpolateTrajectory(cc_, points, spoints))
+      ROS_WARN("Failed to interpolate planned trajectory with %d waypoints before shortcutting.", int(points.size()));
+
+    shortcutTrajectory(cc_, spoints, points);
+  }
+
+  // interpolate path
+  if(prm_->interpolate_path_)
+  {
+    TRACE_SCOPE("interpolateTrajectory", "postprocessing");
+    std::vector<trajectory_msgs::JointTrajectoryPoint> ipoints = points;
+    interpolateTrajectory(cc_, ipoints, points);
+  }
+}
+
+void SBPLArmPlannerInterface::addStartRecoveryPath(std::vector<trajectory_msgs::JointTrajectoryPoint> &points)
+{
+  // the motion out of a colliding start isn't collision free, so it's
+  // added after the path is shortcut & interpolated
+  const std::vector<RobotState> &recovery = sbpl_arm_env_->getStartRecoveryPath();
+  if(recovery.empty())
+    return;
+
+  ros::Duration offset(prm_->waypoint_time_ * recovery.size());
+  for(size_t i = 0; i < points.size(); ++i)
+    points[i].time_from_start += offset;
+
+  std::vector<trajectory_msgs::JointTrajectoryPoint> rpoints(recovery.size());
+  for(size_t i = 0; i < recovery.size(); ++i)
+  {
+    rpoints[i].positions = recovery[i];
+    rpoints[i].time_from_start.fromSec(prm_->waypoint_time_ * (i + 1));
+  }
+  points.insert(points.begin(), rpoints.begin(), rpoints.end());
+  ROS_INFO("Added the %d waypoints out of the colliding start configuration to the path.", int(recovery.size()));
+}
+
+bool SBPLArmPlannerInterface::commitPrefix(const std::vector<int> &ids)
+{
+  // the search starts again from the last committed state, so it can't be the goal
+  int k = prm_->prefix_commit_waypoints_;
+  if(int(ids.size()) <= k + 1)
+    return false;
+
+  std::vector<int> committed(ids.begin(), ids.begin() + k + 1);
+  trajectory_msgs::JointTrajectory traj;
+  if(!sbpl_arm_env_->convertStateIDPathToJointTrajectory(committed, traj))
+    return false;
+
+  // shortcutting & interpolating keep the end points, so the rest can be spliced on the last one
+  postProcessPath(traj.points);
+  double dist;
+  for(size_t i = 0; i < traj.points.size(); ++i)
+  {
+    if(!cc_->isStateValid(traj.points[i].positions, false, false, dist))
+    {
+      ROS_WARN("[prefix] Waypoint %d of the prefix is in collision. Not committing it.", int(i));
+      return false;
+    }
+  }
+
+  double duration = prm_->waypoint_time_ * k;
+  for(size_t i = 0; i < traj.points.size(); ++i)
+    traj.points[i].time_from_start.fromSec(traj.points.size() > 1 ? duration * double(i) / double(traj.points.size() - 1) : 0.0);
+  addStartRecoveryPath(traj.points);
+  traj.header.seq = req_.goal_constraints.position_constraints[0].header.seq;
+  traj.header.stamp = ros::Time::now();
+
+  // the cost of the committed edges is added to the cost of the rest
+  int prefix_cost = 0;
+  for(size_t i = 1; i < committed.size(); ++i)
+  {
+    int c = sbpl_arm_env_->getSuccessorCost(committed[i-1], committed[i]);
+    if(c < 0)
+    {
+      ROS_WARN("[prefix] State %d isn't a successor of state %d. Not committing the prefix.", committed[i], committed[i-1]);
+      return false;
+    }
+    prefix_cost += c;
+  }
+
+  prefix_ = traj;
+  committed_ids_ = committed;
+  prefix_cost_ = prefix_cost;
+  prefix_commit_time_ = (ros::WallTime::now() - t_start_).toSec();
+  ROS_INFO("[prefix] Committed the first %d waypoints (%d points, %0.3fsec long) after %0.3fsec.", k, int(prefix_.points.size()), prefix_.points.back().time_from_start.toSec(), prefix_commit_time_);
+  prefix_callback_(prefix_);
+  return true;
+}
+
+static void saveExperienceGraph(boost::shared_ptr<ExperienceGraph> egraph, std::string filename)
+{
+  if(!egraph->save(filename))
+    ROS_WARN("Failed to save the experience graph. (file: %s)", filename.c_str());
+}
+
+void SBPLArmPlannerInterface::addExperience(const trajectory_msgs::JointTrajectory &traj)
+{
+  std::vector<RobotState> path(traj.points.size());
+  for(size_t i = 0; i < traj.points.size(); ++i)
+    path[i] = traj.points[i].positions;
+
+  // the env picks up the new nodes & edges on the next request
+  egraph_->addPath(path);
+  egraph_->prune(prm_->egraph_max_nodes_);
+  if(prm_->egraph_file_.empty())
+    return;
+
+  // a copy is written by another thread, if the last one is still at it the paths are saved with the next one
+  egraph_dirty_ = true;
+  if(egraph_save_thread_.joinable() && !egraph_save_thread_.timed_join(boost::posix_time::seconds(0)))
+    return;
+  boost::shared_ptr<ExperienceGraph> copy(new ExperienceGraph(*egraph_));
+  egraph_save_thread_ = boost::thread(boost::bind(&saveExperienceGraph, copy, prm_->egraph_file_));
+  egraph_dirty_ = false;
+}
+
 bool SBPLArmPlannerInterface::canServiceRequest(const arm_navigation_msgs::GetMotionPlan::Request &req)
 {
   // check for an empty start state
@@ -392,9 +964,102 @@ std::map<std::string, double>  SBPLArmPlannerInterface::getPlannerStats()
   stats["solution epsilon"] = planner_->get_solution_eps();
   stats["expansions"] = planner_->get_n_expands();
   stats["solution cost"] = solution_cost_;
+  stats["number of solutions"] = search_trace_.size();
+  // the same keys for every request, nan when it doesn't apply
+  stats["first solution time"] = search_trace_.empty() ? std::numeric_limits<double>::quiet_NaN() : search_trace_.front().time;
+  stats["planning succeeded"] = planning_succeeded_;
+  stats["preprocessing time"] = preprocess_time_;
+  stats["set start time"] = set_start_time_;
+  stats["set goal time"] = set_goal_time_;
+  stats["search time"] = search_time_;
+  stats["expansions per second"] = search_time_ > 0 ? double(planner_->get_n_expands()) / search_time_ : 0.0;
+  if(use_pase_)
+  {
+    stats["search threads"] = sbpl_arm_env_->getNumSearchThreads();
+    stats["search thread waits"] = static_cast<PASEPlanner*>(planner_)->get_n_waits();
+  }
+  if(use_hda_)
+  {
+    stats["search threads"] = sbpl_arm_env_->getNumSearchThreads();
+    stats["search thread messages"] = static_cast<HDAPlanner*>(planner_)->get_n_messages();
+    stats["reexpansions"] = static_cast<HDAPlanner*>(planner_)->get_n_reexpands();
+  }
+  stats["prefix committed"] = !committed_ids_.empty();
+  stats["prefix commit time"] = committed_ids_.empty() ? std::numeric_limits<double>::quiet_NaN() : prefix_commit_time_;
+  stats["postprocessing time"] = postprocess_time_;
+  stats["swept volume time"] = swept_volume_time_ < 0 ? std::numeric_limits<double>::quiet_NaN() : swept_volume_time_;
+  if(perf_)
+    perf_->getStats(stats);
+  sbpl_arm_env_->getStats(stats);
   return stats;
 }
 
+bool SBPLArmPlannerInterface::getFirstInvalidated(const std::vector<Eigen::Vector3d> &points, double from_time, int &segment, double &time)
+{
+  if(swept_volume_ == NULL)
+    return false;
+  return swept_volume_->getFirstInvalidated(points, from_time, segment, time);
+}
+
+bool SBPLArmPlannerInterface::writeTrace(std::string filename)
+{
+  sbpl_arm_env_->addTraceEvents();
+  return Tracer::write(filename, trace_start_);
+}
+
+void SBPLArmPlannerInterface::setStatsCallback(boost::function<void (const std::map<std::string, double>&)> callback)
+{
+  stats_callback_ = callback;
+}
+
+void SBPLArmPlannerInterface::setPrefixCallback(boost::function<void (const trajectory_msgs::JointTrajectory&)> callback)
+{
+  prefix_callback_ = callback;
+}
+
+void SBPLArmPlannerInterface::setSearchSchedule(const SearchSchedule &schedule)
+{
+  prm_->schedule_ = schedule;
+}
+
+SearchSchedule SBPLArmPlannerInterface::getSearchSchedule()
+{
+  return prm_->schedule_;
+}
+
+void SBPLArmPlannerInterface::setConfiguration(const PlannerConfiguration &config)
+{
+  prm_->use_bfs_heuristic_ = config.use_bfs_heuristic;
+  prm_->schedule_.initial_eps = config.initial_eps;
+  as_->setUseMultiresMprims(config.use_multires_mprims);
+  for(size_t i = 0; i < search_as_.size(); ++i)
+    search_as_[i]->setUseMultiresMprims(config.use_multires_mprims);
+  planner_->set_initialsolution_eps(config.initial_eps);
+  prm_->search_mode_ = config.first_solution;
+  planner_->set_search_mode(config.first_solution);
+}
+
+PlannerConfiguration SBPLArmPlannerInterface::getConfiguration()
+{
+  PlannerConfiguration config;
+  config.use_bfs_heuristic = prm_->use_bfs_heuristic_;
+  config.use_multires_mprims = as_->getUseMultiresMprims();
+  config.initial_eps = prm_->schedule_.initial_eps;
+  config.first_solution = prm_->search_mode_;
+  return config;
+}
+
+void SBPLArmPlannerInterface::setCancelFlag(const volatile bool *cancel)
+{
+  cancel_ = cancel;
+  sbpl_arm_env_->setCancelFlag(cancel);
+}
+
+std::vector<SearchIteration> SBPLArmPlannerInterface::getSearchTrace()
+{
+  return search_trace_;
+}
+
 visualization_msgs::MarkerArray SBPLArmPlannerInterface::getCollisionModelTrajectoryMarker()
 {
   visualization_msgs::MarkerArray ma, ma1;
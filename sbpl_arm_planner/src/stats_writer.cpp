@@ -0,0 +1,110 @@
+/** \author Benjamin Cohen */
+
+#include <sbpl_arm_planner/stats_writer.h>
+#include <ros/ros.h>
+#include <cfloat>
+#include <cmath>
+#include <sstream>
+#include <algorithm>
+
+using namespace sbpl_arm_planner;
+
+StatsWriter::StatsWriter() : json_(false)
+{
+}
+
+StatsWriter::~StatsWriter()
+{
+  if(file_.is_open())
+    file_.close();
+}
+
+bool StatsWriter::open(std::string filename, std::string format)
+{
+  if(format.compare("json") == 0)
+    json_ = true;
+  else if(format.compare("csv") == 0)
+    json_ = false;
+  else
+  {
+    ROS_ERROR("[stats] Unknown format '%s' for the planner stats (csv or json).", format.c_str());
+    return false;
+  }
+
+  // appending to a csv file keeps its columns
+  header_.clear();
+  if(!json_)
+  {
+    std::ifstream in(filename.c_str());
+    std::string line, key;
+    if(in.is_open() && std::getline(in, line))
+    {
+      std::istringstream ss(line);
+      while(std::getline(ss, key, ','))
+        header_.push_back(key);
+    }
+  }
+
+  file_.open(filename.c_str(), std::ios::out | std::ios::app);
+  if(!file_.is_open())
+  {
+    ROS_ERROR("[stats] Failed to open '%s' for the planner stats.", filename.c_str());
+    return false;
+  }
+  file_.precision(9);
+  ROS_INFO("[stats] Writing planner stats to '%s' (%s).", filename.c_str(), format.c_str());
+  return true;
+}
+
+void StatsWriter::write(const std::map<std::string, double> &stats)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  if(!file_.is_open())
+    return;
+
+  std::map<std::string, double>::const_iterator it;
+  if(json_)
+  {
+    file_ << "{";
+    for(it = stats.begin(); it != stats.end(); ++it)
+    {
+      if(it != stats.begin())
+        file_ << ", ";
+      file_ << "\"" << it->first << "\": ";
+      // json has no nan or inf
+      if(it->second != it->second || fabs(it->second) > DBL_MAX)
+        file_ << "null";
+      else
+        file_ << it->second;
+    }
+    file_ << "}" << std::endl;
+    return;
+  }
+
+  // the columns are set by the first request, a stat that's missing is left empty
+  if(header_.empty())
+  {
+    for(it = stats.begin(); it != stats.end(); ++it)
+    {
+      header_.push_back(it->first);
+      file_ << (it != stats.begin() ? "," : "") << it->first;
+    }
+    file_ << std::endl;
+  }
+
+  for(size_t i = 0; i < header_.size(); ++i)
+  {
+    if(i > 0)
+      file_ << ",";
+    it = stats.find(header_[i]);
+    if(it != stats.end() && it->second == it->second)
+      file_ << it->second;
+  }
+  file_ << std::endl;
+
+  for(it = stats.begin(); it != stats.end(); ++it)
+  {
+    if(std::find(header_.begin(), header_.end(), it->first) == header_.end() && dropped_.insert(it->first).second)
+      ROS_WARN("[stats] '%s' isn't one of the columns of the stats file, it won't be written.", it->first.c_str());
+  }
+}
@@ -270,6 +270,33 @@ int main(int argc, char **argv)
   // planner interface
   sbpl_arm_planner::SBPLArmPlannerInterface *planner = new sbpl_arm_planner::SBPLArmPlannerInterface(rm, cc, as, df);
 
+  // the parallel search's other threads, each with its own robot model,
+  // collision checker & action set (the distance field is shared)
+  int num_search_threads;
+  ph.param("planning/search_threads", num_search_threads, 1);
+  for(int i = 1; i < num_search_threads; ++i)
+  {
+    RobotModel *search_rm;
+    if(group_name.compare("right_arm") == 0)
+      search_rm = new sbpl_arm_planner::PR2KDLRobotModel();
+    else
+      search_rm = new sbpl_arm_planner::KDLRobotModel(kinematics_frame, chain_tip_link);
+    if(!search_rm->init(urdf, planning_joints))
+      return false;
+    search_rm->setPlanningLink(planning_link);
+    if(group_name.compare("right_arm") == 0)
+      search_rm->setKinematicsToPlanningTransform(f, planning_frame);
+
+    sbpl_arm_planner::OccupancyGrid *search_grid = new sbpl_arm_planner::OccupancyGrid(df);
+    search_grid->setReferenceFrame(planning_frame);
+    sbpl_arm_planner::CollisionChecker *search_cc = new sbpl_arm_planner::SBPLCollisionSpace(search_grid);
+    if(!search_cc->init(group_name) || !search_cc->setPlanningJoints(planning_joints))
+      return false;
+
+    if(!planner->addSearchThread(search_rm, search_cc, new sbpl_arm_planner::ActionSet(action_set_filename)))
+      return false;
+  }
+
   if(!planner->init())
     return false;
 
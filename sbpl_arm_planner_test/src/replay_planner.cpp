@@ -0,0 +1,380 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ * 
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ * 
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *********************************************************************/
+
+/* Replays planning requests recorded by the RequestRecorder (see
+ * debug/record_requests_dir) and reports the planning time and number
+ * of expansions of each next to the recorded ones. It doesn't need a
+ * roscore, the parameters and robot description come from the bag.
+ *
+ *   rosrun sbpl_arm_planner_test replayPlanner [-n repeat] request_*.bag
+ *
+ * A directory is replaced with the bags in it (when the replay starts).
+ *
+ * Exits with 1 if a request that succeeded when it was recorded fails. */
+
+#include <ros/ros.h>
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <std_msgs/String.h>
+#include <std_msgs/UInt32.h>
+#include <boost/foreach.hpp>
+#include <dirent.h>
+#include <algorithm>
+#include <arm_navigation_msgs/PlanningScene.h>
+#include <arm_navigation_msgs/GetMotionPlan.h>
+#include <sbpl_arm_planner/sbpl_arm_planner_interface.h>
+#include <sbpl_arm_planner/request_recorder.h>
+#include <sbpl_manipulation_components/kdl_robot_model.h>
+#include <sbpl_manipulation_components_pr2/pr2_kdl_robot_model.h>
+#include <sbpl_collision_checking/sbpl_collision_space.h>
+
+using namespace sbpl_arm_planner;
+
+typedef struct
+{
+  arm_navigation_msgs::PlanningScenePtr scene;
+  arm_navigation_msgs::MotionPlanRequest request;
+  std::string robot_description;
+  std::string params;
+  std::string action_set;
+  unsigned int action_set_crc;
+  std::map<std::string, double> stats;
+} RecordedRequest;
+
+bool readBag(std::string filename, RecordedRequest &r)
+{
+  try
+  {
+    rosbag::Bag bag(filename, rosbag::bagmode::Read);
+    rosbag::View view(bag);
+    int found = 0;
+    BOOST_FOREACH(rosbag::MessageInstance const m, view)
+    {
+      if(m.getTopic() == RECORD_SCENE_TOPIC && (r.scene = m.instantiate<arm_navigation_msgs::PlanningScene>()))
+        found++;
+      else if(m.getTopic() == RECORD_REQUEST_TOPIC && m.instantiate<arm_navigation_msgs::MotionPlanRequest>())
+      {
+        r.request = *(m.instantiate<arm_navigation_msgs::MotionPlanRequest>());
+        found++;
+      }
+      else if(m.getTopic() == RECORD_ACTION_SET_HASH_TOPIC && m.instantiate<std_msgs::UInt32>())
+        r.action_set_crc = m.instantiate<std_msgs::UInt32>()->data;
+      else if(m.instantiate<std_msgs::String>())
+      {
+        std::string data = m.instantiate<std_msgs::String>()->data;
+        if(m.getTopic() == RECORD_ROBOT_DESCRIPTION_TOPIC)
+          r.robot_description = data;
+        else if(m.getTopic() == RECORD_PARAMS_TOPIC)
+          r.params = data;
+        else if(m.getTopic() == RECORD_ACTION_SET_TOPIC)
+          r.action_set = data;
+        else if(m.getTopic() == RECORD_STATS_TOPIC)
+          r.stats = RequestRecorder::stringToStats(data);
+      }
+    }
+    bag.close();
+
+    if(found < 2)
+    {
+      ROS_ERROR("'%s' doesn't contain a planning scene and a request.", filename.c_str());
+      return false;
+    }
+  }
+  catch(rosbag::BagException &e)
+  {
+    ROS_ERROR("Failed to read '%s': %s", filename.c_str(), e.what());
+    return false;
+  }
+  return true;
+}
+
+/* a string in the recorded parameters, "" if it isn't there */
+std::string getString(XmlRpc::XmlRpcValue &params, const std::string &name)
+{
+  if(params.getType() != XmlRpc::XmlRpcValue::TypeStruct || !params.hasMember(name) || params[name].getType() != XmlRpc::XmlRpcValue::TypeString)
+    return "";
+  return static_cast<std::string>(params[name]);
+}
+
+/* parses the recorded parameters & writes out the recorded action set */
+bool readParams(const RecordedRequest &r, XmlRpc::XmlRpcValue &params, std::string &action_set_filename)
+{
+  int offset = 0;
+  if(r.params.empty() || !params.fromXml(r.params, &offset) || params.getType() != XmlRpc::XmlRpcValue::TypeStruct)
+  {
+    ROS_ERROR("Failed to parse the recorded planner parameters.");
+    return false;
+  }
+
+  // don't record or log the replays
+  params["debug"]["record_requests_dir"] = std::string("");
+  params["debug"]["stats"]["file"] = std::string("");
+
+  std::string contents;
+  action_set_filename = "/tmp/replay_action_set.mprim";
+  FILE* file = fopen(action_set_filename.c_str(), "w");
+  if(file == NULL || fwrite(r.action_set.data(), 1, r.action_set.size(), file) != r.action_set.size())
+  {
+    ROS_ERROR("Failed to write the recorded action set to '%s'.", action_set_filename.c_str());
+    if(file)
+      fclose(file);
+    return false;
+  }
+  fclose(file);
+
+  if(RequestRecorder::getFileChecksum(action_set_filename, contents) != r.action_set_crc)
+  {
+    ROS_ERROR("The recorded action set doesn't match its checksum.");
+    return false;
+  }
+  return true;
+}
+
+/* a robot model & collision checker (on its own grid of the distance field)
+ * set up like callPlanner's, they're left in the vectors to be freed */
+bool createArm(const RecordedRequest &r, XmlRpc::XmlRpcValue &params, const std::vector<std::string> &planning_joints, distance_field::PropagationDistanceField *df, std::vector<RobotModel*> &rms, std::vector<sbpl_arm_planner::OccupancyGrid*> &grids, std::vector<sbpl_arm_planner::CollisionChecker*> &ccs)
+{
+  std::string group_name = getString(params, "group_name");
+  std::string kinematics_frame = getString(params, "kinematics_frame");
+  std::string planning_frame = getString(params, "planning_frame");
+  std::string planning_link = getString(params, "planning_link");
+  std::string chain_tip_link = getString(params, "chain_tip_link");
+
+  RobotModel *rm;
+  if(group_name.compare("right_arm") == 0)
+    rm  = new sbpl_arm_planner::PR2KDLRobotModel();
+  else
+    rm  = new sbpl_arm_planner::KDLRobotModel(kinematics_frame, chain_tip_link);
+  rms.push_back(rm);
+  if(!rm->init(r.robot_description, planning_joints))
+    return false;
+  rm->setPlanningLink(planning_link);
+  if(group_name.compare("right_arm") == 0)
+  {
+    KDL::Frame f;
+    f.p.x(-0.05); f.p.y(1.0); f.p.z(0.803);
+    f.M = KDL::Rotation::Quaternion(0,0,0,1);
+    rm->setKinematicsToPlanningTransform(f, planning_frame);
+  }
+
+  sbpl_arm_planner::OccupancyGrid *grid = new sbpl_arm_planner::OccupancyGrid(df);
+  grids.push_back(grid);
+  grid->setReferenceFrame(planning_frame);
+  sbpl_arm_planner::SBPLCollisionSpace *cc = new sbpl_arm_planner::SBPLCollisionSpace(grid);
+  ccs.push_back(cc);
+  if(!params.hasMember("collision_groups") || !params.hasMember("collision_spheres"))
+  {
+    ROS_ERROR("The recorded parameters don't have the collision groups & spheres.");
+    return false;
+  }
+  return cc->init(group_name, r.robot_description, params["collision_groups"], params["collision_spheres"]) && cc->setPlanningJoints(planning_joints);
+}
+
+/* returns -1 if the replay failed to set up, otherwise the number of successful runs */
+int replay(const RecordedRequest &r, int repeat, std::string trace_file, std::vector<std::map<std::string, double> > &run_stats)
+{
+  XmlRpc::XmlRpcValue params;
+  std::string action_set_filename;
+  if(!readParams(r, params, action_set_filename))
+    return -1;
+
+  if(!params.hasMember("planning") || params["planning"].getType() != XmlRpc::XmlRpcValue::TypeStruct)
+  {
+    ROS_ERROR("The recorded parameters don't have the planning parameters.");
+    return -1;
+  }
+
+  std::vector<std::string> planning_joints;
+  std::stringstream joint_name_stream(getString(params["planning"], "planning_joints"));
+  std::string jname;
+  while(joint_name_stream >> jname)
+    planning_joints.push_back(jname);
+
+  int num_threads = 1;
+  if(params["planning"].hasMember("search_threads") && params["planning"]["search_threads"].getType() == XmlRpc::XmlRpcValue::TypeInt)
+    num_threads = params["planning"]["search_threads"];
+
+  // same setup as callPlanner, everything is freed on the way out, the
+  // first arm is the planner's & the others are the extra search threads'
+  distance_field::PropagationDistanceField *df = new distance_field::PropagationDistanceField(3.0, 3.0, 3.0, 0.02, -0.75, -1.25, -1.0, 0.2);
+  df->reset();
+
+  std::vector<RobotModel*> rms;
+  std::vector<sbpl_arm_planner::OccupancyGrid*> grids;
+  std::vector<sbpl_arm_planner::CollisionChecker*> ccs;
+  std::vector<sbpl_arm_planner::ActionSet*> ases;
+  sbpl_arm_planner::SBPLArmPlannerInterface *planner = NULL;
+  int num_solved = -1;
+  bool ok = true;
+  for(int i = 0; i < std::max(num_threads, 1) && ok; ++i)
+  {
+    ok = createArm(r, params, planning_joints, df, rms, grids, ccs);
+    if(ok)
+      ases.push_back(new sbpl_arm_planner::ActionSet(action_set_filename));
+  }
+
+  if(ok)
+  {
+    planner = new sbpl_arm_planner::SBPLArmPlannerInterface(rms[0], ccs[0], ases[0], df);
+    for(size_t i = 1; i < ases.size() && ok; ++i)
+      ok = planner->addSearchThread(rms[i], ccs[i], ases[i]);
+  }
+
+  if(ok && planner->init(params))
+  {
+    num_solved = 0;
+    arm_navigation_msgs::GetMotionPlan::Request req;
+    req.motion_plan_request = r.request;
+    for(int i = 0; i < repeat; ++i)
+    {
+      arm_navigation_msgs::GetMotionPlan::Response res;
+      if(planner->solve(r.scene, req, res))
+        num_solved++;
+      run_stats.push_back(planner->getPlannerStats());
+      if(!trace_file.empty())
+        planner->writeTrace(trace_file);
+    }
+  }
+
+  // the planner uses the others
+  delete planner;
+  for(size_t i = 0; i < ases.size(); ++i)
+    delete ases[i];
+  for(size_t i = 0; i < ccs.size(); ++i)
+    delete ccs[i];
+  for(size_t i = 0; i < grids.size(); ++i)
+    delete grids[i];
+  for(size_t i = 0; i < rms.size(); ++i)
+    delete rms[i];
+  delete df;
+  return num_solved;
+}
+
+/* the bags in a directory, in order */
+bool addBagsInDirectory(std::string dirname, std::vector<std::string> &bags)
+{
+  DIR *dir = opendir(dirname.c_str());
+  if(dir == NULL)
+    return false;
+
+  std::vector<std::string> found;
+  struct dirent *entry;
+  while((entry = readdir(dir)) != NULL)
+  {
+    std::string name(entry->d_name);
+    if(name.size() > 4 && name.compare(name.size() - 4, 4, ".bag") == 0)
+      found.push_back(dirname + "/" + name);
+  }
+  closedir(dir);
+
+  std::sort(found.begin(), found.end());
+  bags.insert(bags.end(), found.begin(), found.end());
+  return true;
+}
+
+int main(int argc, char **argv)
+{
+  // everything comes from the bags, there's no master to talk to
+  ros::init(argc, argv, "sbpl_arm_planner_replay", ros::init_options::NoRosout | ros::init_options::NoSimTime);
+
+  int repeat = 1;
+  std::string trace_file;
+  std::vector<std::string> bags;
+  for(int i = 1; i < argc; ++i)
+  {
+    if(std::string(argv[i]).compare("-n") == 0 && i+1 < argc)
+      repeat = std::max(1, atoi(argv[++i]));
+    else if(std::string(argv[i]).compare("-t") == 0 && i+1 < argc)
+      trace_file = argv[++i];
+    else if(!addBagsInDirectory(argv[i], bags))
+      bags.push_back(argv[i]);
+  }
+
+  if(bags.empty())
+  {
+    ROS_ERROR("usage: replayPlanner [-n repeat] [-t trace.json] request.bag|directory [request.bag|directory ...]");
+    return 1;
+  }
+
+  // the trace of the last run is written (chrome://tracing)
+  if(!trace_file.empty())
+    sbpl_arm_planner::Tracer::setEnabled(true);
+
+  int regressions = 0;
+  std::stringstream report;
+  report << "bag, recorded_success, recorded_time, recorded_expansions, successes, runs, mean_time, min_time, mean_expansions" << std::endl;
+  for(size_t i = 0; i < bags.size(); ++i)
+  {
+    RecordedRequest r;
+    if(!readBag(bags[i], r))
+    {
+      regressions++;
+      continue;
+    }
+
+    std::vector<std::map<std::string, double> > run_stats;
+    int num_solved = replay(r, repeat, trace_file, run_stats);
+    if(num_solved < 0)
+    {
+      ROS_ERROR("Failed to set up the planner for '%s'.", bags[i].c_str());
+      regressions++;
+      continue;
+    }
+
+    double mean_time = 0, min_time = -1, mean_expansions = 0;
+    for(size_t j = 0; j < run_stats.size(); ++j)
+    {
+      double t = run_stats[j]["set start time"] + run_stats[j]["set goal time"] + run_stats[j]["search time"] + run_stats[j]["postprocessing time"];
+      mean_time += t / run_stats.size();
+      mean_expansions += run_stats[j]["expansions"] / run_stats.size();
+      if(min_time < 0 || t < min_time)
+        min_time = t;
+    }
+    double recorded_time = r.stats["set start time"] + r.stats["set goal time"] + r.stats["search time"] + r.stats["postprocessing time"];
+
+    if(r.stats["planning succeeded"] > 0 && num_solved < repeat)
+    {
+      ROS_ERROR("'%s' was solved when it was recorded but failed %d/%d times in the replay.", bags[i].c_str(), repeat - num_solved, repeat);
+      regressions++;
+    }
+
+    report << bags[i] << ", " << r.stats["planning succeeded"] << ", " << recorded_time << ", " << r.stats["expansions"] << ", " << num_solved << ", " << repeat << ", " << mean_time << ", " << min_time << ", " << mean_expansions << std::endl;
+  }
+
+  printf("\n%s\n", report.str().c_str());
+  return regressions > 0 ? 1 : 0;
+}
+
@@ -53,6 +53,9 @@ class SBPLCollisionModel
 
     bool init();
 
+    /** \brief init() with the robot description & the collision groups passed in (no param server) */
+    bool init(const std::string &robot_description, XmlRpc::XmlRpcValue &groups, XmlRpc::XmlRpcValue &spheres);
+
     bool initAllGroups();
 
     void getGroupNames(std::vector<std::string> &names);
@@ -99,7 +102,11 @@ class SBPLCollisionModel
 
     bool getRobotModel();
 
+    bool initRobotModel(const std::string &robot_description);
+
     bool readGroups();
+
+    bool readGroups(XmlRpc::XmlRpcValue &all_groups, XmlRpc::XmlRpcValue &all_spheres);
    
     bool computeFK(const std::vector<double> &angles, Group* group, int chain, int segment, KDL::Frame &frame);
 };
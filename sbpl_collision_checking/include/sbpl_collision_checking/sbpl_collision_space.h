@@ -62,6 +62,9 @@ class SBPLCollisionSpace : public sbpl_arm_planner::CollisionChecker
 
     bool init(std::string group_name);
 
+    /** \brief init() with the robot description & the collision groups passed in (no param server) */
+    bool init(std::string group_name, const std::string &robot_description, XmlRpc::XmlRpcValue &groups, XmlRpc::XmlRpcValue &spheres);
+
     void setPadding(double padding);
    
     bool setPlanningScene(const arm_navigation_msgs::PlanningScene &scene);
@@ -74,6 +77,7 @@ class SBPLCollisionSpace : public sbpl_arm_planner::CollisionChecker
     bool getClearance(const std::vector<double> &angles, int num_spheres, double &avg_dist, double &min_dist);
     bool isStateValid(const std::vector<double> &angles, bool verbose, bool visualize, double &dist);
     bool isStateToStateValid(const std::vector<double> &angles0, const std::vector<double> &angles1, int path_length, int num_checks, double &dist);
+    bool getRepairStep(const std::vector<double> &angles, double clearance, std::vector<double> &step);
 
     /** ---------------- Utils ---------------- */
     bool interpolatePath(const std::vector<double>& start, const std::vector<double>& end, std::vector<std::vector<double> >& path);
@@ -144,6 +148,8 @@ class SBPLCollisionSpace : public sbpl_arm_planner::CollisionChecker
     std::vector<Sphere> object_spheres_;
     
     std::vector<sbpl_arm_planner::Sphere> collision_spheres_;
+
+    bool initGroups();
 };
 
 inline bool SBPLCollisionSpace::isValidCell(const int x, const int y, const int z, const int radius)
@@ -0,0 +1,85 @@
+/** \author Benjamin Cohen */
+
+#ifndef _SWEPT_VOLUME_
+#define _SWEPT_VOLUME_
+
+#include <vector>
+#include <Eigen/Core>
+#include <sbpl_manipulation_components/occupancy_grid.h>
+#include <sbpl_collision_checking/sbpl_collision_space.h>
+
+namespace sbpl_arm_planner
+{
+
+/* \brief The cells of the grid that the collision spheres of a trajectory
+ * come within a clearance of, to revalidate it when obstacles show up while
+ * it's executed. The waypoints are interpolated like the collision space
+ * checks them & every cell keeps the first & last configuration that swept
+ * it. The cells are kept in bricks of 8x8x8 (a bitset & the configurations
+ * of the cells), only the bricks that were swept are allocated. Looking up
+ * an occupied cell is constant time, so a scene update costs as much as the
+ * number of cells that changed.
+*/
+class SweptVolume
+{
+  public:
+
+    SweptVolume(OccupancyGrid *grid);
+
+    /** \brief Sweep the trajectory (the time of each waypoint, or its index if times is empty), clearance in meters */
+    bool build(SBPLCollisionSpace *cspace, const std::vector<std::vector<double> > &path, const std::vector<double> &times, double clearance);
+
+    void clear();
+
+    bool isSwept(int x, int y, int z);
+
+    /**
+     * @brief The first configuration at or after from_time that's within
+     * the clearance of one of the points (in the grid's frame). If a cell
+     * was swept both before & after from_time it's counted at from_time, so
+     * the time can be early but never late.
+     * @param segment the waypoint that starts the invalidated segment
+     * @param time when the trajectory reaches it (the time to collision is time - from_time)
+     * @return false if none of the points is in the way
+    */
+    bool getFirstInvalidated(const std::vector<Eigen::Vector3d> &points, double from_time, int &segment, double &time);
+
+    int getNumCells() const { return num_cells_; }
+
+    int getNumBricks() const { return int(bricks_.size()); }
+
+  private:
+
+    /* cells along each side of a brick */
+    static const int brick_size_ = 8;
+    static const int brick_cells_ = brick_size_ * brick_size_ * brick_size_;
+
+    typedef struct
+    {
+      unsigned long long swept[brick_cells_ / 64];
+      int first[brick_cells_];
+      int last[brick_cells_];
+    } Brick;
+
+    OccupancyGrid *grid_;
+    double clearance_;
+    int num_cells_;
+
+    /* index of the brick in bricks_ for every brick of the grid, -1 if it wasn't swept */
+    int brick_dims_[3];
+    std::vector<int> directory_;
+    std::vector<Brick> bricks_;
+
+    /* time & segment of each of the interpolated configurations */
+    std::vector<double> times_;
+    std::vector<int> segments_;
+
+    /** \brief The brick of the cell & the cell's index in it, NULL if it's not allocated */
+    Brick* getBrick(int x, int y, int z, int &cell, bool allocate);
+
+    void sweepSphere(double x, double y, double z, double radius, int config);
+};
+
+}
+
+#endif
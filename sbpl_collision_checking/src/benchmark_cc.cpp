@@ -1,52 +1,181 @@
 #include <iostream>
-#include <sbpl_collision_checking/test_sbpl_collision_space.h>
+#include <ros/ros.h>
+#include <sbpl_manipulation_components/benchmark.h>
+#include <sbpl_collision_checking/sbpl_collision_space.h>
 
 using namespace sbpl_arm_planner;
 
-int main(int argc, char **argv)
+/* collision spheres of the synthetic arm (in their link's frame) */
+void addSphere(XmlRpc::XmlRpcValue &spheres, std::string name, double x, double radius, int priority)
+{
+  XmlRpc::XmlRpcValue s;
+  s["name"] = name;
+  s["x"] = x;
+  s["y"] = 0.0;
+  s["z"] = 0.0;
+  s["radius"] = radius;
+  s["priority"] = priority;
+  spheres[spheres.size()] = s;
+}
+
+void addLink(XmlRpc::XmlRpcValue &links, std::string name, std::string root, std::string spheres)
+{
+  XmlRpc::XmlRpcValue l;
+  l["name"] = name;
+  l["root"] = root;
+  l["spheres"] = spheres;
+  links[links.size()] = l;
+}
+
+void getSyntheticArmCollisionGroups(XmlRpc::XmlRpcValue &groups, XmlRpc::XmlRpcValue &spheres)
+{
+  spheres.setSize(0);
+  addSphere(spheres, "ua0", 0.10, 0.08, 1);
+  addSphere(spheres, "ua1", 0.20, 0.08, 2);
+  addSphere(spheres, "ua2", 0.30, 0.08, 2);
+  addSphere(spheres, "fa0", 0.08, 0.06, 2);
+  addSphere(spheres, "fa1", 0.16, 0.06, 3);
+  addSphere(spheres, "fa2", 0.24, 0.06, 3);
+  addSphere(spheres, "g0", 0.06, 0.05, 3);
+  addSphere(spheres, "g1", 0.12, 0.05, 3);
+
+  XmlRpc::XmlRpcValue links;
+  links.setSize(0);
+  addLink(links, "upper_arm", "upper_arm_roll_link", "ua0 ua1 ua2");
+  addLink(links, "forearm", "forearm_roll_link", "fa0 fa1 fa2");
+  addLink(links, "gripper", "wrist_roll_link", "g0 g1");
+
+  XmlRpc::XmlRpcValue arm;
+  arm["name"] = std::string("arm");
+  arm["type"] = std::string("spheres");
+  arm["root_name"] = std::string("base_link");
+  arm["tip_name"] = std::string("tool_link");
+  arm["collision_links"] = links;
+
+  groups.setSize(1);
+  groups[0] = arm;
+}
+
+struct GroupFKOp
+{
+  Group *group;
+  std::vector<std::vector<double> > states;
+  std::vector<std::vector<KDL::Frame> > frames;
+  size_t i;
+
+  void operator()()
+  {
+    group->computeFK(states[i], frames);
+    i = (i + 1) % states.size();
+  }
+};
+
+struct CheckCollisionOp
 {
-  ros::init(argc, argv, "benchmark_sbpl_collision_checking");
-  ros::NodeHandle nh_, ph_("~");
-  int num_checks = 100;
-  std::string group_name = "right_arm";
+  SBPLCollisionSpace *cspace;
+  std::vector<std::vector<double> > states;
+  size_t i;
+  int valid;
+  double dist;
+
+  void operator()()
+  {
+    if(cspace->checkCollision(states[i], false, false, dist))
+      valid++;
+    i = (i + 1) % states.size();
+  }
+};
+
+struct CheckPathOp
+{
+  SBPLCollisionSpace *cspace;
+  std::vector<std::vector<double> > starts;
+  std::vector<std::vector<double> > ends;
+  size_t i;
+  int valid;
+  int path_length, num_checks;
+  double dist;
+
+  void operator()()
+  {
+    if(cspace->checkPathForCollision(starts[i], ends[i], false, path_length, num_checks, dist))
+      valid++;
+    i = (i + 1) % starts.size();
+  }
+};
 
+int main(int argc, char **argv)
+{
+  // the collision model has node handles, but nothing is read from a master
+  ros::init(argc, argv, "benchmark_sbpl_collision_checking", ros::init_options::NoRosout);
+  std::string json_file;
   if(argc > 1)
-    num_checks = atoi(argv[1]);
+    json_file = argv[1];
 
-  // set up the grid
-  OccupancyGrid* grid_ = new OccupancyGrid(1.7, 1.9, 2.0, 0.01, -0.6, -1.25, -0.05);
+  Benchmark bm("sbpl_collision_checking", 1);
+  unsigned int seed = bm.getSeed();
 
-  // create the collision space
-  SBPLCollisionSpace* cspace_ = new SBPLCollisionSpace(grid_);
-  //cspace_->setPlanningJoints(prms_.planning_joints_);
-  cspace_->init(group_name);
+  std::vector<std::string> joints;
+  getSyntheticArmJoints(joints);
+  XmlRpc::XmlRpcValue groups, spheres;
+  getSyntheticArmCollisionGroups(groups, spheres);
+
+  // a 2m cube in front of the arm with a few random boxes in it
+  OccupancyGrid grid(2.0, 2.0, 2.0, 0.02, -0.5, -1.0, 0.0);
+  for(int i = 0; i < 5; ++i)
+  {
+    double x = -0.2 + 1.4 * (rand_r(&seed) / double(RAND_MAX));
+    double y = -0.8 + 1.6 * (rand_r(&seed) / double(RAND_MAX));
+    double z = 0.2 + 1.4 * (rand_r(&seed) / double(RAND_MAX));
+    grid.addCube(x, y, z, 0.2, 0.2, 0.2);
+  }
 
-  // get map
-  moveit_msgs::CollisionMapConstPtr map = ros::topic::waitForMessage<moveit_msgs::CollisionMap>("collision_map_occ");
-  grid_->updateFromCollisionMap(*map); 
+  // group forward kinematics
+  Group group("arm");
+  boost::shared_ptr<urdf::Model> urdf(new urdf::Model());
+  if(!urdf->initString(getSyntheticArmURDF()) || !group.getParams(groups[0], spheres) || !group.init(urdf))
+  {
+    ROS_ERROR("Failed to initialize the collision group. Exiting.");
+    return 1;
+  }
+  group.setOrderOfJointPositions(joints);
 
-  std::vector<double> angles(7,0);
-  unsigned char dist = 100;
+  GroupFKOp fk;
+  fk.group = &group;
+  fk.i = 0;
+  fk.states.resize(1000);
+  for(size_t i = 0; i < fk.states.size(); ++i)
+    getRandomSyntheticArmState(&seed, fk.states[i]);
+  bm.run("group_compute_fk", fk, 100000);
 
-  ROS_INFO("Starting %d collision checks.", num_checks);
-  clock_t start = clock();
-  for(int i = 0; i < num_checks; ++i)
+  // collision space
+  SBPLCollisionSpace cspace(&grid);
+  if(!cspace.init("arm", getSyntheticArmURDF(), groups, spheres) || !cspace.setPlanningJoints(joints))
   {
-    if(!cspace_->checkCollision(angles, false, false, dist))
-    {
-      ROS_INFO("In Collision");
-      break;
-    }
+    ROS_ERROR("Failed to initialize the collision space. Exiting.");
+    return 1;
   }
-  double total_time = (clock()-start)/double(CLOCKS_PER_SEC);
-  ROS_INFO("       total time: %0.8fsec", total_time);
-  ROS_INFO("   time per check: %0.8fsec", total_time/double(num_checks));
-  ROS_INFO("checks per second: %0.8fsec", 1.0 / (total_time/double(num_checks)));
 
-  ROS_INFO("[sanity check] # calls: %d   # calls not in collision: %d", cspace_->num_collision_checks_, cspace_->num_false_collision_checks_);
+  CheckCollisionOp cc;
+  cc.cspace = &cspace;
+  cc.i = 0;
+  cc.valid = 0;
+  cc.states = fk.states;
+  bm.run("check_collision", cc, 100000);
+  ROS_INFO("[sanity check] # collision free states: %d", cc.valid);
+
+  // short edges, like the motion primitives
+  CheckPathOp path;
+  path.cspace = &cspace;
+  path.i = 0;
+  path.valid = 0;
+  path.starts = fk.states;
+  path.ends = fk.states;
+  for(size_t i = 0; i < path.ends.size(); ++i)
+    path.ends[i][rand_r(&seed) % path.ends[i].size()] += 0.14 * ((rand_r(&seed) % 2) ? 1 : -1);
+  bm.run("check_path_for_collision", path, 10000);
+  ROS_INFO("[sanity check] # collision free edges: %d", path.valid);
 
-  delete cspace_; 
-  delete grid_;
-  return 0;
+  return bm.writeJSON(json_file) ? 0 : 1;
 }
 
@@ -27,21 +27,32 @@ bool SBPLCollisionModel::init()
   return readGroups();
 }
 
+bool SBPLCollisionModel::init(const std::string &robot_description, XmlRpc::XmlRpcValue &groups, XmlRpc::XmlRpcValue &spheres)
+{
+  if(!initRobotModel(robot_description))
+    return false;
+
+  return readGroups(groups, spheres);
+}
+
 bool SBPLCollisionModel::getRobotModel()
 {
   std::string robot_description;
-  if (nh_.getParam("robot_description", robot_description))
+  if (!nh_.getParam("robot_description", robot_description))
   {
-    urdf_ = boost::shared_ptr<urdf::Model>(new urdf::Model());
-    if (!urdf_->initString(robot_description))
-    {
-      ROS_WARN("Failed to parse the URDF");
-      return false;
-    }
+    ROS_ERROR("The robot description was not found on the param server.");
+    return false;
   }
-  else
+
+  return initRobotModel(robot_description);
+}
+
+bool SBPLCollisionModel::initRobotModel(const std::string &robot_description)
+{
+  urdf_ = boost::shared_ptr<urdf::Model>(new urdf::Model());
+  if (!urdf_->initString(robot_description))
   {
-    ROS_ERROR("The robot description was not found on the param server.");
+    ROS_WARN("Failed to parse the URDF");
     return false;
   }
 
@@ -61,15 +72,6 @@ bool SBPLCollisionModel::readGroups()
   }
   ph_.getParam(spheres_name, all_spheres);
 
-  if(all_spheres.getType() != XmlRpc::XmlRpcValue::TypeArray) 
-    ROS_WARN("Spheres is not an array.");
-
-  if(all_spheres.size() == 0) 
-  {
-    ROS_WARN("No spheres in spheres");
-    return false;
-  }
-
   // collision groups
   std::string group_name = "collision_groups";
   if(!ph_.hasParam(group_name)) 
@@ -79,6 +81,20 @@ bool SBPLCollisionModel::readGroups()
   }
   ph_.getParam(group_name, all_groups);
 
+  return readGroups(all_groups, all_spheres);
+}
+
+bool SBPLCollisionModel::readGroups(XmlRpc::XmlRpcValue &all_groups, XmlRpc::XmlRpcValue &all_spheres)
+{
+  if(all_spheres.getType() != XmlRpc::XmlRpcValue::TypeArray) 
+    ROS_WARN("Spheres is not an array.");
+
+  if(all_spheres.size() == 0) 
+  {
+    ROS_WARN("No spheres in spheres");
+    return false;
+  }
+
   if(all_groups.getType() != XmlRpc::XmlRpcValue::TypeArray) 
     ROS_WARN("Groups is not an array.");
 
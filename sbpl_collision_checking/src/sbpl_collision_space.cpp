@@ -31,6 +31,7 @@
 
 #include <sbpl_collision_checking/sbpl_collision_space.h>
 #include <leatherman/viz.h>
+#include <sbpl_manipulation_components/tracer.h>
 
 namespace sbpl_arm_planner
 {
@@ -91,6 +92,24 @@ bool SBPLCollisionSpace::init(std::string group_name)
     return false;
   }
 
+  return initGroups();
+}
+
+bool SBPLCollisionSpace::init(std::string group_name, const std::string &robot_description, XmlRpc::XmlRpcValue &groups, XmlRpc::XmlRpcValue &spheres)
+{
+  group_name_ = group_name;
+
+  if(!model_.init(robot_description, groups, spheres))
+  {
+    ROS_ERROR("[cspace] The robot's collision model failed to initialize.");
+    return false;
+  }
+
+  return initGroups();
+}
+
+bool SBPLCollisionSpace::initGroups()
+{
   if(!model_.initAllGroups())
   {
     ROS_ERROR("Failed to initialize all groups.");
@@ -114,6 +133,7 @@ bool SBPLCollisionSpace::init(std::string group_name)
 
 bool SBPLCollisionSpace::checkCollision(const std::vector<double> &angles, bool verbose, bool visualize, double &dist)
 {
+  TRACE_SCOPE("checkCollision", "collision");
   double dist_temp=100.0;
   dist = 100.0;
   KDL::Vector v;
@@ -268,6 +288,7 @@ bool SBPLCollisionSpace::updateVoxelGroup(Group *g)
 
 bool SBPLCollisionSpace::checkPathForCollision(const std::vector<double> &start, const std::vector<double> &end, bool verbose, int &path_length, int &num_checks, double &dist)
 {
+  TRACE_SCOPE("checkPathForCollision", "collision");
   int inc_cc = 5;
   double dist_temp = 0;
   std::vector<double> start_norm(start);
@@ -776,6 +797,97 @@ bool SBPLCollisionSpace::isStateToStateValid(const std::vector<double> &angles0,
   return checkPathForCollision(angles0, angles1, false, path_length, num_checks, dist);
 }
 
+bool SBPLCollisionSpace::getRepairStep(const std::vector<double> &angles, double clearance, std::vector<double> &step)
+{
+  TRACE_SCOPE("getRepairStep", "collision");
+  KDL::Vector v;
+  int x,y,z;
+  double gx, gy, gz;
+
+  if(!model_.computeDefaultGroupFK(angles, frames_))
+  {
+    ROS_ERROR("[cspace] Failed to compute foward kinematics.");
+    return false;
+  }
+
+  // the spheres of the arm & the attached object
+  std::vector<const Sphere*> spheres(spheres_.begin(), spheres_.end());
+  std::vector<double> radii(spheres_.size(), padding_);
+  for(size_t i = 0; i < spheres_.size(); ++i)
+    radii[i] += spheres_[i]->radius;
+  if(object_attached_)
+  {
+    for(size_t i = 0; i < object_spheres_.size(); ++i)
+    {
+      spheres.push_back(&object_spheres_[i]);
+      radii.push_back(object_spheres_[i].radius);
+    }
+  }
+
+  // how far each of the colliding spheres has to move, along the gradient
+  // (there's none deep inside of an obstacle, those spheres are skipped)
+  std::vector<int> colliding;
+  std::vector<KDL::Vector> centers, push;
+  for(size_t i = 0; i < spheres.size(); ++i)
+  {
+    v = frames_[spheres[i]->kdl_chain][spheres[i]->kdl_segment] * spheres[i]->v;
+    grid_->worldToGrid(v.x(), v.y(), v.z(), x, y, z);
+    if(!grid_->isInBounds(x, y, z))
+      continue;
+
+    double depth = radii[i] + clearance - grid_->getDistance(x, y, z);
+    if(depth <= 0 || !grid_->getGradient(x, y, z, gx, gy, gz))
+      continue;
+
+    KDL::Vector g(gx, gy, gz);
+    double norm = g.Norm();
+    if(norm < 1e-6)
+      continue;
+    colliding.push_back(i);
+    centers.push_back(v);
+    push.push_back(g * (depth / norm));
+  }
+  if(colliding.empty())
+    return false;
+
+  // jacobians of the sphere centers by finite differences (FK of the whole group
+  // per joint), then the jacobian transpose step
+  const double eps = 1e-4;
+  std::vector<double> a(angles);
+  std::vector<std::vector<KDL::Vector> > jac(colliding.size(), std::vector<KDL::Vector>(angles.size()));
+  step.assign(angles.size(), 0);
+  for(size_t j = 0; j < angles.size(); ++j)
+  {
+    a[j] = angles[j] + eps;
+    if(!model_.computeDefaultGroupFK(a, frames_))
+      return false;
+    a[j] = angles[j];
+
+    for(size_t k = 0; k < colliding.size(); ++k)
+    {
+      const Sphere *s = spheres[colliding[k]];
+      jac[k][j] = (frames_[s->kdl_chain][s->kdl_segment] * s->v - centers[k]) * (1.0 / eps);
+      step[j] += KDL::dot(jac[k][j], push[k]);
+    }
+  }
+
+  // scale it so the spheres move as far as they have to (least squares along the step)
+  double num = 0, den = 0;
+  for(size_t k = 0; k < colliding.size(); ++k)
+  {
+    KDL::Vector moved;
+    for(size_t j = 0; j < step.size(); ++j)
+      moved = moved + jac[k][j] * step[j];
+    num += KDL::dot(moved, push[k]);
+    den += KDL::dot(moved, moved);
+  }
+  if(den < 1e-12)
+    return false;
+  for(size_t j = 0; j < step.size(); ++j)
+    step[j] *= num / den;
+  return true;
+}
+
 bool SBPLCollisionSpace::setPlanningScene(const arm_navigation_msgs::PlanningScene &scene)
 {
   // robot state
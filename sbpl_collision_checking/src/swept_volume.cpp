@@ -0,0 +1,192 @@
+/** \author Benjamin Cohen */
+
+#include <sbpl_collision_checking/swept_volume.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+namespace sbpl_arm_planner
+{
+
+SweptVolume::SweptVolume(OccupancyGrid *grid) : grid_(grid), clearance_(0), num_cells_(0)
+{
+  for(int i = 0; i < 3; ++i)
+    brick_dims_[i] = 0;
+}
+
+void SweptVolume::clear()
+{
+  directory_.clear();
+  bricks_.clear();
+  times_.clear();
+  segments_.clear();
+  num_cells_ = 0;
+}
+
+SweptVolume::Brick* SweptVolume::getBrick(int x, int y, int z, int &cell, bool allocate)
+{
+  int b = ((z / brick_size_) * brick_dims_[1] + y / brick_size_) * brick_dims_[0] + x / brick_size_;
+  if(directory_[b] < 0)
+  {
+    if(!allocate)
+      return NULL;
+    Brick brick;
+    memset(brick.swept, 0, sizeof(brick.swept));
+    directory_[b] = bricks_.size();
+    bricks_.push_back(brick);
+  }
+  cell = ((z % brick_size_) * brick_size_ + y % brick_size_) * brick_size_ + x % brick_size_;
+  return &bricks_[directory_[b]];
+}
+
+bool SweptVolume::isSwept(int x, int y, int z)
+{
+  int cell;
+  if(directory_.empty() || !grid_->isInBounds(x, y, z))
+    return false;
+  Brick *brick = getBrick(x, y, z, cell, false);
+  return brick != NULL && (brick->swept[cell / 64] & (1ULL << (cell % 64)));
+}
+
+void SweptVolume::sweepSphere(double x, double y, double z, double radius, int config)
+{
+  double res = grid_->getResolution();
+  int dims[3];
+  double origin[3], center[3] = {x, y, z};
+  grid_->getGridSize(dims[0], dims[1], dims[2]);
+  grid_->getOrigin(origin[0], origin[1], origin[2]);
+
+  // anything in a cell that's within the radius of the center of the cell
+  radius += 0.5 * sqrt(3.0) * res;
+  int lo[3], hi[3];
+  for(int k = 0; k < 3; ++k)
+  {
+    lo[k] = std::max(0, int(floor((center[k] - radius - origin[k]) / res + 0.5)));
+    hi[k] = std::min(dims[k] - 1, int(floor((center[k] + radius - origin[k]) / res + 0.5)));
+  }
+
+  int cell;
+  double r2 = radius * radius;
+  for(int cz = lo[2]; cz <= hi[2]; ++cz)
+  {
+    double dz = origin[2] + cz * res - z;
+    for(int cy = lo[1]; cy <= hi[1]; ++cy)
+    {
+      double dy = origin[1] + cy * res - y;
+      for(int cx = lo[0]; cx <= hi[0]; ++cx)
+      {
+        double dx = origin[0] + cx * res - x;
+        if(dx*dx + dy*dy + dz*dz > r2)
+          continue;
+
+        // the configurations are swept in order
+        Brick *brick = getBrick(cx, cy, cz, cell, true);
+        unsigned long long bit = 1ULL << (cell % 64);
+        if(!(brick->swept[cell / 64] & bit))
+        {
+          brick->swept[cell / 64] |= bit;
+          brick->first[cell] = config;
+          num_cells_++;
+        }
+        brick->last[cell] = config;
+      }
+    }
+  }
+}
+
+bool SweptVolume::build(SBPLCollisionSpace *cspace, const std::vector<std::vector<double> > &path, const std::vector<double> &times, double clearance)
+{
+  clear();
+  if(path.empty())
+  {
+    ROS_ERROR("[swept] The trajectory is empty.");
+    return false;
+  }
+  if(!times.empty() && times.size() != path.size())
+  {
+    ROS_ERROR("[swept] Expecting a time for each of the %d waypoints. (%d)", int(path.size()), int(times.size()));
+    return false;
+  }
+
+  ros::WallTime start = ros::WallTime::now();
+  clearance_ = clearance;
+  int dims[3];
+  grid_->getGridSize(dims[0], dims[1], dims[2]);
+  for(int k = 0; k < 3; ++k)
+    brick_dims_[k] = (dims[k] + brick_size_ - 1) / brick_size_;
+  directory_.assign(brick_dims_[0] * brick_dims_[1] * brick_dims_[2], -1);
+
+  std::vector<std::vector<double> > segment, spheres;
+  for(size_t i = 0; i < path.size(); ++i)
+  {
+    // the segment that ends at waypoint i, interpolated like the collision space checks it
+    segment.clear();
+    if(i == 0)
+      segment.push_back(path[0]);
+    else if(!cspace->interpolatePath(path[i-1], path[i], segment) || segment.empty())
+    {
+      ROS_ERROR("[swept] Failed to interpolate between waypoints %d & %d.", int(i-1), int(i));
+      clear();
+      return false;
+    }
+
+    double t0 = times.empty() ? double(i) : times[i];
+    double tp = i == 0 ? t0 : (times.empty() ? double(i-1) : times[i-1]);
+    for(size_t j = 0; j < segment.size(); ++j)
+    {
+      spheres.clear();
+      if(!cspace->getCollisionSpheres(segment[j], spheres))
+      {
+        clear();
+        return false;
+      }
+
+      int config = times_.size();
+      times_.push_back(segment.size() > 1 ? tp + (t0 - tp) * double(j) / double(segment.size() - 1) : t0);
+      segments_.push_back(i == 0 ? 0 : int(i-1));
+      for(size_t k = 0; k < spheres.size(); ++k)
+        sweepSphere(spheres[k][0], spheres[k][1], spheres[k][2], spheres[k][3] + clearance_, config);
+    }
+  }
+
+  ROS_INFO("[swept] %d configurations swept %d cells in %d bricks (%0.1fKB) in %0.3fsec.", int(times_.size()), num_cells_, int(bricks_.size()), double(bricks_.size() * sizeof(Brick) + directory_.size() * sizeof(int)) / 1024.0, (ros::WallTime::now() - start).toSec());
+  return true;
+}
+
+bool SweptVolume::getFirstInvalidated(const std::vector<Eigen::Vector3d> &points, double from_time, int &segment, double &time)
+{
+  if(times_.empty())
+    return false;
+
+  double res = grid_->getResolution();
+  double origin[3];
+  grid_->getOrigin(origin[0], origin[1], origin[2]);
+
+  // the first configuration at or after from_time
+  int now = std::lower_bound(times_.begin(), times_.end(), from_time) - times_.begin();
+  int first = times_.size();
+  int x, y, z, cell;
+  for(size_t i = 0; i < points.size(); ++i)
+  {
+    x = int(floor((points[i].x() - origin[0]) / res + 0.5));
+    y = int(floor((points[i].y() - origin[1]) / res + 0.5));
+    z = int(floor((points[i].z() - origin[2]) / res + 0.5));
+    if(!grid_->isInBounds(x, y, z))
+      continue;
+
+    Brick *brick = getBrick(x, y, z, cell, false);
+    if(brick == NULL || !(brick->swept[cell / 64] & (1ULL << (cell % 64))))
+      continue;
+    if(brick->last[cell] < now)
+      continue;
+    first = std::min(first, std::max(brick->first[cell], now));
+  }
+
+  if(first == int(times_.size()))
+    return false;
+  segment = segments_[first];
+  time = times_[first];
+  return true;
+}
+
+}
@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2012, Maxim Likhachev
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Pennsylvania nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \author Benjamin Cohen */
+
+#ifndef _SBPL_BENCHMARK_
+#define _SBPL_BENCHMARK_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <ros/console.h>
+#include <ros/time.h>
+
+/* \brief Micro-benchmark harness for the packages' benchmark executables.
+ * The allocations are counted by the global operator new/delete of
+ * benchmark_alloc.cpp, which defines the two counters. Only the benchmark
+ * executables link it (benchmark_alloc).
+*/
+
+extern unsigned long benchmark_num_allocs_;
+extern unsigned long benchmark_num_alloc_bytes_;
+
+namespace sbpl_arm_planner {
+
+class Benchmark
+{
+  public:
+
+    /**
+     * @brief Constructor
+     * @param name of the suite (written to the JSON output)
+     * @param seed that the fixtures are generated with
+    */
+    Benchmark(std::string suite, unsigned int seed) : suite_(suite), seed_(seed) {};
+
+    unsigned int getSeed() { return seed_; }
+
+    /** @brief time op() over a number of iterations, after one warm up call */
+    template <typename Op>
+    void run(std::string name, Op &op, int iterations);
+
+    /** @brief write the results as JSON (to stdout if the filename is empty) */
+    bool writeJSON(std::string filename);
+
+  private:
+
+    typedef struct
+    {
+      std::string name;
+      int iterations;
+      double ns_per_op;
+      double allocs_per_op;
+      double bytes_per_op;
+    } Result;
+
+    std::string suite_;
+    unsigned int seed_;
+    std::vector<Result> results_;
+};
+
+template <typename Op>
+void Benchmark::run(std::string name, Op &op, int iterations)
+{
+  op();
+
+  unsigned long allocs = benchmark_num_allocs_;
+  unsigned long bytes = benchmark_num_alloc_bytes_;
+  ros::WallTime t_start = ros::WallTime::now();
+  for(int i = 0; i < iterations; ++i)
+    op();
+  double elapsed = (ros::WallTime::now() - t_start).toSec();
+
+  Result r;
+  r.name = name;
+  r.iterations = iterations;
+  r.ns_per_op = elapsed * 1e9 / iterations;
+  r.allocs_per_op = double(benchmark_num_allocs_ - allocs) / iterations;
+  r.bytes_per_op = double(benchmark_num_alloc_bytes_ - bytes) / iterations;
+  results_.push_back(r);
+
+  ROS_INFO("[%s] %30s: %12.1f ns/op  %8.2f allocs/op  %10.1f bytes/op  (%d iterations)", suite_.c_str(), name.c_str(), r.ns_per_op, r.allocs_per_op, r.bytes_per_op, iterations);
+}
+
+inline bool Benchmark::writeJSON(std::string filename)
+{
+  FILE* file = stdout;
+  if(!filename.empty() && (file = fopen(filename.c_str(), "w")) == NULL)
+  {
+    ROS_ERROR("Failed to open '%s' for writing the benchmark results.", filename.c_str());
+    return false;
+  }
+
+  fprintf(file, "{\n  \"suite\": \"%s\",\n  \"seed\": %u,\n  \"benchmarks\": [\n", suite_.c_str(), seed_);
+  for(size_t i = 0; i < results_.size(); ++i)
+  {
+    fprintf(file, "    {\"name\": \"%s\", \"iterations\": %d, \"ns_per_op\": %0.1f, \"allocs_per_op\": %0.3f, \"bytes_per_op\": %0.1f}%s\n",
+        results_[i].name.c_str(), results_[i].iterations, results_[i].ns_per_op, results_[i].allocs_per_op, results_[i].bytes_per_op,
+        i+1 < results_.size() ? "," : "");
+  }
+  fprintf(file, "  ]\n}\n");
+
+  if(file != stdout)
+    fclose(file);
+  return true;
+}
+
+/** @brief URDF of a 7 DOF arm (PR2-like) for fixtures that don't need the param server */
+inline std::string getSyntheticArmURDF()
+{
+  return std::string(
+    "<robot name=\"synthetic_arm\">"
+    "  <link name=\"base_link\"/>"
+    "  <link name=\"shoulder_pan_link\"/>"
+    "  <link name=\"shoulder_lift_link\"/>"
+    "  <link name=\"upper_arm_roll_link\"/>"
+    "  <link name=\"elbow_flex_link\"/>"
+    "  <link name=\"forearm_roll_link\"/>"
+    "  <link name=\"wrist_flex_link\"/>"
+    "  <link name=\"wrist_roll_link\"/>"
+    "  <link name=\"tool_link\"/>"
+    "  <joint name=\"shoulder_pan_joint\" type=\"revolute\">"
+    "    <parent link=\"base_link\"/> <child link=\"shoulder_pan_link\"/>"
+    "    <origin xyz=\"0 0 0.8\" rpy=\"0 0 0\"/> <axis xyz=\"0 0 1\"/>"
+    "    <limit lower=\"-2.28\" upper=\"0.71\" effort=\"30\" velocity=\"2.0\"/>"
+    "  </joint>"
+    "  <joint name=\"shoulder_lift_joint\" type=\"revolute\">"
+    "    <parent link=\"shoulder_pan_link\"/> <child link=\"shoulder_lift_link\"/>"
+    "    <origin xyz=\"0.1 0 0\" rpy=\"0 0 0\"/> <axis xyz=\"0 1 0\"/>"
+    "    <limit lower=\"-0.52\" upper=\"1.39\" effort=\"30\" velocity=\"2.0\"/>"
+    "  </joint>"
+    "  <joint name=\"upper_arm_roll_joint\" type=\"revolute\">"
+    "    <parent link=\"shoulder_lift_link\"/> <child link=\"upper_arm_roll_link\"/>"
+    "    <origin xyz=\"0 0 0\" rpy=\"0 0 0\"/> <axis xyz=\"1 0 0\"/>"
+    "    <limit lower=\"-3.9\" upper=\"0.8\" effort=\"30\" velocity=\"2.0\"/>"
+    "  </joint>"
+    "  <joint name=\"elbow_flex_joint\" type=\"revolute\">"
+    "    <parent link=\"upper_arm_roll_link\"/> <child link=\"elbow_flex_link\"/>"
+    "    <origin xyz=\"0.4 0 0\" rpy=\"0 0 0\"/> <axis xyz=\"0 1 0\"/>"
+    "    <limit lower=\"-2.3\" upper=\"0.0\" effort=\"30\" velocity=\"2.0\"/>"
+    "  </joint>"
+    "  <joint name=\"forearm_roll_joint\" type=\"continuous\">"
+    "    <parent link=\"elbow_flex_link\"/> <child link=\"forearm_roll_link\"/>"
+    "    <origin xyz=\"0 0 0\" rpy=\"0 0 0\"/> <axis xyz=\"1 0 0\"/>"
+    "    <limit effort=\"30\" velocity=\"2.0\"/>"
+    "  </joint>"
+    "  <joint name=\"wrist_flex_joint\" type=\"revolute\">"
+    "    <parent link=\"forearm_roll_link\"/> <child link=\"wrist_flex_link\"/>"
+    "    <origin xyz=\"0.32 0 0\" rpy=\"0 0 0\"/> <axis xyz=\"0 1 0\"/>"
+    "    <limit lower=\"-2.1\" upper=\"0.0\" effort=\"30\" velocity=\"2.0\"/>"
+    "  </joint>"
+    "  <joint name=\"wrist_roll_joint\" type=\"continuous\">"
+    "    <parent link=\"wrist_flex_link\"/> <child link=\"wrist_roll_link\"/>"
+    "    <origin xyz=\"0 0 0\" rpy=\"0 0 0\"/> <axis xyz=\"1 0 0\"/>"
+    "    <limit effort=\"30\" velocity=\"2.0\"/>"
+    "  </joint>"
+    "  <joint name=\"tool_joint\" type=\"fixed\">"
+    "    <parent link=\"wrist_roll_link\"/> <child link=\"tool_link\"/>"
+    "    <origin xyz=\"0.15 0 0\" rpy=\"0 0 0\"/>"
+    "  </joint>"
+    "</robot>");
+}
+
+/** @brief planning joints of the synthetic arm (in the order of the kinematic chain) */
+inline void getSyntheticArmJoints(std::vector<std::string> &joints)
+{
+  joints.clear();
+  joints.push_back("shoulder_pan_joint");
+  joints.push_back("shoulder_lift_joint");
+  joints.push_back("upper_arm_roll_joint");
+  joints.push_back("elbow_flex_joint");
+  joints.push_back("forearm_roll_joint");
+  joints.push_back("wrist_flex_joint");
+  joints.push_back("wrist_roll_joint");
+}
+
+/** @brief random joint configuration within the synthetic arm's limits */
+inline void getRandomSyntheticArmState(unsigned int *seed, std::vector<double> &angles)
+{
+  const double min_limits[7] = {-2.28, -0.52, -3.9, -2.3, -3.14, -2.1, -3.14};
+  const double max_limits[7] = { 0.71,  1.39,  0.8,  0.0,  3.14,  0.0,  3.14};
+
+  angles.resize(7);
+  for(size_t i = 0; i < angles.size(); ++i)
+    angles[i] = min_limits[i] + (max_limits[i] - min_limits[i]) * (rand_r(seed) / double(RAND_MAX));
+}
+
+}
+
+#endif
+
@@ -18,7 +18,7 @@ class CollisionChecker
     
     CollisionChecker();
 
-    ~CollisionChecker(){};
+    virtual ~CollisionChecker(){};
 
     /* Initialization */
     virtual bool init(std::string group_name);
@@ -35,6 +35,10 @@ class CollisionChecker
    
     virtual bool isStateToStateValid(const std::vector<double> &angles0, const std::vector<double> &angles1, int path_length, int num_checks, double &dist);
 
+    /** \brief A joint space step that moves the parts of the robot closer than 'clearance' to an obstacle
+     * out along the gradient of the distance field (false if there is none) */
+    virtual bool getRepairStep(const std::vector<double> &angles, double clearance, std::vector<double> &step);
+
     /* Utils */
     virtual bool interpolatePath(const std::vector<double> &start, const std::vector<double> &end, const std::vector<double> &inc, std::vector<std::vector<double> >& path);
 
@@ -65,6 +65,8 @@ class KDLRobotModel : public RobotModel {
 
     /* Joint Limits */
     virtual bool checkJointLimits(const std::vector<double> &angles);
+
+    virtual bool getPlanningJointLimits(std::vector<double> &min_limits, std::vector<double> &max_limits, std::vector<bool> &continuous);
    
     /* Forward Kinematics */
     virtual bool computeFK(const std::vector<double> &angles, std::string name, KDL::Frame &f);
@@ -41,6 +41,8 @@
 #include <distance_field/propagation_distance_field.h>
 #include <arm_navigation_msgs/CollisionMap.h>
 #include <visualization_msgs/MarkerArray.h>
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/locks.hpp>
 
 /* \brief At this point, this is a very lightweight layer on top of the
  * PropagationDistanceField class. I'll eventually get rid of it once the
@@ -133,6 +135,17 @@ class OccupancyGrid
 
     void reset();
 
+    /** 
+     * @brief get the gradient of the distance field at a cell (central
+     * difference, meters per meter). It's computed for a brick of cells
+     * at a time, the first time one of them is asked for, and cached
+     * until the field changes. Safe to call from many threads.
+    */
+    bool getGradient(int x, int y, int z, double &gx, double &gy, double &gz);
+
+    /** @brief drop the cached gradient (needed if the distance field is changed through its own pointer) */
+    void invalidateGradient();
+
     visualization_msgs::MarkerArray getVisualization(std::string type);
 
   private:
@@ -140,6 +153,14 @@ class OccupancyGrid
     bool delete_grid_;
     std::string reference_frame_;
     distance_field::PropagationDistanceField* grid_;
+
+    /* gradient bricks, an empty brick still has to be computed (held
+     * shared to read a brick, exclusively to compute or drop them) */
+    int gradient_dims_[3];
+    std::vector<std::vector<float> > gradient_;
+    boost::shared_mutex gradient_mutex_;
+
+    void computeGradientBrick(int bx, int by, int bz, std::vector<float> &brick);
 };
 
 inline distance_field::PropagationDistanceField* OccupancyGrid::getDistanceFieldPtr()
@@ -204,6 +225,7 @@ inline void OccupancyGrid::addPointsToField(const std::vector<Eigen::Vector3d> &
     pts[i] = tf::Vector3(points[i].x(), points[i].y(), points[i].z());
   
   grid_->addPointsToField(pts);
+  invalidateGradient();
 }
 
 inline void OccupancyGrid::updatePointsInField(const std::vector<Eigen::Vector3d> &points, bool iterative)
@@ -216,6 +238,7 @@ inline void OccupancyGrid::updatePointsInField(const std::vector<Eigen::Vector3d
     pts[i] = tf::Vector3(points[i].x(), points[i].y(), points[i].z());
   
   grid_->updatePointsInField(pts, iterative);
+  invalidateGradient();
 }
 
 }
@@ -0,0 +1,79 @@
+/** \author Benjamin Cohen */
+
+#ifndef _REACHABILITY_MAP_
+#define _REACHABILITY_MAP_
+
+#include <string>
+#include <vector>
+#include <kdl/frames.hpp>
+#include <sbpl_manipulation_components/robot_model.h>
+
+namespace sbpl_arm_planner {
+
+/* \brief The poses of the planning link that were reached by sampling FK
+ * over the joint limits, in the kinematics frame (so it doesn't depend on
+ * where the robot is). It's a voxel grid over the bounding box of the
+ * samples, every voxel has a 64 bin histogram of the direction of the
+ * link's x-axis (8 equal area bands of z times 8 sectors), kept as a bit
+ * per bin. The roll about the x-axis isn't kept. Sampling misses some
+ * poses, so the lookups also accept the neighboring voxels & bins.
+*/
+class ReachabilityMap
+{
+  public:
+
+    ReachabilityMap();
+
+    /** \brief Sample FK of the planning link (the robot model has to be initialized) */
+    bool generate(RobotModel *rm, int num_samples, double resolution, unsigned int seed=1);
+
+    bool load(const std::string &filename);
+
+    bool save(const std::string &filename);
+
+    bool isLoaded() const { return !voxels_.empty(); }
+
+    /** \brief Angle (rad) between the x-axis of a goal & the center of a bin that counts as reached */
+    void setOrientationTolerance(double tolerance) { orientation_tolerance_ = tolerance; }
+
+    /** \brief Was the position reached (pose in the kinematics frame) */
+    bool isReachable(double x, double y, double z);
+
+    /** \brief Was the position reached with about the same x-axis direction */
+    bool isReachable(const KDL::Frame &f);
+
+    /** \brief Fraction of the voxels that were reached */
+    double getCoverage();
+
+    void getDimensions(int &dim_x, int &dim_y, int &dim_z, double &resolution);
+
+  private:
+
+    static const int num_bands_ = 8;
+    static const int num_sectors_ = 8;
+
+    double origin_[3];
+    int dims_[3];
+    double resolution_;
+    double orientation_tolerance_;
+
+    /* one bit per orientation bin, zero if the voxel wasn't reached */
+    std::vector<unsigned long long> voxels_;
+
+    /* unit vector of the center of each bin */
+    std::vector<KDL::Vector> bin_centers_;
+
+    void computeBinCenters();
+
+    int getBin(const KDL::Vector &v);
+
+    bool getVoxel(double x, double y, double z, int &vx, int &vy, int &vz);
+
+    /** \brief OR of the bins of the voxel & its neighbors */
+    unsigned long long getNeighborhood(int vx, int vy, int vz);
+};
+
+}
+
+#endif
+
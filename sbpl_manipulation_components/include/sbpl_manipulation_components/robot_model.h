@@ -46,7 +46,7 @@ class RobotModel {
 
     RobotModel();
     
-    ~RobotModel(){};
+    virtual ~RobotModel(){};
    
     /* Initialization */
     virtual bool init(std::string robot_description, std::vector<std::string> &planning_joints);
@@ -61,6 +61,9 @@ class RobotModel {
 
     /* Joint Limits */
     virtual bool checkJointLimits(const std::vector<double> &angles);
+
+    /** \brief Limits of the planning joints (false if the model doesn't know them) */
+    virtual bool getPlanningJointLimits(std::vector<double> &min_limits, std::vector<double> &max_limits, std::vector<bool> &continuous);
    
     double getMaxJointLimit(std::string name);
 
@@ -86,6 +89,8 @@ class RobotModel {
     /* Transform between Kinematics frame <-> Planning frame */
     void setKinematicsToPlanningTransform(const KDL::Frame &f, std::string name);
 
+    void getKinematicsToPlanningTransform(KDL::Frame &f);
+
 
   protected:
 
@@ -0,0 +1,86 @@
+/** \author Benjamin Cohen */
+
+#ifndef _SBPL_TRACER_
+#define _SBPL_TRACER_
+
+#include <string>
+
+namespace sbpl_arm_planner {
+
+/* \brief Records timed spans of the planner into a buffer per thread and
+ * writes them as Chrome trace-event JSON (open it in chrome://tracing or
+ * ui.perfetto.dev). Tracing is off by default, then a TRACE_SCOPE costs a
+ * load & a branch. Names & categories have to be string literals, only the
+ * pointers are stored. A full buffer drops the spans that don't fit (the
+ * beginning of a long request is the interesting part).
+*/
+class Tracer
+{
+  public:
+
+    static void setEnabled(bool enabled);
+
+    static bool isEnabled() { return enabled_; }
+
+    /** \brief Max number of spans kept per thread */
+    static void setBufferSize(size_t size);
+
+    /** \brief Name of the calling thread's track in the trace */
+    static void setThreadName(const std::string &name);
+
+    /** \brief Drop the spans recorded by the calling thread */
+    static void clearThread();
+
+    /** \brief Add a span of the calling thread */
+    static void addEvent(const char *name, const char *category, double start, double end);
+
+    /** \brief Add a span timed by code that isn't traced itself (e.g. another library's thread) */
+    static void addEvent(const std::string &thread, const char *name, const char *category, double start, double end);
+
+    /** \brief Write the spans of all threads that started after 'since' (wall time, sec) */
+    static bool write(const std::string &filename, double since=0);
+
+    /** \brief wall time (sec) */
+    static double now();
+
+  private:
+
+    static volatile bool enabled_;
+};
+
+/* \brief Adds a span from its construction to its destruction */
+class TraceScope
+{
+  public:
+
+    TraceScope(const char *name, const char *category) : name_(NULL)
+    {
+      if(Tracer::isEnabled())
+      {
+        name_ = name;
+        category_ = category;
+        start_ = Tracer::now();
+      }
+    }
+
+    ~TraceScope()
+    {
+      if(name_ != NULL)
+        Tracer::addEvent(name_, category_, start_, Tracer::now());
+    }
+
+  private:
+
+    const char *name_;
+    const char *category_;
+    double start_;
+};
+
+}
+
+#define SBPL_TRACE_CONCAT_(a, b) a##b
+#define SBPL_TRACE_CONCAT(a, b) SBPL_TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name, category) sbpl_arm_planner::TraceScope SBPL_TRACE_CONCAT(trace_scope_, __LINE__)(name, category)
+
+#endif
+
@@ -0,0 +1,35 @@
+/** \author Benjamin Cohen */
+
+#include <sbpl_manipulation_components/benchmark.h>
+#include <stdlib.h>
+#include <new>
+
+/* count the allocations for the benchmark harness, only the benchmark
+ * executables link this (libbenchmark_alloc.a) */
+unsigned long benchmark_num_allocs_ = 0;
+unsigned long benchmark_num_alloc_bytes_ = 0;
+
+void* operator new(size_t size) throw(std::bad_alloc)
+{
+  ++benchmark_num_allocs_;
+  benchmark_num_alloc_bytes_ += size;
+  void *p = malloc(size == 0 ? 1 : size);
+  if(p == NULL)
+    throw std::bad_alloc();
+  return p;
+}
+
+void* operator new[](size_t size) throw(std::bad_alloc)
+{
+  return operator new(size);
+}
+
+void operator delete(void *p) throw()
+{
+  free(p);
+}
+
+void operator delete[](void *p) throw()
+{
+  free(p);
+}
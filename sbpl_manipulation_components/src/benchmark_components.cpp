@@ -0,0 +1,119 @@
+/** \author Benjamin Cohen */
+
+#include <sbpl_manipulation_components/benchmark.h>
+#include <sbpl_manipulation_components/kdl_robot_model.h>
+#include <sbpl_manipulation_components/occupancy_grid.h>
+
+using namespace sbpl_arm_planner;
+
+struct FKOp
+{
+  KDLRobotModel *rm;
+  std::vector<std::vector<double> > states;
+  std::vector<double> pose;
+  size_t i;
+
+  void operator()()
+  {
+    rm->computePlanningLinkFK(states[i], pose);
+    i = (i + 1) % states.size();
+  }
+};
+
+struct IKOp
+{
+  KDLRobotModel *rm;
+  std::vector<std::vector<double> > poses;
+  std::vector<std::vector<double> > seeds;
+  std::vector<double> solution;
+  size_t i;
+  int failures;
+
+  void operator()()
+  {
+    if(!rm->computeIK(poses[i], seeds[i], solution))
+      failures++;
+    i = (i + 1) % poses.size();
+  }
+};
+
+struct GradientOp
+{
+  OccupancyGrid *grid;
+  std::vector<int> cells;
+  double gx, gy, gz;
+  size_t i;
+
+  void operator()()
+  {
+    grid->getGradient(cells[i], cells[i+1], cells[i+2], gx, gy, gz);
+    i = (i + 3) % cells.size();
+  }
+};
+
+int main(int argc, char **argv)
+{
+  std::string json_file;
+  if(argc > 1)
+    json_file = argv[1];
+
+  Benchmark bm("sbpl_manipulation_components", 1);
+  unsigned int seed = bm.getSeed();
+
+  // robot model
+  std::vector<std::string> joints;
+  getSyntheticArmJoints(joints);
+  KDLRobotModel rm("base_link", "tool_link");
+  if(!rm.init(getSyntheticArmURDF(), joints))
+  {
+    ROS_ERROR("Failed to initialize the robot model. Exiting.");
+    return 1;
+  }
+  rm.setPlanningLink("tool_link");
+
+  FKOp fk;
+  fk.rm = &rm;
+  fk.i = 0;
+  fk.states.resize(1000);
+  for(size_t i = 0; i < fk.states.size(); ++i)
+    getRandomSyntheticArmState(&seed, fk.states[i]);
+  bm.run("kdl_compute_fk", fk, 100000);
+
+  // ik for reachable poses, seeded with a nearby configuration
+  IKOp ik;
+  ik.rm = &rm;
+  ik.i = 0;
+  ik.failures = 0;
+  ik.poses.resize(100);
+  ik.seeds.resize(100);
+  for(size_t i = 0; i < ik.poses.size(); ++i)
+  {
+    getRandomSyntheticArmState(&seed, ik.seeds[i]);
+    rm.computePlanningLinkFK(ik.seeds[i], ik.poses[i]);
+    for(size_t j = 0; j < ik.seeds[i].size(); ++j)
+      ik.seeds[i][j] += 0.1 * (rand_r(&seed) / double(RAND_MAX) - 0.5);
+  }
+  bm.run("kdl_compute_ik", ik, 1000);
+  ROS_INFO("[sanity check] ik failures: %d", ik.failures);
+
+  // gradient lookups in a 1.5m cube with a box in the middle, the bricks
+  // are computed during the warm up for cells that repeat
+  OccupancyGrid grid(1.5, 1.5, 1.5, 0.02, 0.0, 0.0, 0.0);
+  grid.addCube(0.75, 0.75, 0.75, 0.3, 0.3, 0.3);
+  int dims[3];
+  grid.getGridSize(dims[0], dims[1], dims[2]);
+
+  GradientOp gradient;
+  gradient.grid = &grid;
+  gradient.i = 0;
+  for(int i = 0; i < 10000; ++i)
+  {
+    gradient.cells.push_back(rand_r(&seed) % dims[0]);
+    gradient.cells.push_back(rand_r(&seed) % dims[1]);
+    gradient.cells.push_back(rand_r(&seed) % dims[2]);
+  }
+  bm.run("occupancy_grid_get_gradient", gradient, 1000000);
+
+  return bm.writeJSON(json_file) ? 0 : 1;
+}
+
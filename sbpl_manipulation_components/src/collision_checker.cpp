@@ -41,6 +41,11 @@ bool CollisionChecker::isStateToStateValid(const std::vector<double> &angles0, c
   return false;
 }
 
+bool CollisionChecker::getRepairStep(const std::vector<double> &angles, double clearance, std::vector<double> &step)
+{
+  return false;
+}
+
 bool CollisionChecker::interpolatePath(const std::vector<double> &start, const std::vector<double> &end, const std::vector<double> &inc, std::vector<std::vector<double> > &path)
 {
   ROS_ERROR("Function is not filled in.");
@@ -0,0 +1,67 @@
+/** \author Benjamin Cohen */
+
+#include <sstream>
+#include <ros/ros.h>
+#include <sbpl_manipulation_components/kdl_robot_model.h>
+#include <sbpl_manipulation_components/reachability_map.h>
+
+/* Samples FK of the planning link & writes the reachability map that the
+ * planner loads from planning/reachability/file. Run it in the planner's
+ * namespace, it reads the same parameters (kinematics_frame, chain_tip_link,
+ * planning_link & planning/planning_joints).
+ *
+ * usage: generateReachabilityMap <file> [# samples] [resolution (m)]
+ */
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "generate_reachability_map");
+  ros::NodeHandle nh, ph("~");
+
+  if(argc < 2)
+  {
+    ROS_ERROR("usage: generateReachabilityMap <file> [# samples] [resolution (m)]");
+    return 1;
+  }
+  std::string filename = argv[1];
+  int num_samples = argc > 2 ? atoi(argv[2]) : 2000000;
+  double resolution = argc > 3 ? atof(argv[3]) : 0.05;
+
+  std::string urdf, kinematics_frame, chain_tip_link, planning_link;
+  nh.param<std::string>("robot_description", urdf, " ");
+  ph.param<std::string>("kinematics_frame", kinematics_frame, "");
+  ph.param<std::string>("chain_tip_link", chain_tip_link, "");
+  ph.param<std::string>("planning_link", planning_link, "");
+
+  std::vector<std::string> planning_joints;
+  XmlRpc::XmlRpcValue xlist;
+  if(!ph.getParam("planning/planning_joints", xlist))
+  {
+    ROS_ERROR("No planning joints found on the param server (%s/planning/planning_joints).", ph.getNamespace().c_str());
+    return 1;
+  }
+  std::stringstream joint_name_stream(static_cast<std::string>(xlist));
+  std::string jname;
+  while(joint_name_stream >> jname)
+    planning_joints.push_back(jname);
+
+  // the map is kept in the kinematics frame, so the planning frame is left as is
+  sbpl_arm_planner::KDLRobotModel rm(kinematics_frame, chain_tip_link);
+  if(!rm.init(urdf, planning_joints))
+  {
+    ROS_ERROR("Failed to initialize the robot model.");
+    return 1;
+  }
+  rm.setPlanningLink(planning_link);
+
+  sbpl_arm_planner::ReachabilityMap map;
+  ros::WallTime start = ros::WallTime::now();
+  if(!map.generate(&rm, num_samples, resolution))
+    return 1;
+  ROS_INFO("Sampled the reachability map of '%s' in %0.3fsec.", planning_link.c_str(), (ros::WallTime::now() - start).toSec());
+
+  if(!map.save(filename))
+    return 1;
+  ROS_INFO("Wrote '%s'.", filename.c_str());
+  return 0;
+}
+
@@ -219,15 +219,31 @@ bool KDLRobotModel::getJointLimits(std::string joint_name, double &min_limit, do
 
 bool KDLRobotModel::checkJointLimits(const std::vector<double> &angles)
 {
-  ROS_DEBUG("Not filled in yet...(checkJointLimits())");
-/*
-  std::vector<double> a = angles;
-  if(!sbpl::interp::NormalizeAnglesIntoRange(a, min_limits_, max_limits_))
-  {
-    ROS_ERROR("Joint angles are out of bounds.");  
+  if(angles.size() < min_limits_.size())
     return false;
+
+  // an angle is within the limits if it is, after adding a multiple of 2pi
+  for(size_t i = 0; i < min_limits_.size(); ++i)
+  {
+    if(continuous_[i] || max_limits_[i] - min_limits_[i] >= 2*M_PI)
+      continue;
+    double a = angles::normalize_angle_positive(angles[i] - min_limits_[i]);
+    if(a > max_limits_[i] - min_limits_[i])
+    {
+      ROS_DEBUG("Joint %s is out of bounds. (%0.3f not in [%0.3f, %0.3f])", planning_joints_[i].c_str(), angles[i], min_limits_[i], max_limits_[i]);
+      return false;
+    }
   }
-*/
+  return true;
+}
+
+bool KDLRobotModel::getPlanningJointLimits(std::vector<double> &min_limits, std::vector<double> &max_limits, std::vector<bool> &continuous)
+{
+  if(!initialized_)
+    return false;
+  min_limits = min_limits_;
+  max_limits = max_limits_;
+  continuous = continuous_;
   return true;
 }
 
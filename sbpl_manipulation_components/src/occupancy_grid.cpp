@@ -32,6 +32,13 @@
 #include <sbpl_manipulation_components/occupancy_grid.h>
 #include <ros/console.h>
 #include <leatherman/viz.h>
+#include <algorithm>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* cells along each side of a gradient brick */
+#define GRADIENT_BRICK_SIZE 8
 
 using namespace std;
 
@@ -43,12 +50,14 @@ OccupancyGrid::OccupancyGrid(double dim_x, double dim_y, double dim_z, double re
   grid_ = new distance_field::PropagationDistanceField(dim_x, dim_y, dim_z, resolution, origin_x, origin_y,  origin_z, 0.40);
   grid_->reset();
   delete_grid_ = true;
+  gradient_dims_[0] = gradient_dims_[1] = gradient_dims_[2] = 0;
 }
 
 OccupancyGrid::OccupancyGrid(distance_field::PropagationDistanceField* df)
 {
   grid_ = df;
   delete_grid_ = false;
+  gradient_dims_[0] = gradient_dims_[1] = gradient_dims_[2] = 0;
 }
 
 OccupancyGrid::~OccupancyGrid()
@@ -74,6 +83,7 @@ void OccupancyGrid::getWorldSize(double &dim_x, double &dim_y, double &dim_z)
 void OccupancyGrid::reset()
 {
   grid_->reset();
+  invalidateGradient();
 }
 
 void OccupancyGrid::getOrigin(double &wx, double &wy, double &wz)
@@ -95,6 +105,7 @@ void OccupancyGrid::updateFromCollisionMap(const arm_navigation_msgs::CollisionM
   }
   reference_frame_ = collision_map.header.frame_id;
   grid_->addCollisionMapToField(collision_map);
+  invalidateGradient();
 }
 
 void OccupancyGrid::addCube(double origin_x, double origin_y, double origin_z, double size_x, double size_y, double size_z)
@@ -115,6 +126,138 @@ void OccupancyGrid::addCube(double origin_x, double origin_y, double origin_z, d
   }
 
   grid_->addPointsToField(pts);
+  invalidateGradient();
+}
+
+void OccupancyGrid::invalidateGradient()
+{
+  // keep the memory around, the bricks are recomputed as they're needed
+  boost::unique_lock<boost::shared_mutex> lock(gradient_mutex_);
+  for(size_t i = 0; i < gradient_.size(); ++i)
+    gradient_[i].clear();
+}
+
+bool OccupancyGrid::getGradient(int x, int y, int z, double &gx, double &gy, double &gz)
+{
+  if(!isInBounds(x,y,z))
+    return false;
+
+  const int b = GRADIENT_BRICK_SIZE;
+  const int n = b*b*b;
+  int i = ((z%b)*b + y%b)*b + x%b;
+
+  // most of the time the brick is already there
+  {
+    boost::shared_lock<boost::shared_mutex> lock(gradient_mutex_);
+    if(!gradient_.empty())
+    {
+      const std::vector<float> &brick = gradient_[((z/b)*gradient_dims_[1] + y/b)*gradient_dims_[0] + x/b];
+      if(!brick.empty())
+      {
+        gx = brick[i];
+        gy = brick[n+i];
+        gz = brick[2*n+i];
+        return true;
+      }
+    }
+  }
+
+  boost::unique_lock<boost::shared_mutex> lock(gradient_mutex_);
+  if(gradient_.empty())
+  {
+    gradient_dims_[0] = (grid_->getNumCells(distance_field::PropagationDistanceField::DIM_X) + b - 1) / b;
+    gradient_dims_[1] = (grid_->getNumCells(distance_field::PropagationDistanceField::DIM_Y) + b - 1) / b;
+    gradient_dims_[2] = (grid_->getNumCells(distance_field::PropagationDistanceField::DIM_Z) + b - 1) / b;
+    gradient_.resize(gradient_dims_[0]*gradient_dims_[1]*gradient_dims_[2]);
+  }
+
+  std::vector<float> &brick = gradient_[((z/b)*gradient_dims_[1] + y/b)*gradient_dims_[0] + x/b];
+  if(brick.empty())
+    computeGradientBrick(x/b, y/b, z/b, brick);
+
+  gx = brick[i];
+  gy = brick[n+i];
+  gz = brick[2*n+i];
+  return true;
+}
+
+void OccupancyGrid::computeGradientBrick(int bx, int by, int bz, std::vector<float> &brick)
+{
+  const int b = GRADIENT_BRICK_SIZE;
+  const int h = GRADIENT_BRICK_SIZE + 2;
+  const int n = b*b*b;
+  float d[h*h*h];
+  int dims[3], cx, cy, cz;
+
+  dims[0] = grid_->getNumCells(distance_field::PropagationDistanceField::DIM_X);
+  dims[1] = grid_->getNumCells(distance_field::PropagationDistanceField::DIM_Y);
+  dims[2] = grid_->getNumCells(distance_field::PropagationDistanceField::DIM_Z);
+
+  // distances of the brick and a one cell border around it (clamped to the grid)
+  for(int z = 0; z < h; ++z)
+  {
+    cz = std::min(std::max(bz*b + z - 1, 0), dims[2]-1);
+    for(int y = 0; y < h; ++y)
+    {
+      cy = std::min(std::max(by*b + y - 1, 0), dims[1]-1);
+      for(int x = 0; x < h; ++x)
+      {
+        cx = std::min(std::max(bx*b + x - 1, 0), dims[0]-1);
+        d[(z*h + y)*h + x] = grid_->getDistanceFromCell(cx, cy, cz);
+      }
+    }
+  }
+
+  // gradient stored as three planes (x, y, z) of the brick's cells
+  brick.resize(3*n);
+  float *gx = &brick[0], *gy = &brick[n], *gz = &brick[2*n];
+  const float s = 0.5 / getResolution();
+#ifdef __SSE2__
+  const __m128 vs = _mm_set1_ps(s);
+#endif
+
+  for(int z = 0; z < b; ++z)
+  {
+    for(int y = 0; y < b; ++y)
+    {
+      const float *c = &d[((z+1)*h + y+1)*h + 1];
+      int i = (z*b + y)*b, x = 0;
+#ifdef __SSE2__
+      for(; x + 4 <= b; x += 4)
+      {
+        _mm_storeu_ps(gx+i+x, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(c+x+1), _mm_loadu_ps(c+x-1)), vs));
+        _mm_storeu_ps(gy+i+x, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(c+x+h), _mm_loadu_ps(c+x-h)), vs));
+        _mm_storeu_ps(gz+i+x, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(c+x+h*h), _mm_loadu_ps(c+x-h*h)), vs));
+      }
+#endif
+      for(; x < b; ++x)
+      {
+        gx[i+x] = (c[x+1] - c[x-1]) * s;
+        gy[i+x] = (c[x+h] - c[x-h]) * s;
+        gz[i+x] = (c[x+h*h] - c[x-h*h]) * s;
+      }
+    }
+  }
+
+  // a cell on a side of the grid is its own (clamped) neighbour, so its difference spans one cell
+  if(bx > 0 && by > 0 && bz > 0 && (bx+1)*b < dims[0] && (by+1)*b < dims[1] && (bz+1)*b < dims[2])
+    return;
+  for(int z = 0; z < b; ++z)
+  {
+    for(int y = 0; y < b; ++y)
+    {
+      for(int x = 0; x < b; ++x)
+      {
+        int i = (z*b + y)*b + x;
+        if(bx*b + x == 0 || bx*b + x == dims[0]-1)
+          gx[i] *= 2;
+        if(by*b + y == 0 || by*b + y == dims[1]-1)
+          gy[i] *= 2;
+        if(bz*b + z == 0 || bz*b + z == dims[2]-1)
+          gz[i] *= 2;
+      }
+    }
+  }
 }
 
 void OccupancyGrid::getOccupiedVoxels(const geometry_msgs::Pose &pose, const std::vector<double> &dim, std::vector<Eigen::Vector3d> &voxels)
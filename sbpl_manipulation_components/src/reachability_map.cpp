@@ -0,0 +1,265 @@
+/** \author Benjamin Cohen */
+
+#include <sbpl_manipulation_components/reachability_map.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <ros/console.h>
+
+namespace sbpl_arm_planner {
+
+static const char magic_[8] = {'S','B','P','L','R','M','A','P'};
+static const int version_ = 1;
+
+ReachabilityMap::ReachabilityMap() : resolution_(0), orientation_tolerance_(0.5)
+{
+  for(int i = 0; i < 3; ++i)
+  {
+    origin_[i] = 0;
+    dims_[i] = 0;
+  }
+  computeBinCenters();
+}
+
+void ReachabilityMap::computeBinCenters()
+{
+  bin_centers_.resize(num_bands_ * num_sectors_);
+  for(int b = 0; b < num_bands_; ++b)
+  {
+    double z = -1.0 + (b + 0.5) * 2.0 / num_bands_;
+    double r = sqrt(1.0 - z*z);
+    for(int s = 0; s < num_sectors_; ++s)
+    {
+      double a = -M_PI + (s + 0.5) * 2.0 * M_PI / num_sectors_;
+      bin_centers_[b * num_sectors_ + s] = KDL::Vector(r * cos(a), r * sin(a), z);
+    }
+  }
+}
+
+int ReachabilityMap::getBin(const KDL::Vector &v)
+{
+  // equal area bands: the area of a band of the unit sphere is linear in z
+  int b = int((v.z() + 1.0) * 0.5 * num_bands_);
+  int s = int((atan2(v.y(), v.x()) + M_PI) / (2.0 * M_PI) * num_sectors_);
+  b = std::max(0, std::min(b, num_bands_ - 1));
+  s = std::max(0, std::min(s, num_sectors_ - 1));
+  return b * num_sectors_ + s;
+}
+
+bool ReachabilityMap::getVoxel(double x, double y, double z, int &vx, int &vy, int &vz)
+{
+  vx = int(floor((x - origin_[0]) / resolution_));
+  vy = int(floor((y - origin_[1]) / resolution_));
+  vz = int(floor((z - origin_[2]) / resolution_));
+  return vx >= 0 && vy >= 0 && vz >= 0 && vx < dims_[0] && vy < dims_[1] && vz < dims_[2];
+}
+
+unsigned long long ReachabilityMap::getNeighborhood(int vx, int vy, int vz)
+{
+  unsigned long long bins = 0;
+  for(int z = std::max(vz - 1, 0); z <= std::min(vz + 1, dims_[2] - 1); ++z)
+    for(int y = std::max(vy - 1, 0); y <= std::min(vy + 1, dims_[1] - 1); ++y)
+      for(int x = std::max(vx - 1, 0); x <= std::min(vx + 1, dims_[0] - 1); ++x)
+        bins |= voxels_[(z * dims_[1] + y) * dims_[0] + x];
+  return bins;
+}
+
+bool ReachabilityMap::generate(RobotModel *rm, int num_samples, double resolution, unsigned int seed)
+{
+  std::vector<double> min_limits, max_limits;
+  std::vector<bool> continuous;
+  if(!rm->getPlanningJointLimits(min_limits, max_limits, continuous))
+  {
+    ROS_ERROR("[reachability] The robot model doesn't know the joint limits.");
+    return false;
+  }
+  if(num_samples <= 0 || resolution <= 0)
+  {
+    ROS_ERROR("[reachability] Expecting a positive number of samples & resolution. (samples: %d  resolution: %0.3f)", num_samples, resolution);
+    return false;
+  }
+
+  // the samples are binned into the bounding box, so they're kept until it's known
+  KDL::Frame T_planning_to_kinematics;
+  rm->getKinematicsToPlanningTransform(T_planning_to_kinematics);
+  T_planning_to_kinematics = T_planning_to_kinematics.Inverse();
+
+  std::vector<double> angles(min_limits.size(), 0), pose;
+  std::vector<float> samples;
+  samples.reserve(num_samples * 6);
+  double lo[3] = {1e9, 1e9, 1e9}, hi[3] = {-1e9, -1e9, -1e9};
+  for(int i = 0; i < num_samples; ++i)
+  {
+    for(size_t j = 0; j < angles.size(); ++j)
+    {
+      double min = continuous[j] ? -M_PI : min_limits[j];
+      double max = continuous[j] ? M_PI : max_limits[j];
+      angles[j] = min + (max - min) * (rand_r(&seed) / double(RAND_MAX));
+    }
+    if(!rm->computePlanningLinkFK(angles, pose))
+      continue;
+
+    KDL::Frame f = T_planning_to_kinematics * KDL::Frame(KDL::Rotation::RPY(pose[3], pose[4], pose[5]), KDL::Vector(pose[0], pose[1], pose[2]));
+    KDL::Vector x_axis = f.M.UnitX();
+    for(int k = 0; k < 3; ++k)
+    {
+      samples.push_back(f.p(k));
+      lo[k] = std::min(lo[k], f.p(k));
+      hi[k] = std::max(hi[k], f.p(k));
+    }
+    for(int k = 0; k < 3; ++k)
+      samples.push_back(x_axis(k));
+  }
+
+  if(samples.empty())
+  {
+    ROS_ERROR("[reachability] FK failed for all of the samples.");
+    return false;
+  }
+
+  // one voxel of padding on each side
+  resolution_ = resolution;
+  for(int k = 0; k < 3; ++k)
+  {
+    origin_[k] = lo[k] - resolution_;
+    dims_[k] = int(ceil((hi[k] - lo[k]) / resolution_)) + 3;
+  }
+  voxels_.assign(dims_[0] * dims_[1] * dims_[2], 0);
+
+  int vx, vy, vz;
+  for(size_t i = 0; i < samples.size(); i += 6)
+  {
+    if(!getVoxel(samples[i], samples[i+1], samples[i+2], vx, vy, vz))
+      continue;
+    int bin = getBin(KDL::Vector(samples[i+3], samples[i+4], samples[i+5]));
+    voxels_[(vz * dims_[1] + vy) * dims_[0] + vx] |= (1ULL << bin);
+  }
+
+  ROS_INFO("[reachability] %d samples  grid: %d x %d x %d (%0.3fm)  coverage: %0.1f%%", int(samples.size() / 6), dims_[0], dims_[1], dims_[2], resolution_, getCoverage() * 100.0);
+  return true;
+}
+
+bool ReachabilityMap::load(const std::string &filename)
+{
+  FILE* file = fopen(filename.c_str(), "rb");
+  if(file == NULL)
+  {
+    ROS_ERROR("[reachability] Failed to open '%s'.", filename.c_str());
+    return false;
+  }
+
+  char magic[8];
+  int version = 0;
+  double origin[3], resolution;
+  int dims[3];
+  if(fread(magic, sizeof(magic), 1, file) != 1 || memcmp(magic, magic_, sizeof(magic)) != 0 ||
+     fread(&version, sizeof(version), 1, file) != 1 || version != version_ ||
+     fread(origin, sizeof(origin), 1, file) != 1 || fread(dims, sizeof(dims), 1, file) != 1 ||
+     fread(&resolution, sizeof(resolution), 1, file) != 1 ||
+     dims[0] <= 0 || dims[1] <= 0 || dims[2] <= 0 || resolution <= 0)
+  {
+    ROS_ERROR("[reachability] '%s' isn't a reachability map (version %d).", filename.c_str(), version_);
+    fclose(file);
+    return false;
+  }
+
+  std::vector<unsigned long long> voxels(dims[0] * dims[1] * dims[2]);
+  if(fread(&voxels[0], sizeof(unsigned long long), voxels.size(), file) != voxels.size())
+  {
+    ROS_ERROR("[reachability] End of file reached while reading the voxels of '%s'.", filename.c_str());
+    fclose(file);
+    return false;
+  }
+  fclose(file);
+
+  for(int k = 0; k < 3; ++k)
+  {
+    origin_[k] = origin[k];
+    dims_[k] = dims[k];
+  }
+  resolution_ = resolution;
+  voxels_.swap(voxels);
+  ROS_INFO("[reachability] Loaded '%s'  grid: %d x %d x %d (%0.3fm)  coverage: %0.1f%%", filename.c_str(), dims_[0], dims_[1], dims_[2], resolution_, getCoverage() * 100.0);
+  return true;
+}
+
+bool ReachabilityMap::save(const std::string &filename)
+{
+  FILE* file = fopen(filename.c_str(), "wb");
+  if(file == NULL)
+  {
+    ROS_ERROR("[reachability] Failed to open '%s' for writing.", filename.c_str());
+    return false;
+  }
+
+  fwrite(magic_, sizeof(magic_), 1, file);
+  fwrite(&version_, sizeof(version_), 1, file);
+  fwrite(origin_, sizeof(origin_), 1, file);
+  fwrite(dims_, sizeof(dims_), 1, file);
+  fwrite(&resolution_, sizeof(resolution_), 1, file);
+  bool ok = voxels_.empty() || fwrite(&voxels_[0], sizeof(unsigned long long), voxels_.size(), file) == voxels_.size();
+  if(fclose(file) != 0 || !ok)
+  {
+    ROS_ERROR("[reachability] Failed to write '%s'.", filename.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool ReachabilityMap::isReachable(double x, double y, double z)
+{
+  int vx, vy, vz;
+  if(!getVoxel(x, y, z, vx, vy, vz))
+    return false;
+  return getNeighborhood(vx, vy, vz) != 0;
+}
+
+bool ReachabilityMap::isReachable(const KDL::Frame &f)
+{
+  int vx, vy, vz;
+  if(!getVoxel(f.p.x(), f.p.y(), f.p.z(), vx, vy, vz))
+    return false;
+
+  unsigned long long bins = getNeighborhood(vx, vy, vz);
+  if(bins == 0)
+    return false;
+
+  KDL::Vector x_axis = f.M.UnitX();
+  if(bins & (1ULL << getBin(x_axis)))
+    return true;
+
+  double min_dot = cos(orientation_tolerance_);
+  for(size_t i = 0; i < bin_centers_.size(); ++i)
+  {
+    if((bins & (1ULL << i)) && KDL::dot(bin_centers_[i], x_axis) >= min_dot)
+      return true;
+  }
+  return false;
+}
+
+double ReachabilityMap::getCoverage()
+{
+  if(voxels_.empty())
+    return 0.0;
+
+  int reached = 0;
+  for(size_t i = 0; i < voxels_.size(); ++i)
+  {
+    if(voxels_[i] != 0)
+      reached++;
+  }
+  return double(reached) / voxels_.size();
+}
+
+void ReachabilityMap::getDimensions(int &dim_x, int &dim_y, int &dim_z, double &resolution)
+{
+  dim_x = dims_[0];
+  dim_y = dims_[1];
+  dim_z = dims_[2];
+  resolution = resolution_;
+}
+
+}
+
@@ -67,6 +67,11 @@ void RobotModel::setPlanningFrame(std::string name)
   planning_frame_ = name;
 }
 
+void RobotModel::getKinematicsToPlanningTransform(KDL::Frame &f)
+{
+  f = T_kinematics_to_planning_;
+}
+
 void RobotModel::getKinematicsFrame(std::string &name)
 {
   name = kinematics_frame_;
@@ -113,6 +118,11 @@ bool RobotModel::checkJointLimits(const std::vector<double> &angles)
   return false;
 }
 
+bool RobotModel::getPlanningJointLimits(std::vector<double> &min_limits, std::vector<double> &max_limits, std::vector<bool> &continuous)
+{
+  return false;
+}
+
 void RobotModel::setKinematicsToPlanningTransform(const KDL::Frame &f, std::string name)
 {
   T_kinematics_to_planning_ = f;
@@ -0,0 +1,206 @@
+/** \author Benjamin Cohen */
+
+#include <sbpl_manipulation_components/tracer.h>
+#include <stdio.h>
+#include <vector>
+#include <ros/console.h>
+#include <ros/time.h>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+
+namespace sbpl_arm_planner {
+
+typedef struct
+{
+  const char *name;
+  const char *category;
+  double start;
+  double end;
+} TraceEvent;
+
+typedef struct
+{
+  int tid;
+  std::string name;
+  bool thread;
+  bool retired;
+  double retired_time;
+  unsigned long dropped;
+  std::vector<TraceEvent> events;
+  boost::mutex mutex;
+} TraceBuffer;
+
+volatile bool Tracer::enabled_ = false;
+
+static size_t buffer_size_ = 1 << 18;
+
+/* the buffers are never deleted, a buffer of a thread that exited keeps its
+ * spans until a new thread takes it over (the pool starts threads per request) */
+static const size_t max_buffers_ = 32;
+static boost::mutex buffers_mutex_;
+static std::vector<TraceBuffer*> buffers_;
+
+static void retireBuffer(TraceBuffer *buffer)
+{
+  boost::mutex::scoped_lock lock(buffers_mutex_);
+  buffer->retired = true;
+  buffer->retired_time = Tracer::now();
+}
+
+static boost::thread_specific_ptr<TraceBuffer> thread_buffer_(&retireBuffer);
+
+static TraceBuffer* createBuffer(const std::string &name, bool thread)
+{
+  TraceBuffer *buffer = new TraceBuffer;
+  buffer->tid = buffers_.size() + 1;
+  buffer->name = name;
+  buffer->thread = thread;
+  buffer->retired = false;
+  buffer->retired_time = 0;
+  buffer->dropped = 0;
+  buffers_.push_back(buffer);
+  return buffer;
+}
+
+static TraceBuffer* getThreadBuffer()
+{
+  TraceBuffer *buffer = thread_buffer_.get();
+  if(buffer != NULL)
+    return buffer;
+
+  // take over the buffer of the thread that exited first once there are enough of them
+  boost::mutex::scoped_lock lock(buffers_mutex_);
+  if(buffers_.size() >= max_buffers_)
+  {
+    for(size_t i = 0; i < buffers_.size(); ++i)
+    {
+      if(buffers_[i]->thread && buffers_[i]->retired && (buffer == NULL || buffers_[i]->retired_time < buffer->retired_time))
+        buffer = buffers_[i];
+    }
+  }
+  if(buffer != NULL)
+  {
+    boost::mutex::scoped_lock buffer_lock(buffer->mutex);
+    buffer->retired = false;
+    buffer->dropped = 0;
+    buffer->events.clear();
+  }
+  else
+    buffer = createBuffer("", true);
+
+  char name[32];
+  snprintf(name, sizeof(name), "thread %d", buffer->tid);
+  buffer->name = name;
+  thread_buffer_.reset(buffer);
+  return buffer;
+}
+
+static void addEvent(TraceBuffer *buffer, const char *name, const char *category, double start, double end)
+{
+  boost::mutex::scoped_lock lock(buffer->mutex);
+  if(buffer->events.size() >= buffer_size_)
+  {
+    buffer->dropped++;
+    return;
+  }
+  TraceEvent e;
+  e.name = name;
+  e.category = category;
+  e.start = start;
+  e.end = end;
+  buffer->events.push_back(e);
+}
+
+void Tracer::setEnabled(bool enabled)
+{
+  enabled_ = enabled;
+}
+
+void Tracer::setBufferSize(size_t size)
+{
+  buffer_size_ = size;
+}
+
+void Tracer::setThreadName(const std::string &name)
+{
+  TraceBuffer *buffer = getThreadBuffer();
+  boost::mutex::scoped_lock lock(buffers_mutex_);
+  buffer->name = name;
+}
+
+void Tracer::clearThread()
+{
+  TraceBuffer *buffer = getThreadBuffer();
+  boost::mutex::scoped_lock lock(buffer->mutex);
+  buffer->events.clear();
+  buffer->dropped = 0;
+}
+
+void Tracer::addEvent(const char *name, const char *category, double start, double end)
+{
+  sbpl_arm_planner::addEvent(getThreadBuffer(), name, category, start, end);
+}
+
+void Tracer::addEvent(const std::string &thread, const char *name, const char *category, double start, double end)
+{
+  TraceBuffer *buffer = NULL;
+  {
+    boost::mutex::scoped_lock lock(buffers_mutex_);
+    for(size_t i = 0; i < buffers_.size() && buffer == NULL; ++i)
+    {
+      if(!buffers_[i]->thread && buffers_[i]->name == thread)
+        buffer = buffers_[i];
+    }
+    if(buffer == NULL)
+      buffer = createBuffer(thread, false);
+  }
+  sbpl_arm_planner::addEvent(buffer, name, category, start, end);
+}
+
+bool Tracer::write(const std::string &filename, double since)
+{
+  FILE* file = fopen(filename.c_str(), "w");
+  if(file == NULL)
+  {
+    ROS_ERROR("[trace] Failed to open '%s' for writing the trace.", filename.c_str());
+    return false;
+  }
+
+  int num_events = 0;
+  unsigned long dropped = 0;
+  fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+  fprintf(file, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"sbpl_arm_planner\"}}");
+
+  boost::mutex::scoped_lock lock(buffers_mutex_);
+  for(size_t i = 0; i < buffers_.size(); ++i)
+  {
+    TraceBuffer *buffer = buffers_[i];
+    boost::mutex::scoped_lock buffer_lock(buffer->mutex);
+    int tid = buffer->tid;
+    fprintf(file, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"%s\"}}", tid, buffer->name.c_str());
+    for(size_t j = 0; j < buffer->events.size(); ++j)
+    {
+      const TraceEvent &e = buffer->events[j];
+      if(e.start < since)
+        continue;
+      fprintf(file, ",\n{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %0.3f, \"dur\": %0.3f}", e.name, e.category, tid, e.start * 1e6, (e.end - e.start) * 1e6);
+      num_events++;
+    }
+    dropped += buffer->dropped;
+  }
+  fprintf(file, "\n]}\n");
+  fclose(file);
+
+  if(dropped > 0)
+    ROS_WARN("[trace] %lu spans didn't fit into the trace buffers (%d per thread).", dropped, int(buffer_size_));
+  ROS_INFO("[trace] Wrote %d spans to '%s'.", num_events, filename.c_str());
+  return true;
+}
+
+double Tracer::now()
+{
+  return ros::WallTime::now().toSec();
+}
+
+}
+